@@ -0,0 +1,869 @@
+// UMBC - CMSC 341 - Spring 2024 - Proj3
+// Benchmarks for the RQueue structures, build with the Project3Bench target
+#include "rqueue.h"
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <malloc.h>
+#include <ctime>
+using namespace std;
+
+int priorityFn1(const Student &student);
+int priorityFn2(const Student &student);
+
+// Generates the same student population for every benchmark run
+void makeStudents(vector<Student> &students, int count) {
+    mt19937 generator(10);
+    uniform_int_distribution<> letter(97, 122);
+    for (int i = 0; i < count; i++) {
+        string name = "";
+        for (int j = 0; j < 5; j++) {
+            name = name + (char) letter(generator);
+        }
+        students.push_back(Student(name, generator() % 4, generator() % 5, generator() % 4,
+                                   generator() % 3, generator() % 3, generator() % 5, generator() % 3));
+    }
+}
+
+double elapsedMs(chrono::steady_clock::time_point start) {
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// CPU time of the calling thread, without the time other threads take from it
+double threadCpuMs() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// Counts hardware cache misses of this process, if the kernel lets us (-1 otherwise)
+class CacheMissCounter {
+public:
+    CacheMissCounter() : m_fd(-1) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~CacheMissCounter() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+    CacheMissCounter(const CacheMissCounter &) = delete;
+    CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+    void start() {
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    long long stop() {
+        long long count = -1;
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+                count = -1;
+            }
+        }
+        return count;
+    }
+private:
+    int m_fd;
+};
+
+string missesStr(long long misses) {
+    return (misses < 0) ? "n/a" : to_string(misses);
+}
+
+// Builds many small heaps and merges them pairwise into one, then drains it: every step walks right spines
+void benchMerges(const vector<Student> &students, STRUCTURE structure, const string &name) {
+    const int queueSize = 64;
+    vector<RQueue *> queues;
+    for (unsigned int i = 0; i < students.size(); i += queueSize) {
+        RQueue *queue = new RQueue(priorityFn2, MINHEAP, structure);
+        for (unsigned int j = i; j < i + queueSize && j < students.size(); j++) {
+            queue->insertStudent(students[j]);
+        }
+        queues.push_back(queue);
+    }
+
+    CacheMissCounter counter;
+    counter.start();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned int width = 1; width < queues.size(); width *= 2) {
+        for (unsigned int i = 0; i + width < queues.size(); i += 2 * width) {
+            queues[i]->mergeWithQueue(*queues[i + width]);
+        }
+    }
+    double mergeMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    while (queues[0]->numStudents() > 0) {
+        queues[0]->getNextStudent();
+    }
+    double drainMs = elapsedMs(start);
+    long long misses = counter.stop();
+
+    cout << "\t" << name << ": merge " << mergeMs << " ms, drain " << drainMs << " ms, cache misses "
+         << missesStr(misses) << endl;
+    for (unsigned int i = 0; i < queues.size(); i++) {
+        delete queues[i];
+    }
+}
+
+// Fills a queue and drains it completely, reporting the time of both phases
+void benchDrain(const vector<Student> &students, STRUCTURE structure, const string &name) {
+    RQueue queue(priorityFn2, MINHEAP, structure);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < students.size(); i++) {
+        queue.insertStudent(students[i]);
+    }
+    double fillMs = elapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    while (queue.numStudents() > 0) {
+        queue.getNextStudent();
+    }
+    double drainMs = elapsedMs(start);
+
+    cout << "\t" << name << ": fill " << fillMs << " ms, drain " << drainMs << " ms" << endl;
+}
+
+// Compares an aging tick with the full rekey and rebuild that re-ranking by waiting time used to need
+void benchAging(const vector<Student> &students, STRUCTURE structure, const string &name) {
+    RQueue queue(priorityFn1, MAXHEAP, structure);
+    queue.setAgingRate(1);
+    for (unsigned int i = 0; i < students.size(); i++) {
+        queue.insertStudent(students[i]);
+        if (i % 1000 == 999) {
+            queue.advanceEpoch();
+        }
+    }
+
+    const int ticks = 1000;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < ticks; i++) {
+        queue.advanceEpoch();
+    }
+    double tickMs = elapsedMs(start) / ticks;
+
+    start = chrono::steady_clock::now();
+    queue.setPriorityFn(priorityFn1, MAXHEAP);
+    double rebuildMs = elapsedMs(start);
+
+    cout << "\t" << name << ": tick " << tickMs * 1e6 << " ns, rekey and rebuild " << rebuildMs << " ms" << endl;
+}
+
+// Merges a queue of another configuration: converting it with the setters first, or re-keying it on the fly
+void benchRekeyMerge(const vector<Student> &students) {
+    vector<Student> hostStudents(students.begin(), students.begin() + students.size() * 4 / 5);
+    vector<Student> rhsStudents(students.begin() + hostStudents.size(), students.end());
+    double convertMs[2];
+    double mergeMs[2];
+    for (int rekey = 0; rekey < 2; rekey++) {
+        RQueue host(priorityFn2, MINHEAP, LEFTIST);
+        RQueue rhs(priorityFn1, MAXHEAP, SKEW);
+        for (unsigned int i = 0; i < hostStudents.size(); i++) {
+            host.insertStudent(hostStudents[i]);
+        }
+        for (unsigned int i = 0; i < rhsStudents.size(); i++) {
+            rhs.insertStudent(rhsStudents[i]);
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        if (rekey) {
+            convertMs[rekey] = 0;
+            host.mergeWithQueue(rhs, MERGE_REKEY);
+        } else {
+            rhs.setPriorityFn(priorityFn2, MINHEAP);
+            rhs.setStructure(LEFTIST);
+            convertMs[rekey] = elapsedMs(start);
+            start = chrono::steady_clock::now();
+            host.mergeWithQueue(rhs);
+        }
+        mergeMs[rekey] = elapsedMs(start);
+    }
+
+    cout << "\tsetPriorityFn + setStructure + merge: " << convertMs[0] + mergeMs[0] << " ms" << endl;
+    cout << "\tmergeWithQueue(MERGE_REKEY): " << mergeMs[1] << " ms" << endl;
+}
+
+// Merges section queues of 16 students into one pool, extracting one student after every extractEvery
+// merges, with eager and with lazy merges
+void benchLazyMerge(const vector<Student> &students, STRUCTURE structure, const char *name, unsigned int extractEvery) {
+    const int sectionSize = 16;
+    double totalMs[2] = {0, 0};
+    for (int lazy = 0; lazy < 2; lazy++) {
+        vector<RQueue *> sections;
+        for (unsigned int i = 0; i < students.size(); i += sectionSize) {
+            RQueue *section = new RQueue(priorityFn2, MINHEAP, structure);
+            for (unsigned int j = i; j < i + sectionSize && j < students.size(); j++) {
+                section->insertStudent(students[j]);
+            }
+            sections.push_back(section);
+        }
+        RQueue pool(priorityFn2, MINHEAP, structure);
+        pool.setLazyMerge(lazy);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (unsigned int i = 0; i < sections.size(); i++) {
+            pool.mergeWithQueue(*sections[i]);
+            if (i % extractEvery == extractEvery - 1) {
+                pool.getNextStudent();
+            }
+        }
+        totalMs[lazy] = elapsedMs(start);
+
+        for (unsigned int i = 0; i < sections.size(); i++) {
+            delete sections[i];
+        }
+    }
+
+    cout << "\t" << name << ": " << totalMs[0] << " ms eager, " << totalMs[1] << " ms lazy" << endl;
+}
+
+// Fills and drains an external queue that holds a tenth of the students in memory, run files go to /tmp
+void benchExternal(const vector<Student> &students, STRUCTURE structure, const char *name) {
+    RQueue empty(priorityFn2, MINHEAP, structure);
+    ExternalQueue queue(empty, max(4, (int) students.size() / 10), "/tmp");
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int maxRuns = 0;
+    for (unsigned int i = 0; i < students.size(); i++) {
+        queue.insertStudent(students[i]);
+        maxRuns = max(maxRuns, queue.numRuns());
+    }
+    double fillMs = elapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    while (queue.numStudents() > 0) {
+        queue.getNextStudent();
+    }
+    double drainMs = elapsedMs(start);
+
+    cout << "\t" << name << ": fill " << fillMs << " ms, drain " << drainMs << " ms, " << maxRuns << " runs"
+         << endl;
+}
+
+// Fills and drains a queue with and without a journal (group commit every 5 ms), files go to /tmp.
+// The runs alternate and the fastest of three is kept, the machine may be busy with the writer's I/O.
+// The CPU time of the queue's thread is the cost of the hot path; on a single core the wall time also
+// includes the writer, which encodes and writes the records meanwhile
+void benchJournal(const vector<Student> &students, STRUCTURE structure, const char *name) {
+    double bestMs[2] = {0, 0};
+    double bestCpuMs[2] = {0, 0};
+    for (int run = 0; run < 6; run++) {
+        int journaled = run % 2;
+        QueueJournal journal("/tmp/rqueue-bench.journal", "/tmp/rqueue-bench.snapshot");
+        journal.registerPriorityFn("priorityFn2", priorityFn2);
+        RQueue queue(priorityFn2, MINHEAP, structure);
+        if (journaled) {
+            journal.attach(queue);
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        double cpuStart = threadCpuMs();
+        for (unsigned int i = 0; i < students.size(); i++) {
+            queue.insertStudent(students[i]);
+        }
+        while (queue.numStudents() > 0) {
+            queue.getNextStudent();
+        }
+        double cpuMs = threadCpuMs() - cpuStart;
+        journal.flush();
+        double totalMs = elapsedMs(start);
+        bestMs[journaled] = (run < 2) ? totalMs : min(bestMs[journaled], totalMs);
+        bestCpuMs[journaled] = (run < 2) ? cpuMs : min(bestCpuMs[journaled], cpuMs);
+    }
+    remove("/tmp/rqueue-bench.journal");
+    remove("/tmp/rqueue-bench.snapshot");
+
+    cout << "\t" << name << ": " << bestMs[0] << " ms without, " << bestMs[1] << " ms with the journal ("
+         << 100.0 * (bestMs[1] - bestMs[0]) / bestMs[0] << "%), queue thread " << bestCpuMs[0] << " ms without, "
+         << bestCpuMs[1] << " ms with (" << 100.0 * (bestCpuMs[1] - bestCpuMs[0]) / bestCpuMs[0] << "%)" << endl;
+}
+
+// Four forked workers hand the students to one scheduler process, which drains them: through a pipe to
+// the process that owns the queue, or by inserting into a shared queue directly
+void benchShared(const vector<Student> &students, STRUCTURE structure, const char *name) {
+    const int workers = 4;
+    // what a worker writes to the pipe for one student
+    struct Packet {
+        char m_name[SharedQueue::MAX_NAME + 1];
+        int m_fields[NUM_ATTRIBUTES];
+    };
+    double totalMs[2] = {0, 0};
+    for (int shared = 0; shared < 2; shared++) {
+        const string segmentName = "/rqueue-bench-" + to_string(getpid());
+        SharedQueue::remove(segmentName);
+        SharedQueue sharedQueue(segmentName, students.size(), priorityFn2, MINHEAP, structure);
+        RQueue queue(priorityFn2, MINHEAP, structure);
+        int pipeFds[2];
+        if (pipe(pipeFds) != 0) {
+            return;
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int worker = 0; worker < workers; worker++) {
+            if (fork() == 0) {
+                close(pipeFds[0]);
+                SharedQueue workerQueue(segmentName, priorityFn2);
+                for (unsigned int i = worker; i < students.size(); i += workers) {
+                    if (shared) {
+                        workerQueue.insertStudent(students[i]);
+                    } else {
+                        Packet packet;
+                        strncpy(packet.m_name, students[i].getName().c_str(), sizeof(packet.m_name) - 1);
+                        packet.m_name[sizeof(packet.m_name) - 1] = '\0';
+                        for (int j = 0; j < NUM_ATTRIBUTES; j++) {
+                            packet.m_fields[j] = students[i].getAttribute((ATTRIBUTE) j);
+                        }
+                        if (write(pipeFds[1], &packet, sizeof(packet)) != (ssize_t) sizeof(packet)) {
+                            _exit(1);
+                        }
+                    }
+                }
+                _exit(0);
+            }
+        }
+        close(pipeFds[1]);
+
+        //the owner inserts whatever the workers forward until they are all done
+        Packet packet;
+        while (read(pipeFds[0], &packet, sizeof(packet)) == (ssize_t) sizeof(packet)) {
+            queue.insertStudent(Student(packet.m_name, packet.m_fields[0], packet.m_fields[1], packet.m_fields[2],
+                                        packet.m_fields[3], packet.m_fields[4], packet.m_fields[5],
+                                        packet.m_fields[6]));
+        }
+        close(pipeFds[0]);
+        while (wait(nullptr) > 0) {
+        }
+        while (queue.numStudents() > 0) {
+            queue.getNextStudent();
+        }
+        while (sharedQueue.numStudents() > 0) {
+            sharedQueue.getNextStudent();
+        }
+        totalMs[shared] = elapsedMs(start);
+        SharedQueue::remove(segmentName);
+    }
+
+    cout << "\t" << name << ": " << totalMs[0] << " ms through a pipe, " << totalMs[1] << " ms shared" << endl;
+}
+
+// Four producer threads insert while one consumer serves: into a queue behind a mutex, or through an intake
+void benchIntake(const vector<Student> &students, STRUCTURE structure, const char *name) {
+    const int producers = 4;
+    double totalMs[2] = {0, 0};
+    for (int intake = 0; intake < 2; intake++) {
+        RQueue queue(priorityFn2, MINHEAP, structure);
+        mutex queueMutex;
+        IntakeQueue intakeQueue(queue);
+        atomic<int> running(producers);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int producer = 0; producer < producers; producer++) {
+            threads.push_back(thread([&, producer]() {
+                for (unsigned int i = producer; i < students.size(); i += producers) {
+                    if (intake) {
+                        intakeQueue.insertStudent(students[i]);
+                    } else {
+                        lock_guard<mutex> guard(queueMutex);
+                        queue.insertStudent(students[i]);
+                    }
+                }
+                running--;
+            }));
+        }
+        unsigned int served = 0;
+        while (served < students.size()) {
+            if (intake) {
+                if (intakeQueue.numStudents() > 0) {
+                    intakeQueue.getNextStudent();
+                    served++;
+                }
+            } else {
+                lock_guard<mutex> guard(queueMutex);
+                if (queue.numStudents() > 0) {
+                    queue.getNextStudent();
+                    served++;
+                }
+            }
+        }
+        for (unsigned int i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        totalMs[intake] = elapsedMs(start);
+    }
+
+    cout << "\t" << name << ": " << totalMs[0] << " ms with a mutex, " << totalMs[1] << " ms through the intake"
+         << endl;
+}
+
+// Bytes currently allocated from the heap
+long long heapBytes() {
+    struct mallinfo2 info = mallinfo2();
+    return (long long) info.uordblks + (long long) info.hblkhd;
+}
+
+// Spreads the students over many small section queues, serves one student of each section, then drops them all:
+// separate queues each carve blocks of their own, the sections of a registry share one arena
+void benchRegistry(const vector<Student> &students, int sectionSize, bool registered) {
+    const int sections = (int) students.size() / sectionSize;
+    long long before = heapBytes();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    QueueRegistry registry(priorityFn2, MINHEAP, SKEW);
+    vector<RQueue *> queues;
+    for (int id = 0; id < sections; id++) {
+        RQueue *queue = registered ? &registry.section(id) : new RQueue(priorityFn2, MINHEAP, SKEW);
+        for (int i = id * sectionSize; i < (id + 1) * sectionSize; i++) {
+            queue->insertStudent(students[i]);
+        }
+        if (!registered) {
+            queues.push_back(queue);
+        }
+    }
+    double fillMs = elapsedMs(start);
+    long long bytes = heapBytes() - before;
+
+    start = chrono::steady_clock::now();
+    for (int id = 0; id < sections; id++) {
+        (registered ? *registry.find(id) : *queues[id]).getNextStudent();
+    }
+    double serveMs = elapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    if (registered) {
+        registry.clear();
+    } else {
+        for (unsigned int i = 0; i < queues.size(); i++) {
+            delete queues[i];
+        }
+    }
+    double dropMs = elapsedMs(start);
+
+    cout << "\t" << sections << " sections of " << sectionSize << (registered ? ", registry" : ", separate")
+         << ": fill " << fillMs << " ms (" << bytes / sections << " bytes per section), serve " << serveMs
+         << " ms, drop " << dropMs << " ms" << endl;
+}
+
+// Scatters the nodes with small merges and extractions, then drains the heap as it is or after compact()
+void benchCompact(const vector<Student> &students, STRUCTURE structure, const char *name, bool compacted) {
+    RQueue queue(priorityFn2, MINHEAP, structure);
+    const int sectionSize = 64;
+    for (unsigned int i = 0; i < students.size(); i += sectionSize) {
+        RQueue section(priorityFn2, MINHEAP, structure);
+        for (unsigned int j = i; j < i + sectionSize && j < students.size(); j++) {
+            section.insertStudent(students[j]);
+        }
+        queue.mergeWithQueue(section);
+        queue.getNextStudent();
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (compacted) {
+        queue.compact();
+    }
+    double compactMs = elapsedMs(start);
+
+    //stats() walks every node, like dump and printStudentsQueue do
+    start = chrono::steady_clock::now();
+    RQueueStats shape = queue.stats();
+    double walkMs = elapsedMs(start);
+
+    CacheMissCounter counter;
+    counter.start();
+    start = chrono::steady_clock::now();
+    while (queue.numStudents() > 0) {
+        queue.getNextStudent();
+    }
+    double drainMs = elapsedMs(start);
+    long long misses = counter.stop();
+
+    cout << "\t" << name << (compacted ? " compacted" : " scattered") << ": compact " << compactMs << " ms, walk "
+         << shape.m_nodeCount << " nodes " << walkMs << " ms, drain " << drainMs << " ms, cache misses "
+         << missesStr(misses) << endl;
+}
+
+// Times every single insertion and extraction of a queue in steady state, reporting the tail of both:
+// amortized structures keep a good average but let one operation pay for many cheap ones
+// Pops batches of students and aborts them, with a transaction or by inserting the students again
+void benchTransaction(const vector<Student> &students, STRUCTURE structure, const char *name, bool transaction) {
+    RQueue queue(priorityFn2, MINHEAP, structure);
+    for (const Student &student : students) {
+        queue.insertStudent(student);
+    }
+    const int batch = 64;
+    const int batches = 2000;
+    vector<Student> popped;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < batches; i++) {
+        if (transaction) {
+            queue.begin();
+            for (int j = 0; j < batch; j++) {
+                queue.popTentative();
+            }
+            queue.rollback();
+        } else {
+            popped.clear();
+            for (int j = 0; j < batch; j++) {
+                popped.push_back(queue.getNextStudent());
+            }
+            for (const Student &student : popped) {
+                queue.insertStudent(student);
+            }
+        }
+    }
+    double ms = elapsedMs(start);
+    cout << "\t" << name << (transaction ? ", rollback: " : ", reinsert: ") << ms * 1000000 / batches
+         << " ns per batch of " << batch << endl;
+}
+
+// Admits a tenth of the students under 16 priority spec variants, either one RQueue per variant built from scratch
+// or all variants at once in a PolicySimulator on the given number of threads (0 for none, the RQueue runs)
+void benchPolicies(const vector<Student> &students, int threads) {
+    vector<PrioritySpec> variants;
+    for (int i = 0; i < 16; i++) {
+        variants.push_back(PrioritySpec("level + " + to_string(i % 4 + 1) + "*major + group desc, " +
+                                        to_string(i / 4 + 1) + "*income asc"));
+    }
+    const int seats = students.size() / 10;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (threads == 0) {
+        for (const PrioritySpec &variant : variants) {
+            RQueue queue(variant, LEFTIST);
+            for (const Student &student : students) {
+                queue.insertStudent(student);
+            }
+            for (int i = 0; i < seats; i++) {
+                queue.getNextStudent();
+            }
+        }
+        cout << "\tone RQueue per variant: " << elapsedMs(start) << " ms" << endl;
+        return;
+    }
+    PolicySimulator simulator(students);
+    for (unsigned int i = 0; i < variants.size(); i++) {
+        simulator.addPolicy("variant " + to_string(i), variants[i]);
+    }
+    double loadMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    simulator.run(seats, threads);
+    cout << "\tPolicySimulator, " << threads << (threads == 1 ? " thread: " : " threads: ") << elapsedMs(start)
+         << " ms (+" << loadMs << " ms to load the corpus)" << endl;
+}
+
+// Registration in four waves by level, seniors first, each wave spread over 40000 ticks. The clock moves 100 ticks
+// at a time, then half of the eligible students are served. Without the wheel, a cron job keeps the students sorted
+// by eligibility time and inserts the due ones one by one.
+void benchRelease(const vector<Student> &students, STRUCTURE structure, const char *name, bool wheel) {
+    const int64_t wave = 40000;
+    const int64_t period = 100;
+    vector<pair<int64_t, int> > times;
+    for (unsigned int i = 0; i < students.size(); i++) {
+        times.push_back(make_pair((SENI - students[i].getLevel()) * wave + (int64_t) (i % wave), i));
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    RQueue queue(priorityFn2, MINHEAP, structure);
+    ReleaseQueue releaseQueue(queue);
+    unsigned int next = 0;
+    if (wheel) {
+        for (const pair<int64_t, int> &time : times) {
+            releaseQueue.insertStudent(students[time.second], time.first);
+        }
+    } else {
+        sort(times.begin(), times.end());
+    }
+    double releaseMs = elapsedMs(start);
+    for (int64_t now = 0; now < 4 * wave + period; now += period) {
+        chrono::steady_clock::time_point releaseStart = chrono::steady_clock::now();
+        int eligible;
+        if (wheel) {
+            releaseQueue.advanceTime(now);
+            eligible = releaseQueue.numStudents();
+        } else {
+            for (; next < times.size() && times[next].first <= now; next++) {
+                queue.insertStudent(students[times[next].second]);
+            }
+            eligible = queue.numStudents();
+        }
+        releaseMs += elapsedMs(releaseStart);
+        for (int i = 0; i < eligible / 2; i++) {
+            if (wheel) {
+                releaseQueue.getNextStudent();
+            } else {
+                queue.getNextStudent();
+            }
+        }
+    }
+    cout << "\t" << name << (wheel ? ", timer wheel: " : ", cron inserts: ") << elapsedMs(start) << " ms, "
+         << releaseMs << " ms of it to queue the students" << endl;
+}
+
+// Spreads the students over 10k queues, then pops from every queue in turn, half of each queue
+void benchPopFromEach(const vector<Student> &students, STRUCTURE structure, const char *name, bool batched) {
+    const int numQueues = 10000;
+    const int perQueue = max((int) students.size() / numQueues, 1);
+    vector<RQueue *> queues;
+    for (int id = 0; id < numQueues; id++) {
+        queues.push_back(new RQueue(priorityFn2, MINHEAP, structure));
+    }
+    for (int i = 0; i < numQueues * perQueue; i++) {
+        queues[i % numQueues]->insertStudent(students[i % students.size()]);
+    }
+
+    const int rounds = max(perQueue / 2, 1);
+    vector<Student> popped;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        if (batched) {
+            RQueue::popFromEach(queues, popped);
+        } else {
+            popped.clear();
+            for (RQueue *queue : queues) {
+                popped.push_back(queue->getNextStudent());
+            }
+        }
+    }
+    double ms = elapsedMs(start);
+    cout << "\t" << name << (batched ? ", popFromEach: " : ", one by one: ") << ms * 1000000 / rounds / numQueues
+         << " ns per pop" << endl;
+    for (RQueue *queue : queues) {
+        delete queue;
+    }
+}
+
+// Fills many idle section queues, freezes them all, then thaws and serves each once
+void benchFreeze(const vector<Student> &students, STRUCTURE structure, const char *name) {
+    const int sectionSize = 64;
+    const int sections = (int) students.size() / sectionSize;
+    long long before = heapBytes();
+    vector<RQueue *> queues;
+    for (int id = 0; id < sections; id++) {
+        RQueue *queue = new RQueue(priorityFn2, MINHEAP, structure);
+        for (int i = id * sectionSize; i < (id + 1) * sectionSize; i++) {
+            queue->insertStudent(students[i]);
+        }
+        queues.push_back(queue);
+    }
+    long long liveBytes = heapBytes() - before;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (RQueue *queue : queues) {
+        queue->freeze();
+    }
+    double freezeMs = elapsedMs(start);
+    long long frozenBytes = heapBytes() - before;
+
+    start = chrono::steady_clock::now();
+    for (RQueue *queue : queues) {
+        queue->thaw();
+    }
+    double thawMs = elapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    for (RQueue *queue : queues) {
+        queue->getNextStudent();
+    }
+    double serveMs = elapsedMs(start);
+
+    for (RQueue *queue : queues) {
+        delete queue;
+    }
+    cout << "\t" << name << ": " << liveBytes / sections << " bytes per section live, " << frozenBytes / sections
+         << " frozen; freeze " << freezeMs << " ms, thaw " << thawMs << " ms, serve " << serveMs << " ms" << endl;
+}
+
+void percentiles(vector<long long> &samples, const char *op) {
+    sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    cout << " " << op << " p50 " << samples[n / 2] << " p99 " << samples[n * 99 / 100] << " p99.9 "
+         << samples[n * 999 / 1000] << " max " << samples[n - 1] << " ns;";
+}
+
+void benchLatency(const vector<Student> &students, STRUCTURE structure, const char *name, bool sorted) {
+    //sorted arrivals reach the queue best-first, every new student becomes the root
+    vector<Student> arrivals(students);
+    if (sorted) {
+        stable_sort(arrivals.begin(), arrivals.end(), [](const Student &lhs, const Student &rhs) {
+            return priorityFn2(lhs) > priorityFn2(rhs);
+        });
+    }
+
+    RQueue queue(priorityFn2, MINHEAP, structure);
+    size_t half = arrivals.size() / 2;
+    for (size_t i = 0; i < half; i++) {
+        queue.insertStudent(arrivals[i]);
+    }
+
+    vector<long long> insertNs, extractNs;
+    insertNs.reserve(arrivals.size() - half);
+    extractNs.reserve(arrivals.size() - half);
+    for (size_t i = half; i < arrivals.size(); i++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        queue.insertStudent(arrivals[i]);
+        chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+        queue.getNextStudent();
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        insertNs.push_back(chrono::duration_cast<chrono::nanoseconds>(middle - start).count());
+        extractNs.push_back(chrono::duration_cast<chrono::nanoseconds>(end - middle).count());
+    }
+
+    cout << "\t" << name << ":";
+    percentiles(insertNs, "insert");
+    percentiles(extractNs, "extract");
+    cout << endl;
+}
+
+int main(int argc, char **argv) {
+    //the number of students can be given on the command line
+    const int numStudents = (argc > 1) ? atoi(argv[1]) : 1000000;
+    vector<Student> students;
+    makeStudents(students, numStudents);
+
+    cout << "\nFill and drain " << numStudents << " students (priorityFn2, MINHEAP):" << endl;
+    benchDrain(students, SKEW, "SKEW");
+    benchDrain(students, LEFTIST, "LEFTIST");
+    benchDrain(students, WBLEFTIST, "WBLEFTIST");
+    benchDrain(students, BINOMIAL, "BINOMIAL");
+    benchDrain(students, DARY, "DARY (d = 4)");
+    benchDrain(students, RADIX, "RADIX");
+
+    cout << "\nMerge " << numStudents << " students from queues of 64, then drain (priorityFn2, MINHEAP):" << endl;
+    benchMerges(students, SKEW, "SKEW");
+    benchMerges(students, LEFTIST, "LEFTIST");
+    benchMerges(students, WBLEFTIST, "WBLEFTIST");
+    benchMerges(students, BINOMIAL, "BINOMIAL");
+
+    cout << "\nAge " << numStudents << " students (priorityFn1, MAXHEAP, one epoch per 1000 inserts):" << endl;
+    benchAging(students, LEFTIST, "LEFTIST");
+    benchAging(students, DARY, "DARY (d = 4)");
+
+    cout << "\nMerge " << numStudents / 5 << " SKEW/MAXHEAP students into " << numStudents - numStudents / 5
+         << " LEFTIST/MINHEAP students:" << endl;
+    benchRekeyMerge(students);
+
+    unsigned int extractEvery[] = {256, 16384};
+    for (unsigned int every : extractEvery) {
+        cout << "\nMerge " << numStudents << " students from sections of 16 into a pool, one extraction per " << every
+             << " merges:" << endl;
+        benchLazyMerge(students, SKEW, "SKEW", every);
+        benchLazyMerge(students, LEFTIST, "LEFTIST", every);
+        benchLazyMerge(students, WBLEFTIST, "WBLEFTIST", every);
+    }
+
+    cout << "\nFill and drain " << numStudents << " students through an external queue (memory budget "
+         << numStudents / 10 << " students):" << endl;
+    benchExternal(students, LEFTIST, "LEFTIST");
+    benchExternal(students, DARY, "DARY (d = 4)");
+
+    cout << "\nFill and drain " << numStudents << " students with a write-ahead journal:" << endl;
+    benchJournal(students, LEFTIST, "LEFTIST");
+    benchJournal(students, DARY, "DARY (d = 4)");
+
+    cout << "\nHand " << numStudents << " students from 4 worker processes to a scheduler, then drain:" << endl;
+    benchShared(students, SKEW, "SKEW");
+    benchShared(students, LEFTIST, "LEFTIST");
+
+    cout << "\nInsert " << numStudents << " students from 4 threads while one thread serves them:" << endl;
+    benchIntake(students, SKEW, "SKEW");
+    benchIntake(students, LEFTIST, "LEFTIST");
+    benchIntake(students, DARY, "DARY (d = 4)");
+
+    cout << "\nAbort batches of 64 students popped from a queue of " << numStudents << ":" << endl;
+    STRUCTURE transactionStructures[] = {SKEW, LEFTIST, BINOMIAL, DARY};
+    const char *transactionNames[] = {"SKEW", "LEFTIST", "BINOMIAL", "DARY"};
+    for (int i = 0; i < 4; i++) {
+        benchTransaction(students, transactionStructures[i], transactionNames[i], false);
+        benchTransaction(students, transactionStructures[i], transactionNames[i], true);
+    }
+
+    cout << "\nAdmit " << numStudents / 10 << " of " << numStudents << " students under 16 policies ("
+         << thread::hardware_concurrency() << " hardware threads):" << endl;
+    int policyThreads[] = {0, 1, 2, 4, 8};
+    for (int threads : policyThreads) {
+        benchPolicies(students, threads);
+    }
+
+    cout << "\nRelease " << numStudents << " students in four waves by level:" << endl;
+    STRUCTURE releaseStructures[] = {SKEW, LEFTIST, DARY};
+    const char *releaseNames[] = {"SKEW", "LEFTIST", "DARY"};
+    for (int i = 0; i < 3; i++) {
+        benchRelease(students, releaseStructures[i], releaseNames[i], false);
+        benchRelease(students, releaseStructures[i], releaseNames[i], true);
+    }
+
+    cout << "\nPop from each of 10000 queues holding " << numStudents << " students:" << endl;
+    STRUCTURE popStructures[] = {SKEW, LEFTIST};
+    const char *popNames[] = {"SKEW", "LEFTIST"};
+    for (int i = 0; i < 2; i++) {
+        benchPopFromEach(students, popStructures[i], popNames[i], false);
+        benchPopFromEach(students, popStructures[i], popNames[i], true);
+    }
+
+    cout << "\nFreeze and thaw " << numStudents << " students in idle sections of 64:" << endl;
+    STRUCTURE freezeStructures[] = {SKEW, DARY, RADIX, BINOMIAL};
+    const char *freezeNames[] = {"SKEW", "DARY", "RADIX", "BINOMIAL"};
+    for (int i = 0; i < 4; i++) {
+        benchFreeze(students, freezeStructures[i], freezeNames[i]);
+    }
+
+    cout << "\nMerge " << numStudents << " students in sections of 64 with one extraction each, then drain:"
+         << endl;
+    STRUCTURE compactStructures[] = {SKEW, LEFTIST, BINOMIAL};
+    const char *compactNames[] = {"SKEW", "LEFTIST", "BINOMIAL"};
+    for (int i = 0; i < 3; i++) {
+        benchCompact(students, compactStructures[i], compactNames[i], false);
+        benchCompact(students, compactStructures[i], compactNames[i], true);
+    }
+
+    cout << "\nKeep " << numStudents << " students in small section queues (SKEW):" << endl;
+    int sectionSizes[] = {4, 12};
+    for (int size : sectionSizes) {
+        benchRegistry(students, size, false);
+        benchRegistry(students, size, true);
+    }
+
+    const char *orders[] = {"random", "best-first"};
+    for (int sorted = 0; sorted < 2; sorted++) {
+        cout << "\nInsert and extract " << numStudents / 2 << " students one by one from a queue of "
+             << numStudents / 2 << " (" << orders[sorted] << " arrivals):" << endl;
+        benchLatency(students, SKEW, "SKEW", sorted);
+        benchLatency(students, LEFTIST, "LEFTIST", sorted);
+        benchLatency(students, WBLEFTIST, "WBLEFTIST", sorted);
+        benchLatency(students, BINOMIAL, "BINOMIAL", sorted);
+    }
+
+    return 0;
+}
+
+int priorityFn1(const Student &student) {
+    //level + major + group, used with a MAXHEAP
+    return student.getLevel() + student.getMajor() + student.getGroup();
+}
+
+int priorityFn2(const Student &student) {
+    //race + gender + income + highschool, used with a MINHEAP
+    return student.getRace() + student.getGender() + student.getIncome() + student.getHighschool();
+}
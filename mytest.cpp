@@ -4,6 +4,10 @@
 #include <random>
 #include <vector>
 #include <ctime>
+#include <sstream>
+#include <set>
+#include <unistd.h>
+#include <sys/wait.h>
 
 using namespace std;
 
@@ -121,6 +125,10 @@ private:
 
 int priorityFn1(const Student &student);
 int priorityFn2(const Student &student);
+int priorityFnWide(const Student &student);
+int64_t priorityFnTimestamp(const Student &student);
+double priorityFnScore(const Student &student);
+int priorityFnStrict(const Student &student);
 
 class Tester {
 public:
@@ -148,15 +156,109 @@ public:
 
     bool testMergeWithQueueError();
 
+    bool testStats();
+
+    bool testDARYHeapProperty();
+    bool testDARYSetStructure();
+    bool testDARYMerge();
+
+    bool testRADIXRemovalOrder();
+    bool testRADIXMonotone();
+
+    bool testPriorityFn64();
+    bool testPriorityFnReal();
+    bool testCachedKeys();
+
+    bool testPrioritySpecOrder();
+    bool testPrioritySpecErrors();
+
+    bool testPooledStorage();
+
+    bool testWBLEFTISTProperty();
+    bool testWBLEFTISTMerge();
+    bool testBINOMIALProperty();
+    bool testBINOMIALMerge();
+
+    bool testIndexLookup();
+    bool testIndexMerge();
+
+    bool testAgingOrder();
+    bool testAgingRekey();
+    bool testAgingRekeyFailure();
+
+    bool testQuotaMaxSeats();
+    bool testQuotaMinShare();
+
+    bool testMergeRekey();
+    bool testMergeRekeyAging();
+    bool testMergeRekeyFailure();
+
+    bool testExternalOrder();
+    bool testExternalRadix();
+
+    bool testJournalRecovery();
+    bool testJournalRingWrap();
+
+    bool testSharedProcesses();
+    bool testSharedRepair();
+
+    bool testIntakeConcurrent();
+    bool testIntakeOrder();
+
+    bool testLazyMergeOrder();
+    bool testLazyMergeSnapshot();
+    bool testLazyMergeDeepCrown();
+
+    bool testCompactLayout();
+    bool testAutoCompact();
+
+    bool testRegistrySections();
+    bool testRegistryMerge();
+
+    bool testFreezeThaw();
+    bool testFreezeSnapshot();
+    bool testFreezeTakeOver();
+
+    bool testCountsIncremental();
+    bool testCountsErrors();
+
+    bool testTransactionRollback();
+    bool testTransactionJournal();
+    bool testTransactionTakeOver();
+
+    bool testPopFromEachOrder();
+    bool testPopFromEachGuards();
+
+    bool testReleaseWaves();
+    bool testReleaseErrors();
+
+    bool testPolicySimulatorOrder();
+    bool testPolicySimulatorErrors();
+
 private:
     void insertMultipleStudents(RQueue &myQueue);
     bool checkHeapProperty(Node *node, prifn_t priorFunc, HEAPTYPE heapType);
     bool checkRemovalOrder(RQueue &myQueue);
     bool checkNPLValue(Node *node);
+    bool checkSharedDrain(SharedQueue &myQueue, int count);
     bool checkLEFTISTProperty(Node *node);
     void storeDataInVector(vector<Node *> &dataVector, Node *node);
     bool checkVectorsContainSameData(vector<Node *> vector1, vector<Node *> vector2);
     bool checkHeapEquivalence(Node *source, Node *destination);
+    bool checkDARYHeapProperty(RQueue &myQueue);
+    bool checkCachedKeys(RQueue &myQueue, Node *node);
+    bool checkWeightValue(Node *node);
+    bool checkWBLEFTISTProperty(Node *node);
+    bool checkBINOMIALProperty(Node *roots, int size);
+    int checkBinomialTree(Node *root);
+    void storeLevelOrder(Node *root, vector<Node *> &nodes);
+    bool checkCompactLayout(Node *root, const vector<Node> &expected);
+    bool checkDrainOrder(RQueue &myQueue, int count);
+    bool checkCounts(const RQueue &myQueue);
+    bool checkPolicyResult(const vector<Student> &corpus, RQueue &policy, const PolicyResult &result, int seats);
+    void insertNamedStudents(RQueue &myQueue, const string &prefix, int count);
+    void insertAgedStudents(RQueue &myQueue, int epochs);
+    bool checkAgedRemovalOrder(RQueue &myQueue, int epochs);
 };
 
 void Tester::insertMultipleStudents(RQueue &myQueue) {
@@ -186,13 +288,13 @@ bool Tester::checkHeapProperty(Node *node, prifn_t priorFunc, HEAPTYPE heapType)
         checkHeapProperty(node->m_left, priorFunc, heapType);
         checkHeapProperty(node->m_right, priorFunc, heapType);
 
-        int currPriority = priorFunc(node->m_student);
+        int currPriority = priorFunc(*node->m_student);
         int leftChildPriority = 0;
         int rightChildPriority = 0;
 
         if (node->m_left != nullptr) {
             //if there is a left child, get its priority
-            leftChildPriority = priorFunc(node->m_left->m_student);
+            leftChildPriority = priorFunc(*node->m_left->m_student);
         } else {
             //otherwise, assign the default priority according to heaptype
             if (heapType == MINHEAP) {
@@ -204,7 +306,7 @@ bool Tester::checkHeapProperty(Node *node, prifn_t priorFunc, HEAPTYPE heapType)
 
         if (node->m_right != nullptr) {
             //if there is a right child, get its priority
-            rightChildPriority = priorFunc(node->m_right->m_student);
+            rightChildPriority = priorFunc(*node->m_right->m_student);
         } else {
             //otherwise, assign the default priority according to heaptype
             if (heapType == MINHEAP) {
@@ -257,8 +359,9 @@ bool Tester::checkRemovalOrder(RQueue &myQueue) {
 bool Tester::checkNPLValue(Node *node) {
     if (node != nullptr) {
         //recursively check whether both left and right sub-heaps have correct NPL values
-        checkNPLValue(node->m_left);
-        checkNPLValue(node->m_right);
+        if (!checkNPLValue(node->m_left) || !checkNPLValue(node->m_right)) {
+            return false;
+        }
 
         int leftChildNPL = 0;
         int rightChildNPL = 0;
@@ -292,8 +395,9 @@ bool Tester::checkNPLValue(Node *node) {
 bool Tester::checkLEFTISTProperty(Node *node) {
     if (node != nullptr) {
         //recursively check whether both left and right sub-heaps satisfy leftist property
-        checkLEFTISTProperty(node->m_left);
-        checkLEFTISTProperty(node->m_right);
+        if (!checkLEFTISTProperty(node->m_left) || !checkLEFTISTProperty(node->m_right)) {
+            return false;
+        }
 
         int leftChildNPL = 0;
         int rightChildNPL = 0;
@@ -356,7 +460,7 @@ bool Tester::checkHeapEquivalence(Node *source, Node *destination) {
         checkHeapEquivalence(source->m_right, destination->m_right);
 
         //compare each student using the overloaded equality operator provided in rqueue.h
-        if (source->m_student == destination->m_student) {
+        if (*source->m_student == *destination->m_student) {
             return true;
         }
         //test fails if any of the students differ
@@ -575,135 +679,3266 @@ bool Tester::testMergeWithQueueError() {
     return false;
 }
 
-int main() {
-    Tester tester;
+bool Tester::testStats() {
+    RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+    insertMultipleStudents(myQueue);
+    myQueue.getNextStudent();
 
-    cout << "\nTesting insertStudent (MINHEAP) - check whether heap property is satisfied after insertion:" << endl;
-    if (tester.testHeapPropertyAfterInsertMINHEAP()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    RQueueStats stats = myQueue.stats();
+
+    //shape must describe all nodes, and a leftist right spine is at most log2(n + 1) long
+    int nplTotal = 0;
+    for (unsigned int i = 0; i < stats.m_nplCounts.size(); i++) {
+        nplTotal += stats.m_nplCounts[i];
     }
-    cout << "Testing insertStudent (MAXHEAP) - check whether heap property is satisfied after insertion:" << endl;
-    if (tester.testHeapPropertyAfterInsertMAXHEAP()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    if (stats.m_nodeCount != myQueue.m_size || nplTotal != myQueue.m_size ||
+        stats.m_rightSpine > log2(myQueue.m_size + 1) || stats.m_avgDepth > stats.m_maxDepth) {
+        return false;
     }
 
-    cout << "\nTesting getNextStudent (MINHEAP) - check whether all removals happen in the correct order:" << endl;
-    if (tester.testRemovalOrderMINHEAP()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+#ifdef RQUEUE_STATS
+    //counters are charged to the public operation that made them
+    if (!stats.m_countersEnabled || stats.m_insert.m_calls != 300 || stats.m_extract.m_calls != 1 ||
+        stats.m_merge.m_calls != 0 || stats.m_insert.m_comparisons == 0 || stats.m_allocations != 300 ||
+        stats.m_deallocations != 1 || stats.m_maxMergeDepth == 0) {
+        return false;
     }
-    cout << "Testing getNextStudent (MAXHEAP) - check whether all removals happen in the correct order:" << endl;
-    if (tester.testRemovalOrderMAXHEAP()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+#endif
+
+    //the JSON dump must carry the same numbers
+    stringstream json;
+    stats.dumpJSON(json);
+    return json.str().find("\"nodeCount\": " + to_string(myQueue.m_size)) != string::npos;
+}
+
+bool Tester::checkDARYHeapProperty(RQueue &myQueue) {
+    if ((int) myQueue.m_entries.size() != myQueue.m_size || myQueue.m_heap != nullptr) {
+        return false;
     }
+    for (unsigned int i = 0; i < myQueue.m_entries.size(); i++) {
+        //the cached key must match the priority of the student it refers to
+        int64_t priority = myQueue.m_priorFunc(*myQueue.m_entries[i].m_student);
+        int64_t expectedKey = (myQueue.m_heapType == MAXHEAP) ? ~priority : priority;
+        if (myQueue.m_entries[i].m_key != expectedKey) {
+            return false;
+        }
 
-    cout << "\nTesting LEFTIST heap - check whether all nodes in a leftist heap have the correct NPL value:" << endl;
-    if (tester.testNPLValue()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+        //no entry may have a smaller key than its parent
+        if (i > 0 && myQueue.m_entries[(i - 1) / myQueue.m_arity].m_key > myQueue.m_entries[i].m_key) {
+            return false;
+        }
     }
-    cout << "Testing LEFTIST heap - check whether leftist heap preserves the property of such a heap:" << endl;
-    if (tester.testLEFTISTProperty()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    return true;
+}
+
+bool Tester::testDARYHeapProperty() {
+    RQueue minQueue(priorityFn2, MINHEAP, DARY);
+    insertMultipleStudents(minQueue);
+
+    RQueue maxQueue(priorityFn1, MAXHEAP, DARY);
+    maxQueue.setArity(3);
+    insertMultipleStudents(maxQueue);
+
+    return checkDARYHeapProperty(minQueue) && checkRemovalOrder(minQueue) && checkDARYHeapProperty(minQueue) &&
+           checkDARYHeapProperty(maxQueue) && checkRemovalOrder(maxQueue) && checkDARYHeapProperty(maxQueue);
+}
+
+bool Tester::testDARYSetStructure() {
+    RQueue myQueue(priorityFn1, MAXHEAP, SKEW);
+    insertMultipleStudents(myQueue);
+
+    //pointer-based heap to array
+    myQueue.setStructure(DARY);
+    if (!checkDARYHeapProperty(myQueue)) {
+        return false;
     }
 
-    cout << "\nTesting setPriorityFn - check whether after changing the priority function a correct heap is rebuilt "
-            "with the same data and the different priority function:" << endl;
-    if (tester.testSetPriorityFn()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    //rebuilds in place after changing the arity or the priority function
+    myQueue.setArity(2);
+    if (!checkDARYHeapProperty(myQueue)) {
+        return false;
     }
-    cout << "Testing setStructure - check whether after changing the structure a correct heap is rebuilt with the same "
-            "data and the different structure:" << endl;
-    if (tester.testSetStructure()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    myQueue.setPriorityFn(priorityFn2, MINHEAP);
+    if (!checkDARYHeapProperty(myQueue)) {
+        return false;
     }
 
-    cout << "\nTesting mergeWithQueue (edge) - successfully merges an empty queue with a normal queue:" << endl;
-    if (tester.testMergeWithQueueEdge()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    //array back to a leftist heap
+    myQueue.setStructure(LEFTIST);
+    vector<Node *> nodes;
+    storeDataInVector(nodes, myQueue.m_heap);
+    return (int) nodes.size() == myQueue.m_size && myQueue.m_entries.empty() && checkNPLValue(myQueue.m_heap) &&
+           checkLEFTISTProperty(myQueue.m_heap) && checkHeapProperty(myQueue.m_heap, priorityFn2, MINHEAP);
+}
+
+bool Tester::testDARYMerge() {
+    RQueue bigQueue(priorityFn2, MINHEAP, DARY);
+    insertMultipleStudents(bigQueue);
+
+    //a small queue is sifted in
+    RQueue smallQueue(priorityFn2, MINHEAP, DARY);
+    smallQueue.insertStudent(Student("Liam Taylor", SENI, CSC, HONO, MINORITY, FEMALE, TIER1, HIGH));
+    bigQueue.mergeWithQueue(smallQueue);
+    if (bigQueue.m_size != 301 || smallQueue.m_size != 0 || !smallQueue.m_entries.empty() ||
+        !checkDARYHeapProperty(bigQueue)) {
+        return false;
     }
 
-    cout << "\nTesting copy constructor (normal) - successfully creates deep copy of normal queue:" << endl;
-    if (tester.testCopyConstructorNormal()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    //a queue of similar size is concatenated and heapified
+    RQueue otherQueue(priorityFn2, MINHEAP, DARY);
+    insertMultipleStudents(otherQueue);
+    bigQueue.mergeWithQueue(otherQueue);
+    return bigQueue.m_size == 601 && otherQueue.m_size == 0 && checkDARYHeapProperty(bigQueue) &&
+           checkRemovalOrder(bigQueue);
+}
+
+bool Tester::testRADIXRemovalOrder() {
+    RQueue minQueue(priorityFn2, MINHEAP, RADIX);
+    insertMultipleStudents(minQueue);
+
+    RQueue maxQueue(priorityFn1, MAXHEAP, SKEW);
+    insertMultipleStudents(maxQueue);
+    maxQueue.setStructure(RADIX);
+
+    return checkRemovalOrder(minQueue) && checkRemovalOrder(maxQueue) && minQueue.m_size == 201 &&
+           maxQueue.m_size == 201 && maxQueue.m_heap == nullptr;
+}
+
+bool Tester::testRADIXMonotone() {
+    //wide priority range, as returned by a scoring function
+    RQueue myQueue(priorityFnWide, MINHEAP, RADIX);
+    insertMultipleStudents(myQueue);
+    int lastPriority = 0;
+    for (int i = 0; i < 150; i++) {
+        int priority = priorityFnWide(myQueue.getNextStudent());
+        if (priority < lastPriority) {
+            return false;
+        }
+        lastPriority = priority;
     }
-    cout << "Testing copy constructor (edge) - successfully creates deep copy of empty queue:" << endl;
-    if (tester.testCopyConstructorEdge()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+
+    //students behind the last one served may still arrive
+    Random randNameObject(97, 122);
+    int inserted = 0;
+    while (inserted < 100) {
+        Student student(randNameObject.getRandString(5), SENI, CSC, HONO, MINORITY, FEMALE, TIER1, HIGH);
+        if (priorityFnWide(student) >= lastPriority) {
+            myQueue.insertStudent(student);
+            inserted++;
+        }
     }
 
-    cout << "\nTesting assignment operator (normal) - successfully creates deep copy of normal queue:" << endl;
-    if (tester.testAssignmentNormal()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    //a student ahead of the last one served breaks monotonicity
+    try {
+        myQueue.insertStudent(Student("aaaaa", SENI, CSC, HONO, MINORITY, FEMALE, TIER1, HIGH));
+        return false;
+    } catch (domain_error &e) {
     }
-    cout << "Testing assignment operator (edge) - successfully creates deep copy of empty queue:" << endl;
-    if (tester.testAssignmentEdge()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    if (myQueue.m_size != 250) {
+        return false;
     }
 
-    cout << "\nTesting getNextStudent (error) - attempting to dequeue an empty queue throws an out_of_range exception:"
-         << endl;
-    if (tester.testRemovalError()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+    //the rest still comes out in order
+    while (myQueue.m_size > 0) {
+        int priority = priorityFnWide(myQueue.getNextStudent());
+        if (priority < lastPriority) {
+            return false;
+        }
+        lastPriority = priority;
     }
+    return true;
+}
 
-    cout << "\nTesting mergeWithQueue (error) - attempting to merge queues with different priority functions throws a "
-            "domain_error exception:" << endl;
-    if (tester.testMergeWithQueueError()) {
-        cout << "\tTest passed!" << endl;
-    } else {
-        cout << "\t***Test failed!***" << endl;
+bool Tester::checkCachedKeys(RQueue &myQueue, Node *node) {
+    if (node != nullptr) {
+        //every cached key must match the key computed from the current priority function
+        return node->m_key == myQueue.rankKey(*node->m_student) && checkCachedKeys(myQueue, node->m_left) &&
+               checkCachedKeys(myQueue, node->m_right);
     }
+    return true;
+}
 
-    return 0;
+bool Tester::testPriorityFn64() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX};
+    for (int i = 0; i < 4; i++) {
+        RQueue myQueue(priorityFnTimestamp, (i % 2 == 0) ? MAXHEAP : MINHEAP, structures[i]);
+        insertMultipleStudents(myQueue);
+
+        //priorities above the int range must still come out in order
+        int64_t prevPriority = priorityFnTimestamp(myQueue.getNextStudent());
+        while (myQueue.m_size > 0) {
+            int64_t currPriority = priorityFnTimestamp(myQueue.getNextStudent());
+            if ((myQueue.m_heapType == MINHEAP && currPriority < prevPriority) ||
+                (myQueue.m_heapType == MAXHEAP && currPriority > prevPriority)) {
+                return false;
+            }
+            prevPriority = currPriority;
+        }
+    }
+    return true;
 }
 
-int priorityFn1(const Student &student) {
-    //this function works with a MAXHEAP
-    //priority value is determined based on some criteria
-    //priority value falls in the range [0-10]
-    //level + major + group
-    //the highest priority would be 3+4+3 = 10
-    //the lowest priority would be 0+0+0 = 0
-    //the larger value means the higher priority
-    int priority = student.getLevel() + student.getMajor() + student.getGroup();
-    return priority;
+bool Tester::testPriorityFnReal() {
+    RQueue myQueue(priorityFnScore, MINHEAP, LEFTIST);
+    insertMultipleStudents(myQueue);
+
+    //a NaN score goes behind every real score
+    myQueue.insertStudent(Student("Nan Score", FRESH, BIO, REGU, MIX, NONE, TIER5, LOW));
+
+    double prevPriority = priorityFnScore(myQueue.getNextStudent());
+    for (int i = 0; i < 299; i++) {
+        double currPriority = priorityFnScore(myQueue.getNextStudent());
+        if (currPriority != currPriority || currPriority < prevPriority) {
+            return false;
+        }
+        prevPriority = currPriority;
+    }
+    Student last = myQueue.getNextStudent();
+    if (last.getName() != "Nan Score") {
+        return false;
+    }
+
+    //queues with different kinds of priority functions cannot be merged
+    RQueue realQueue(priorityFnScore, MINHEAP, SKEW);
+    RQueue intQueue(priorityFn2, MINHEAP, SKEW);
+    insertMultipleStudents(realQueue);
+    insertMultipleStudents(intQueue);
+    try {
+        realQueue.mergeWithQueue(intQueue);
+    } catch (domain_error &e) {
+        return true;
+    }
+    return false;
 }
 
-int priorityFn2(const Student &student) {
-    //this function works with a MINHEAP
-    //priority value is determined based on some criteria
-    //priority value falls in the range [0-10]
-    //race + gender + income + highschool
-    //the highest priority would be 0+0+0+0 = 0
-    //the lowest priority would be 2+2+4+2 = 10
-    //the smaller value means the higher priority
-    int priority = student.getRace() + student.getGender() + student.getIncome() + student.getHighschool();
-    return priority;
+bool Tester::testCachedKeys() {
+    RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+    insertMultipleStudents(myQueue);
+    if (!checkCachedKeys(myQueue, myQueue.m_heap)) {
+        return false;
+    }
+
+    //switching between priority function types recomputes every key
+    myQueue.setPriorityFn(priorityFnScore, MINHEAP);
+    if (!checkCachedKeys(myQueue, myQueue.m_heap) || myQueue.getPriorityFn() != nullptr ||
+        myQueue.getPriorityFnReal() != priorityFnScore || !checkNPLValue(myQueue.m_heap)) {
+        return false;
+    }
+    myQueue.setPriorityFn(priorityFnTimestamp, MAXHEAP);
+    return checkCachedKeys(myQueue, myQueue.m_heap) && myQueue.getPriorityFn64() == priorityFnTimestamp &&
+           checkLEFTISTProperty(myQueue.m_heap);
+}
+
+bool Tester::testPrioritySpecOrder() {
+    //the spec equivalent of priorityFn1 with a MAXHEAP
+    RQueue fnQueue(PrioritySpec("level + major + group desc"), LEFTIST);
+    insertMultipleStudents(fnQueue);
+    int prevPriority = priorityFn1(fnQueue.getNextStudent());
+    while (fnQueue.m_size > 0) {
+        int currPriority = priorityFn1(fnQueue.getNextStudent());
+        if (currPriority > prevPriority) {
+            return false;
+        }
+        prevPriority = currPriority;
+    }
+
+    //lexicographic order over three criteria
+    RQueue myQueue(priorityFn2, MINHEAP, DARY);
+    insertMultipleStudents(myQueue);
+    myQueue.setPrioritySpec(PrioritySpec("Level DESC, group desc, income"));
+    if (myQueue.getHeapType() != MINHEAP || !myQueue.usesPrioritySpec() ||
+        myQueue.getPrioritySpec().toString() != "level desc, group desc, income asc") {
+        return false;
+    }
+    Student prev = myQueue.getNextStudent();
+    while (myQueue.m_size > 0) {
+        Student curr = myQueue.getNextStudent();
+        if (curr.getLevel() > prev.getLevel() ||
+            (curr.getLevel() == prev.getLevel() && curr.getGroup() > prev.getGroup()) ||
+            (curr.getLevel() == prev.getLevel() && curr.getGroup() == prev.getGroup() &&
+             curr.getIncome() < prev.getIncome())) {
+            return false;
+        }
+        prev = curr;
+    }
+    return true;
+}
+
+bool Tester::testPrioritySpecErrors() {
+    //malformed specs throw invalid_argument
+    string badSpecs[] = {"", "gpa desc", "level +", "level sideways", "level, ,group", "2 level"};
+    for (int i = 0; i < 6; i++) {
+        try {
+            PrioritySpec spec(badSpecs[i]);
+            return false;
+        } catch (invalid_argument &e) {
+        }
+    }
+
+    //queues with equal specs merge, different specs do not
+    RQueue queue1(PrioritySpec("income asc, level desc"), SKEW);
+    RQueue queue2(PrioritySpec("income, level  DESC"), SKEW);
+    RQueue queue3(PrioritySpec("level desc, income asc"), SKEW);
+    insertMultipleStudents(queue1);
+    insertMultipleStudents(queue2);
+    insertMultipleStudents(queue3);
+    queue1.mergeWithQueue(queue2);
+    if (queue1.m_size != 600 || queue2.m_size != 0 || !checkCachedKeys(queue1, queue1.m_heap)) {
+        return false;
+    }
+    try {
+        queue1.mergeWithQueue(queue3);
+    } catch (domain_error &e) {
+        return true;
+    }
+    return false;
+}
+
+bool Tester::testPooledStorage() {
+    RQueue myQueue(priorityFn2, MINHEAP, SKEW);
+    insertMultipleStudents(myQueue);
+    RQueue otherQueue(priorityFn2, MINHEAP, SKEW);
+    insertMultipleStudents(otherQueue);
+
+    //after a merge the host owns every node and student, rhs can be refilled from an empty pool
+    myQueue.mergeWithQueue(otherQueue);
+    otherQueue.insertStudent(Student("Liam Taylor", SENI, CSC, HONO, MINORITY, FEMALE, TIER1, HIGH));
+    if (myQueue.m_size != 600 || otherQueue.m_size != 1 || otherQueue.getNextStudent().getName() != "Liam Taylor") {
+        return false;
+    }
+
+    //released nodes and students are recycled, the payload of a reused student is overwritten
+    for (int i = 0; i < 300; i++) {
+        myQueue.getNextStudent();
+    }
+    insertMultipleStudents(myQueue);
+    if (myQueue.m_size != 600 || !checkHeapProperty(myQueue.m_heap, myQueue.m_priorFunc, myQueue.m_heapType)) {
+        return false;
+    }
+
+    //the payload stays out of the node, only the key and links are touched while merging
+    return sizeof(Node) < sizeof(Student) && checkRemovalOrder(myQueue);
+}
+
+bool Tester::checkWeightValue(Node *node) {
+    if (node != nullptr) {
+        //recursively check whether both left and right sub-heaps have correct weights
+        if (!checkWeightValue(node->m_left) || !checkWeightValue(node->m_right)) {
+            return false;
+        }
+
+        int leftChildWeight = (node->m_left != nullptr) ? node->m_left->m_weight : 0;
+        int rightChildWeight = (node->m_right != nullptr) ? node->m_right->m_weight : 0;
+
+        //the weight of each node is the size of its subtree
+        return node->m_weight == leftChildWeight + rightChildWeight + 1;
+    }
+    //test passes if heap is empty
+    return true;
+}
+
+bool Tester::checkWBLEFTISTProperty(Node *node) {
+    if (node != nullptr) {
+        //recursively check whether both left and right sub-heaps satisfy the weight-biased leftist property
+        if (!checkWBLEFTISTProperty(node->m_left) || !checkWBLEFTISTProperty(node->m_right)) {
+            return false;
+        }
+
+        int leftChildWeight = (node->m_left != nullptr) ? node->m_left->m_weight : 0;
+        int rightChildWeight = (node->m_right != nullptr) ? node->m_right->m_weight : 0;
+
+        return leftChildWeight >= rightChildWeight;
+    }
+    //test passes if heap is empty
+    return true;
+}
+
+bool Tester::testWBLEFTISTProperty() {
+    RQueue myQueue(priorityFn1, MAXHEAP, WBLEFTIST);
+    insertMultipleStudents(myQueue);
+    if (!checkWeightValue(myQueue.m_heap) || !checkWBLEFTISTProperty(myQueue.m_heap) ||
+        !checkHeapProperty(myQueue.m_heap, priorityFn1, MAXHEAP) || myQueue.m_heap->getWeight() != 300) {
+        return false;
+    }
+
+    //removals merge the two sub-heaps of the root, the weights must stay exact
+    if (!checkRemovalOrder(myQueue)) {
+        return false;
+    }
+    return checkWeightValue(myQueue.m_heap) && checkWBLEFTISTProperty(myQueue.m_heap) &&
+           myQueue.m_heap->getWeight() == myQueue.m_size;
+}
+
+bool Tester::testWBLEFTISTMerge() {
+    RQueue myQueue(priorityFn2, MINHEAP, WBLEFTIST);
+    insertMultipleStudents(myQueue);
+
+    //a leftist heap is rebuilt with weights when its structure changes
+    RQueue otherQueue(priorityFn2, MINHEAP, LEFTIST);
+    insertMultipleStudents(otherQueue);
+    otherQueue.setStructure(WBLEFTIST);
+    if (!checkWeightValue(otherQueue.m_heap) || !checkWBLEFTISTProperty(otherQueue.m_heap)) {
+        return false;
+    }
+
+    myQueue.mergeWithQueue(otherQueue);
+    if (myQueue.m_size != 600 || otherQueue.m_heap != nullptr || myQueue.m_heap->getWeight() != 600 ||
+        !checkWeightValue(myQueue.m_heap) || !checkWBLEFTISTProperty(myQueue.m_heap) ||
+        !checkHeapProperty(myQueue.m_heap, priorityFn2, MINHEAP)) {
+        return false;
+    }
+
+    //weight-biased and NPL-based leftist heaps are different structures and cannot be merged
+    RQueue leftistQueue(priorityFn2, MINHEAP, LEFTIST);
+    try {
+        myQueue.mergeWithQueue(leftistQueue);
+    } catch (domain_error &e) {
+        return checkRemovalOrder(myQueue);
+    }
+    return false;
+}
+
+bool Tester::checkBINOMIALProperty(Node *roots, int size) {
+    //root degrees strictly increase along the root list and the trees hold all the nodes
+    int prevDegree = -1;
+    int count = 0;
+    for (Node *root = roots; root != nullptr; root = root->m_right) {
+        int treeSize = checkBinomialTree(root);
+        if (root->m_npl <= prevDegree || treeSize < 0) {
+            return false;
+        }
+        prevDegree = root->m_npl;
+        count += treeSize;
+    }
+    return count == size;
+}
+
+int Tester::checkBinomialTree(Node *root) {
+    //a tree of degree k has children of degree k-1 down to 0, none of which outranks the root;
+    //returns the number of nodes in the tree, or -1 if it is not a binomial tree
+    int expectedDegree = root->m_npl - 1;
+    int count = 1;
+    for (Node *child = root->m_left; child != nullptr; child = child->m_right) {
+        int childSize = checkBinomialTree(child);
+        if (child->m_npl != expectedDegree || childSize < 0 || child->m_key < root->m_key) {
+            return -1;
+        }
+        expectedDegree--;
+        count += childSize;
+    }
+    return (expectedDegree == -1 && count == (1 << root->m_npl)) ? count : -1;
+}
+
+bool Tester::testBINOMIALProperty() {
+    RQueue myQueue(priorityFn1, MAXHEAP, BINOMIAL);
+    insertMultipleStudents(myQueue);
+    if (!checkBINOMIALProperty(myQueue.m_heap, 300)) {
+        return false;
+    }
+
+    //removals merge the children of the best root back into the root list
+    if (!checkRemovalOrder(myQueue) || !checkBINOMIALProperty(myQueue.m_heap, myQueue.m_size)) {
+        return false;
+    }
+
+    //the drain order matches a leftist heap holding the same students
+    RQueue leftistQueue(priorityFn1, MAXHEAP, LEFTIST);
+    RQueue binomialQueue(priorityFn1, MAXHEAP, BINOMIAL);
+    insertNamedStudents(leftistQueue, "Student ", 500);
+    insertNamedStudents(binomialQueue, "Student ", 500);
+    while (leftistQueue.numStudents() > 0) {
+        if (priorityFn1(leftistQueue.getNextStudent()) != priorityFn1(binomialQueue.getNextStudent())) {
+            return false;
+        }
+    }
+    return binomialQueue.numStudents() == 0 && binomialQueue.m_heap == nullptr;
+}
+
+bool Tester::testBINOMIALMerge() {
+    RQueue myQueue(priorityFn2, MINHEAP, BINOMIAL);
+    insertMultipleStudents(myQueue);
+
+    //a skew heap is rebuilt into binomial trees when its structure changes
+    RQueue otherQueue(priorityFn2, MINHEAP, SKEW);
+    insertMultipleStudents(otherQueue);
+    otherQueue.setStructure(BINOMIAL);
+    if (!checkBINOMIALProperty(otherQueue.m_heap, 300)) {
+        return false;
+    }
+
+    myQueue.mergeWithQueue(otherQueue);
+    if (myQueue.m_size != 600 || otherQueue.m_heap != nullptr || !checkBINOMIALProperty(myQueue.m_heap, 600)) {
+        return false;
+    }
+
+    //converting back to a binary structure keeps every student
+    myQueue.setStructure(LEFTIST);
+    if (myQueue.m_size != 600 || !checkHeapProperty(myQueue.m_heap, priorityFn2, MINHEAP)) {
+        return false;
+    }
+    myQueue.setStructure(BINOMIAL);
+
+    //binomial trees and leftist heaps are different structures and cannot be merged
+    RQueue leftistQueue(priorityFn2, MINHEAP, LEFTIST);
+    try {
+        myQueue.mergeWithQueue(leftistQueue);
+    } catch (domain_error &e) {
+        return checkBINOMIALProperty(myQueue.m_heap, 600) && checkRemovalOrder(myQueue);
+    }
+    return false;
+}
+
+
+void Tester::insertNamedStudents(RQueue &myQueue, const string &prefix, int count) {
+    //students with distinct names, so they can be held by an indexed queue
+    for (int i = 0; i < count; i++) {
+        myQueue.insertStudent(Student(prefix + to_string(i), i % 4, i % 5, i % 4, i % 3, (i / 3) % 3, i % 5, i % 3));
+    }
+}
+
+bool Tester::testIndexLookup() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        RQueue myQueue(priorityFn2, MINHEAP, structure);
+        myQueue.setIndexed(true);
+        insertNamedStudents(myQueue, "Student ", 200);
+
+        //a student with a name that is already queued is rejected
+        try {
+            myQueue.insertStudent(Student("Student 7", FRESH, BIO, RESE, MAJORITY, MALE, TIER5, HIGH));
+            return false;
+        } catch (invalid_argument &e) {
+        }
+
+        Student found;
+        if (!myQueue.contains("Student 42") || myQueue.contains("Student 200") ||
+            !myQueue.find("Student 42", found) || found.getName() != "Student 42" || myQueue.find("Nobody", found)) {
+            return false;
+        }
+
+        //withdrawn students are no longer queued and never come out of the queue
+        for (int i = 0; i < 200; i += 2) {
+            if (!myQueue.erase("Student " + to_string(i))) {
+                return false;
+            }
+        }
+        if (myQueue.erase("Student 0") || myQueue.contains("Student 0") || myQueue.numStudents() != 100 ||
+            myQueue.m_size != 200) {
+            return false;
+        }
+
+        //once more than half of the heap is withdrawn, the withdrawn students are dropped from it
+        myQueue.erase("Student 1");
+        if (myQueue.numStudents() != 99 || myQueue.m_size != 99) {
+            return false;
+        }
+        myQueue.erase("Student 3");
+        if (myQueue.numStudents() != 98 || myQueue.m_size != 99) {
+            return false;
+        }
+        int prevPriority = -1;
+        for (int i = 0; i < 98; i++) {
+            Student student = myQueue.getNextStudent();
+            int priority = priorityFn2(student);
+            int number = stoi(student.getName().substr(8));
+            if (number % 2 == 0 || number == 1 || number == 3 || priority < prevPriority ||
+                myQueue.contains(student.getName())) {
+                return false;
+            }
+            prevPriority = priority;
+        }
+
+        //a withdrawn name can be queued again
+        myQueue.insertStudent(Student("Student 0", FRESH, BIO, RESE, MAJORITY, MALE, TIER5, HIGH));
+        if (myQueue.numStudents() != 1 || !myQueue.contains("Student 0") ||
+            myQueue.getNextStudent().getName() != "Student 0") {
+            return false;
+        }
+    }
+
+    //queues without an index cannot answer lookups
+    RQueue plainQueue(priorityFn2, MINHEAP, SKEW);
+    try {
+        plainQueue.contains("Student 0");
+    } catch (domain_error &e) {
+        return true;
+    }
+    return false;
+}
+
+bool Tester::testIndexMerge() {
+    RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+    myQueue.setIndexed(true);
+    insertNamedStudents(myQueue, "Host ", 100);
+    myQueue.erase("Host 5");
+
+    //a copy keeps the index and the withdrawn students
+    RQueue copyQueue(myQueue);
+    if (!copyQueue.isIndexed() || copyQueue.contains("Host 5") || !copyQueue.contains("Host 6") ||
+        copyQueue.numStudents() != 99) {
+        return false;
+    }
+
+    //a queue that shares a student cannot be merged, and both queues stay as they were
+    RQueue otherQueue(priorityFn1, MAXHEAP, LEFTIST);
+    insertNamedStudents(otherQueue, "Other ", 100);
+    otherQueue.insertStudent(Student("Host 3", FRESH, BIO, RESE, MAJORITY, MALE, TIER5, HIGH));
+    try {
+        myQueue.mergeWithQueue(otherQueue);
+        return false;
+    } catch (domain_error &e) {
+    }
+    if (myQueue.numStudents() != 99 || otherQueue.numStudents() != 101 || myQueue.contains("Other 0")) {
+        return false;
+    }
+
+    //after a successful merge the host index covers the students of rhs
+    otherQueue.setIndexed(true);
+    otherQueue.erase("Host 3");
+    myQueue.mergeWithQueue(otherQueue);
+    if (myQueue.numStudents() != 199 || !myQueue.contains("Other 99") || myQueue.contains("Host 5") ||
+        !myQueue.contains("Host 3") || otherQueue.contains("Other 0") || otherQueue.numStudents() != 0 ||
+        !checkLEFTISTProperty(myQueue.m_heap)) {
+        return false;
+    }
+
+    //switching the index off drops the withdrawn students for good
+    myQueue.setIndexed(false);
+    return myQueue.m_size == 199 && myQueue.numStudents() == 199 && checkRemovalOrder(myQueue);
+}
+
+void Tester::insertAgedStudents(RQueue &myQueue, int epochs) {
+    //20 students per epoch, the enqueue epoch is encoded in the name
+    for (int epoch = 0; epoch < epochs; epoch++) {
+        insertNamedStudents(myQueue, to_string(epoch) + "-", 20);
+        myQueue.advanceEpoch();
+    }
+}
+
+bool Tester::checkAgedRemovalOrder(RQueue &myQueue, int epochs) {
+    //the aged priority of a student is its priority plus (or minus) the time it has waited
+    int sign = (myQueue.m_heapType == MAXHEAP) ? 1 : -1;
+    long long prevPriority = 0;
+    for (int i = 0; i < 20 * epochs; i++) {
+        Student student = myQueue.getNextStudent();
+        int epoch = stoi(student.getName().substr(0, student.getName().find('-')));
+        long long priority = myQueue.m_priorFunc(student) + sign * myQueue.getAgingRate() * (myQueue.getEpoch() - epoch);
+        if (i > 0 && sign * priority > sign * prevPriority) {
+            return false;
+        }
+        prevPriority = priority;
+    }
+    return myQueue.numStudents() == 0;
+}
+
+bool Tester::testAgingOrder() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        RQueue maxQueue(priorityFn1, MAXHEAP, structure);
+        maxQueue.setAgingRate(1);
+        insertAgedStudents(maxQueue, 15);
+
+        RQueue minQueue(priorityFn2, MINHEAP, structure);
+        minQueue.setAgingRate(2);
+        insertAgedStudents(minQueue, 15);
+
+        //ticks only move the epoch, the stored keys stay untouched
+        Node *root = minQueue.m_heap;
+        int64_t rootKey = (root != nullptr) ? root->m_key : 0;
+        minQueue.advanceEpoch(5);
+        if ((root != nullptr && (minQueue.m_heap != root || root->m_key != rootKey)) || minQueue.getEpoch() != 20) {
+            return false;
+        }
+
+        if (!checkAgedRemovalOrder(maxQueue, 15) || !checkAgedRemovalOrder(minQueue, 15)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testAgingRekey() {
+    RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+    myQueue.setAgingRate(1);
+    insertAgedStudents(myQueue, 10);
+
+    //students keep their waiting time when the priority function or the rate changes
+    myQueue.setPriorityFn(priorityFn1, MAXHEAP);
+    myQueue.setAgingRate(3);
+    if (!checkLEFTISTProperty(myQueue.m_heap) || !checkAgedRemovalOrder(myQueue, 10)) {
+        return false;
+    }
+
+    //aging needs integer priorities, a rate that is not negative, and queues at the same epoch to merge
+    RQueue otherQueue(priorityFn1, MAXHEAP, LEFTIST);
+    otherQueue.setAgingRate(3);
+    int errors = 0;
+    try {
+        myQueue.setAgingRate(-1);
+    } catch (out_of_range &e) {
+        errors++;
+    }
+    try {
+        myQueue.setPriorityFn(priorityFnScore, MAXHEAP);
+    } catch (domain_error &e) {
+        errors++;
+    }
+    try {
+        myQueue.mergeWithQueue(otherQueue);
+    } catch (domain_error &e) {
+        errors++;
+    }
+    otherQueue.advanceEpoch(10);
+    myQueue.mergeWithQueue(otherQueue);
+    return errors == 3 && myQueue.getAgingRate() == 3 && myQueue.getPriorityFn() == priorityFn1;
+}
+
+bool Tester::testAgingRekeyFailure() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        //a rate whose aged keys overflow leaves the old rate and the old keys in place
+        RQueue rateQueue(priorityFn1, MAXHEAP, structure);
+        rateQueue.setAgingRate(1);
+        insertAgedStudents(rateQueue, 10);
+        int errors = 0;
+        try {
+            rateQueue.setAgingRate(INT64_MAX / 6);
+        } catch (overflow_error &e) {
+            errors++;
+        }
+        if (errors != 1 || rateQueue.getAgingRate() != 1 || !checkAgedRemovalOrder(rateQueue, 10)) {
+            return false;
+        }
+
+        //a priority function whose aged keys overflow leaves the old function in place; at this rate the
+        //enqueue epoch dominates, so students leave by epoch and then by priority
+        RQueue wideQueue(priorityFn1, MINHEAP, structure);
+        wideQueue.setAgingRate((INT64_MAX - 10000) / 9);
+        insertAgedStudents(wideQueue, 10);
+        try {
+            wideQueue.setPriorityFn(priorityFnTimestamp, MINHEAP);
+        } catch (overflow_error &e) {
+            errors++;
+        }
+        if (errors != 2 || wideQueue.getPriorityFn() != priorityFn1 || wideQueue.getPriorityFn64() != nullptr) {
+            return false;
+        }
+        pair<int, int> prevRank(0, 0);
+        for (int i = 0; i < 200; i++) {
+            Student student = wideQueue.getNextStudent();
+            pair<int, int> rank(stoi(student.getName().substr(0, student.getName().find('-'))), priorityFn1(student));
+            if (rank < prevRank) {
+                return false;
+            }
+            prevRank = rank;
+        }
+        if (wideQueue.numStudents() != 0) {
+            return false;
+        }
+
+        //a priority function that throws part way through leaves the old function in place
+        RQueue strictQueue(priorityFn1, MAXHEAP, structure);
+        strictQueue.setAgingRate(2);
+        insertAgedStudents(strictQueue, 5);
+        strictQueue.insertStudent(Student("Unranked student", SENI, CSC, HONO, MINORITY, FEMALE, TIER1, HIGH));
+        strictQueue.advanceEpoch();
+        try {
+            strictQueue.setPriorityFn(priorityFnStrict, MAXHEAP);
+        } catch (invalid_argument &e) {
+            errors++;
+        }
+        if (errors != 3 || strictQueue.getPriorityFn() != priorityFn1 || strictQueue.getAgingRate() != 2) {
+            return false;
+        }
+        long long prevPriority = 0;
+        for (int i = 0; i < 101; i++) {
+            Student student = strictQueue.getNextStudent();
+            int epoch = (student.getName() == "Unranked student")
+                            ? 5
+                            : stoi(student.getName().substr(0, student.getName().find('-')));
+            long long priority = priorityFn1(student) + 2LL * (strictQueue.getEpoch() - epoch);
+            if (i > 0 && priority > prevPriority) {
+                return false;
+            }
+            prevPriority = priority;
+        }
+        if (strictQueue.numStudents() != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testQuotaMaxSeats() {
+    RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+    insertMultipleStudents(myQueue);
+    QuotaQueue quotaQueue(myQueue, ATTR_MAJOR);
+    quotaQueue.setQuota(CSC, 10);
+    quotaQueue.setQuota(BIO, 0);
+    quotaQueue.insertStudent(Student("Liam Taylor", SENI, CSC, HONO, MINORITY, FEMALE, TIER1, HIGH));
+    if (myQueue.numStudents() != 0 || quotaQueue.numStudents() != 301) {
+        return false;
+    }
+
+    //skipping classes at their quota never lets a lower priority student ahead of a higher one
+    int admitted = 0;
+    int prevPriority = MAX;
+    try {
+        while (true) {
+            Student student = quotaQueue.getNextStudent();
+            if (priorityFn1(student) > prevPriority || student.getMajor() == BIO) {
+                return false;
+            }
+            prevPriority = priorityFn1(student);
+            admitted++;
+        }
+    } catch (out_of_range &e) {
+    }
+
+    //the students that were not admitted go back into a queue
+    int majorCounts[CSC + 1] = {0, 0, 0, 0, 0};
+    quotaQueue.releaseInto(myQueue);
+    int remaining = myQueue.numStudents();
+    while (myQueue.numStudents() > 0) {
+        majorCounts[myQueue.getNextStudent().getMajor()]++;
+    }
+    return quotaQueue.seatsTaken(CSC) == 10 && quotaQueue.seatsTaken(BIO) == 0 && admitted + remaining == 301 &&
+           remaining == majorCounts[BIO] + majorCounts[CSC] && quotaQueue.numStudents() == 0;
+}
+
+bool Tester::testQuotaMinShare() {
+    STRUCTURE structures[] = {SKEW, DARY, RADIX};
+    for (STRUCTURE structure : structures) {
+        RQueue myQueue(priorityFn1, MAXHEAP, structure);
+        insertMultipleStudents(myQueue);
+        int regularCount = 0;
+        RQueue copyQueue(myQueue);
+        while (copyQueue.numStudents() > 0) {
+            regularCount += (copyQueue.getNextStudent().getGroup() == REGU) ? 1 : 0;
+        }
+
+        //50 seats, at least 30 of them for regular students, who have the lowest priority
+        QuotaQueue quotaQueue(myQueue, ATTR_GROUP);
+        quotaQueue.setSeats(50);
+        quotaQueue.setQuota(REGU, -1, 30);
+        int regular = 0;
+        for (int i = 0; i < 50; i++) {
+            regular += (quotaQueue.getNextStudent().getGroup() == REGU) ? 1 : 0;
+        }
+        if (regular < min(30, regularCount) || quotaQueue.seatsTaken(REGU) != regular) {
+            return false;
+        }
+
+        //all seats are taken
+        try {
+            quotaQueue.getNextStudent();
+            return false;
+        } catch (out_of_range &e) {
+        }
+        if (quotaQueue.numStudents() != 250) {
+            return false;
+        }
+    }
+
+    //attribute values outside the enum have no class
+    RQueue myQueue(priorityFn1, MAXHEAP, SKEW);
+    QuotaQueue quotaQueue(myQueue, ATTR_GROUP);
+    try {
+        quotaQueue.setQuota(RESE + 1, 5);
+    } catch (out_of_range &e) {
+        return true;
+    }
+    return false;
+}
+
+bool Tester::testMergeRekey() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE hostStructure : structures) {
+        for (STRUCTURE rhsStructure : structures) {
+            RQueue hostQueue(priorityFn2, MINHEAP, hostStructure);
+            insertMultipleStudents(hostQueue);
+
+            //rhs differs in priority function, heap type and (mostly) structure
+            RQueue rhsQueue(priorityFn1, MAXHEAP, rhsStructure);
+            insertMultipleStudents(rhsQueue);
+            hostQueue.mergeWithQueue(rhsQueue, MERGE_REKEY);
+
+            if (hostQueue.m_size != 600 || rhsQueue.numStudents() != 0 || hostQueue.m_structure != hostStructure ||
+                hostQueue.m_priorFunc != priorityFn2 || hostQueue.m_heapType != MINHEAP) {
+                return false;
+            }
+            if (hostStructure == DARY && !checkDARYHeapProperty(hostQueue)) {
+                return false;
+            }
+            if ((hostStructure == LEFTIST && !checkLEFTISTProperty(hostQueue.m_heap)) ||
+                (hostStructure == WBLEFTIST && !checkWBLEFTISTProperty(hostQueue.m_heap))) {
+                return false;
+            }
+            int prevPriority = MIN;
+            while (hostQueue.numStudents() > 0) {
+                int priority = priorityFn2(hostQueue.getNextStudent());
+                if (priority < prevPriority) {
+                    return false;
+                }
+                prevPriority = priority;
+            }
+        }
+    }
+
+    //the plain merge still refuses queues with another configuration
+    RQueue hostQueue(priorityFn2, MINHEAP, SKEW);
+    RQueue rhsQueue(priorityFn2, MINHEAP, LEFTIST);
+    try {
+        hostQueue.mergeWithQueue(rhsQueue, MERGE_SAME);
+    } catch (domain_error &e) {
+        return true;
+    }
+    return false;
+}
+
+bool Tester::testMergeRekeyAging() {
+    //rhs students keep the time they have waited, measured on the host's clock
+    RQueue hostQueue(priorityFn1, MAXHEAP, LEFTIST);
+    hostQueue.setAgingRate(1);
+    hostQueue.advanceEpoch(100);
+    RQueue rhsQueue(priorityFn1, MAXHEAP, DARY);
+    rhsQueue.setAgingRate(1);
+    insertAgedStudents(rhsQueue, 10);
+    insertAgedStudents(hostQueue, 10);
+
+    //rhs is at epoch 10 and the host at epoch 110, so every student has waited 0 to 9 epochs
+    hostQueue.mergeWithQueue(rhsQueue, MERGE_REKEY);
+    if (hostQueue.m_size != 400 || hostQueue.getEpoch() != 110 || !checkLEFTISTProperty(hostQueue.m_heap)) {
+        return false;
+    }
+    int prevPriority = 0;
+    for (int i = 0; i < 400; i++) {
+        Student student = hostQueue.getNextStudent();
+        //the name holds the epoch relative to the start of each queue's inserts
+        int epoch = stoi(student.getName().substr(0, student.getName().find('-')));
+        int priority = priorityFn1(student) + 10 - epoch;
+        if (i > 0 && priority > prevPriority) {
+            return false;
+        }
+        prevPriority = priority;
+    }
+    return true;
+}
+
+bool Tester::testMergeRekeyFailure() {
+    //the host's priority function throws for one student, or its aged keys overflow
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        for (int overflow = 0; overflow < 2; overflow++) {
+            RQueue host(priorityFnStrict, MAXHEAP, LEFTIST);
+            if (overflow) {
+                host.setPriorityFn(priorityFn1, MAXHEAP);
+                host.setAgingRate(INT64_MAX / 4);
+                host.advanceEpoch(8);
+            } else {
+                insertNamedStudents(host, "Host ", 10);
+            }
+            RQueue myQueue(priorityFn2, MINHEAP, structure);
+            insertNamedStudents(myQueue, "Student ", 20);
+            myQueue.insertStudent(Student("Unranked student", 0, 0, 0, 0, 0, 0, 0));
+            RQueue expected(myQueue);
+            try {
+                host.mergeWithQueue(myQueue, MERGE_REKEY);
+                return false;
+            } catch (invalid_argument &e) {
+            } catch (overflow_error &e) {
+            }
+
+            //the queue keeps its configuration and every student, and still serves them in order
+            if (host.numStudents() != (overflow ? 0 : 10) || myQueue.numStudents() != 21 ||
+                myQueue.getPriorityFn() != priorityFn2 || myQueue.getStructure() != structure ||
+                !checkCounts(myQueue)) {
+                return false;
+            }
+            while (expected.numStudents() > 0) {
+                if (priorityFn2(myQueue.getNextStudent()) != priorityFn2(expected.getNextStudent())) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool Tester::testExternalOrder() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        RQueue myQueue(priorityFn2, MINHEAP, structure);
+        insertMultipleStudents(myQueue);
+        RQueue inMemory(myQueue);
+
+        //a budget of 16 students: the queue itself becomes the first run, read back 4 records at a time
+        ExternalQueue external(myQueue, 16, ".", 4);
+        if (myQueue.numStudents() != 0 || external.numRuns() != 1 || external.spilledStudents() != 300) {
+            return false;
+        }
+
+        //interleaved inserts and removals spill more runs, and both queues serve the same priorities
+        RQueue newStudents(priorityFnWide, MINHEAP, SKEW);
+        insertMultipleStudents(newStudents);
+        string spilledPath = external.m_runs.front()->m_path;
+        int maxRuns = 0;
+        while (newStudents.numStudents() > 0) {
+            Student student = newStudents.getNextStudent();
+            external.insertStudent(student);
+            inMemory.insertStudent(student);
+            if (newStudents.numStudents() % 3 == 0 &&
+                priorityFn2(external.getNextStudent()) != priorityFn2(inMemory.getNextStudent())) {
+                return false;
+            }
+            maxRuns = max(maxRuns, external.numRuns());
+        }
+        if (maxRuns < 2 || maxRuns > external.m_maxRuns || external.numStudents() != inMemory.numStudents()) {
+            return false;
+        }
+        while (inMemory.numStudents() > 0) {
+            if (priorityFn2(external.getNextStudent()) != priorityFn2(inMemory.getNextStudent())) {
+                return false;
+            }
+        }
+
+        //run files are removed once they are served
+        ifstream spilledFile(spilledPath.c_str());
+        if (external.numStudents() != 0 || external.numRuns() != 0 || spilledFile.is_open()) {
+            return false;
+        }
+    }
+
+    //the budget must leave room for the insertion heap and two read buffers
+    RQueue myQueue(priorityFn2, MINHEAP, SKEW);
+    try {
+        ExternalQueue external(myQueue, 3, ".");
+    } catch (invalid_argument &e) {
+        return true;
+    }
+    return false;
+}
+
+bool Tester::testExternalRadix() {
+    RQueue myQueue(priorityFn1, MAXHEAP, RADIX);
+    insertMultipleStudents(myQueue);
+    ExternalQueue external(myQueue, 8, ".", 2);
+    Student best("Ava Young", SENI, CSC, RESE, MINORITY, FEMALE, TIER1, HIGH);
+
+    //serve past the students of the highest priority
+    int prevPriority = MAX;
+    Student student = external.getNextStudent();
+    while (priorityFn1(student) == MAX) {
+        student = external.getNextStudent();
+    }
+
+    //a student ahead of the last one served is rejected, even though it would go to the insertion heap
+    prevPriority = priorityFn1(student);
+    try {
+        external.insertStudent(best);
+        return false;
+    } catch (domain_error &e) {
+    }
+    for (int i = 0; i < 20; i++) {
+        external.insertStudent(student);
+    }
+    while (external.numStudents() > 0) {
+        student = external.getNextStudent();
+        if (priorityFn1(student) > prevPriority) {
+            return false;
+        }
+        prevPriority = priorityFn1(student);
+    }
+    return true;
+}
+
+bool Tester::testJournalRecovery() {
+    const string journalPath = "rqueue-test.journal";
+    const string snapshotPath = "rqueue-test.snapshot";
+    RQueue expected(priorityFn1, MAXHEAP, SKEW);
+    long long journaled = 0;
+    {
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        journal.registerPriorityFn("priorityFn2", priorityFn2);
+        RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+        insertNamedStudents(myQueue, "Snapshot ", 50);
+        journal.attach(myQueue);
+
+        //every kind of operation is journaled
+        myQueue.setIndexed(true);
+        insertNamedStudents(myQueue, "Student ", 200);
+        for (int i = 0; i < 30; i++) {
+            myQueue.getNextStudent();
+        }
+        myQueue.erase("Student 8");
+        myQueue.setStructure(SKEW);
+        myQueue.setAgingRate(2);
+        myQueue.advanceEpoch(5);
+        RQueue otherQueue(priorityFn1, MAXHEAP, SKEW);
+        otherQueue.setAgingRate(2);
+        otherQueue.advanceEpoch(5);
+        insertNamedStudents(otherQueue, "Merged ", 100);
+        myQueue.mergeWithQueue(otherQueue);
+        myQueue.setPriorityFn(priorityFn2, MINHEAP);
+        myQueue.setStructure(DARY);
+        myQueue.setArity(3);
+        for (int i = 0; i < 20; i++) {
+            myQueue.getNextStudent();
+        }
+
+        //after a checkpoint only the later operations are left in the journal
+        journal.checkpoint();
+        insertNamedStudents(myQueue, "Late ", 40);
+        myQueue.setStructure(WBLEFTIST);
+        for (int i = 0; i < 10; i++) {
+            myQueue.getNextStudent();
+        }
+        journal.flush();
+        journaled = journal.getSequence();
+        expected = myQueue;
+    }
+
+    //the crash tore the last record
+    {
+        ofstream journalFile(journalPath.c_str(), ios::binary | ios::app);
+        journalFile.write("\x20\x00\x00", 3);
+    }
+
+    bool result = true;
+    {
+        RQueue recovered(priorityFn1, MAXHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        journal.registerPriorityFn("priorityFn2", priorityFn2);
+        long long replayed = journal.recover(recovered);
+        if (replayed != 51 || journal.getSequence() != journaled || recovered.getStructure() != WBLEFTIST ||
+            recovered.getPriorityFn() != priorityFn2 || recovered.getAgingRate() != 2 || !recovered.isIndexed() ||
+            recovered.numStudents() != expected.numStudents()) {
+            result = false;
+        }
+
+        //a function the journal cannot name is rejected before the queue changes
+        try {
+            recovered.setPriorityFn(priorityFnWide, MINHEAP);
+            result = false;
+        } catch (invalid_argument &e) {
+        }
+
+        //the recovered queue serves exactly the students the crashed one would have
+        while (result && expected.numStudents() > 0) {
+            result = (expected.getNextStudent() == recovered.getNextStudent());
+        }
+
+        RQueue realQueue(priorityFnScore, MINHEAP, SKEW);
+        try {
+            journal.attach(realQueue);
+            result = false;
+        } catch (invalid_argument &e) {
+        }
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+
+    //a peek that drops withdrawn tops and purges the dummies of a lazy merge changes the heap, so it is replayed
+    //and students with equal keys still come out in the same order
+    RQueue expectedTies(priorityFn2, MINHEAP, SKEW);
+    {
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn2", priorityFn2);
+        RQueue myQueue(priorityFn2, MINHEAP, SKEW);
+        journal.attach(myQueue);
+        myQueue.setIndexed(true);
+        myQueue.setLazyMerge(true);
+        for (int i = 0; i < 20; i++) {
+            myQueue.insertStudent(Student("Tie " + to_string(i), 1, 1, 1, 1, 1, 1, 1));
+        }
+        myQueue.erase(myQueue.m_heap->m_student->m_name);
+        myQueue.erase("Tie 5");
+        myQueue.erase("Tie 12");
+        RQueue otherQueue(priorityFn2, MINHEAP, SKEW);
+        for (int i = 0; i < 5; i++) {
+            otherQueue.insertStudent(Student("Merged tie " + to_string(i), 1, 1, 1, 1, 1, 1, 1));
+        }
+        myQueue.mergeWithQueue(otherQueue);
+        myQueue.peekNextStudent();
+        for (int i = 0; i < 20; i++) {
+            myQueue.insertStudent(Student("Late tie " + to_string(i), 1, 1, 1, 1, 1, 1, 1));
+        }
+        journal.flush();
+        expectedTies = myQueue;
+    }
+    {
+        RQueue recovered(priorityFn2, MINHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn2", priorityFn2);
+        journal.recover(recovered);
+        journal.detach();
+        result = result && recovered.numStudents() == 42;
+        while (result && expectedTies.numStudents() > 0) {
+            result = (expectedTies.getNextStudent() == recovered.getNextStudent());
+        }
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+    return result;
+}
+
+bool Tester::testJournalRingWrap() {
+    const string journalPath = "rqueue-test-ring.journal";
+    const string snapshotPath = "rqueue-test-ring.snapshot";
+    RQueue expected(priorityFn2, MINHEAP, SKEW);
+    {
+        //a long commit interval, so the ring fills up and the queue has to wait for room
+        QueueJournal journal(journalPath, snapshotPath, 1000);
+        journal.registerPriorityFn("priorityFn2", priorityFn2);
+        RQueue myQueue(priorityFn2, MINHEAP, SKEW);
+        journal.attach(myQueue);
+
+        //raw records of uneven sizes wrap around the end of the ring; attributes far outside their ranges
+        //need the longest encodings
+        string padding(97, 'x');
+        for (int i = 0; (long long) i * 150 < 3LL * QueueJournal::RING_BYTES; i++) {
+            myQueue.insertStudent(Student(padding.substr(i % 13) + to_string(i), -1 - i % 3, INT32_MIN + i % 5,
+                                          INT32_MAX - i % 2, i % 3, i % 3, i % 5, i % 3));
+            if (i % 7 == 0) {
+                myQueue.getNextStudent();
+            }
+            if (i % 5000 == 0) {
+                //a name too long for a raw record
+                myQueue.insertStudent(Student(string(QueueJournal::RAW_RECORD_BYTES, 'y') + to_string(i), FRESH,
+                                              BIO, REGU, MIX, MALE, TIER2, LOW));
+            }
+        }
+
+        //a merge record longer than the whole ring is copied through in pieces
+        RQueue otherQueue(priorityFn2, MINHEAP, SKEW);
+        for (int i = 0; (long long) i * 100 < 2LL * QueueJournal::RING_BYTES; i++) {
+            otherQueue.insertStudent(Student(padding + to_string(i), SENI, CSC, HONO, i % 3, i % 3, i % 5, i % 3));
+        }
+        myQueue.mergeWithQueue(otherQueue);
+        for (int i = 0; i < 100; i++) {
+            myQueue.getNextStudent();
+        }
+        journal.flush();
+        expected = myQueue;
+    }
+
+    bool result = true;
+    {
+        RQueue recovered(priorityFn2, MINHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn2", priorityFn2);
+        journal.recover(recovered);
+        result = (recovered.numStudents() == expected.numStudents());
+        while (result && expected.numStudents() > 0) {
+            result = (expected.getNextStudent() == recovered.getNextStudent());
+        }
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+    return result;
+}
+
+bool Tester::testSharedProcesses() {
+    STRUCTURE structures[] = {SKEW, LEFTIST};
+    for (STRUCTURE structure : structures) {
+        const string name = "/rqueue-test-" + to_string(getpid());
+        SharedQueue::remove(name);
+        SharedQueue myQueue(name, 400, priorityFn1, MAXHEAP, structure);
+
+        //two workers insert through their own mapping while this process inserts through its one
+        vector<pid_t> workers;
+        for (int worker = 0; worker < 2; worker++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    SharedQueue workerQueue(name, priorityFn1);
+                    for (int i = 0; i < 150; i++) {
+                        workerQueue.insertStudent(Student("Worker " + to_string(worker) + " " + to_string(i), i % 4,
+                                                          i % 5, i % 4, i % 3, (i / 3) % 3, i % 5, i % 3));
+                    }
+                } catch (exception &e) {
+                    status = 1;
+                }
+                _exit(status);
+            }
+            workers.push_back(pid);
+        }
+        for (int i = 0; i < 100; i++) {
+            myQueue.insertStudent(Student("Owner " + to_string(i), i % 4, i % 5, i % 4, i % 3, 0, 0, 0));
+        }
+        bool result = true;
+        for (pid_t pid : workers) {
+            int status = 0;
+            result = result && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+
+        //a full segment and an existing name are rejected
+        try {
+            myQueue.insertStudent(Student("One too many", 0, 0, 0, 0, 0, 0, 0));
+            result = false;
+        } catch (overflow_error &e) {
+        }
+        try {
+            SharedQueue duplicate(name, 10, priorityFn1, MAXHEAP, structure);
+            result = false;
+        } catch (runtime_error &e) {
+        }
+
+        result = result && myQueue.numStudents() == 400 && checkSharedDrain(myQueue, 400);
+        try {
+            myQueue.getNextStudent();
+            result = false;
+        } catch (out_of_range &e) {
+        }
+        SharedQueue::remove(name);
+        if (!result) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testSharedRepair() {
+    const string name = "/rqueue-test-" + to_string(getpid());
+    SharedQueue::remove(name);
+    SharedQueue myQueue(name, 300, priorityFn2, MINHEAP, LEFTIST);
+    for (int i = 0; i < 200; i++) {
+        myQueue.insertStudent(Student("Student " + to_string(i), i % 4, i % 5, i % 4, i % 3, (i / 3) % 3, i % 5,
+                                      i % 3));
+    }
+
+    //a worker dies holding the lock with the heap half merged
+    pid_t pid = fork();
+    if (pid == 0) {
+        SharedQueue workerQueue(name, priorityFn2);
+        workerQueue.lock();
+        SharedQueue::SharedNode *nodes = workerQueue.nodes();
+        int32_t root = workerQueue.m_segment->m_root;
+        nodes[root].m_left = SharedQueue::NONE;
+        workerQueue.m_segment->m_size = 7;
+        _exit(0);
+    }
+    int status = 0;
+    bool result = waitpid(pid, &status, 0) == pid;
+
+    //the next process to take the lock rebuilds the heap from the queued students
+    result = result && myQueue.numStudents() == 200;
+
+    //a scheduler dies after unlinking the best student but before giving it up, so the student stays queued
+    pid = fork();
+    if (pid == 0) {
+        SharedQueue workerQueue(name, priorityFn2);
+        workerQueue.lock();
+        SharedQueue::SharedNode *nodes = workerQueue.nodes();
+        int32_t root = workerQueue.m_segment->m_root;
+        workerQueue.m_segment->m_size--;
+        workerQueue.m_segment->m_root = workerQueue.merge(nodes[root].m_left, nodes[root].m_right);
+        workerQueue.releaseNode(root);
+        _exit(0);
+    }
+    result = result && waitpid(pid, &status, 0) == pid;
+    result = result && myQueue.numStudents() == 200 && checkSharedDrain(myQueue, 200);
+    SharedQueue::remove(name);
+    return result;
+}
+
+bool Tester::checkSharedDrain(SharedQueue &myQueue, int count) {
+    //every student comes out once, in priority order
+    int (*priorityFn)(const Student &) = (myQueue.getHeapType() == MAXHEAP) ? priorityFn1 : priorityFn2;
+    set<string> names;
+    int lastPriority = 0;
+    for (int i = 0; i < count; i++) {
+        Student student = myQueue.getNextStudent();
+        int priority = priorityFn(student);
+        if (i > 0 && ((myQueue.getHeapType() == MAXHEAP) ? priority > lastPriority : priority < lastPriority)) {
+            return false;
+        }
+        lastPriority = priority;
+        names.insert(student.getName());
+    }
+    return (int) names.size() == count && myQueue.numStudents() == 0;
+}
+
+bool Tester::testIntakeConcurrent() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, WBLEFTIST, DARY};
+    for (STRUCTURE structure : structures) {
+        RQueue myQueue(priorityFn2, MINHEAP, structure);
+        insertNamedStudents(myQueue, "Before ", 50);
+        IntakeQueue intake(myQueue);
+
+        //four producers insert while the consumer keeps serving
+        atomic<int> running(4);
+        vector<thread> producers;
+        for (int producer = 0; producer < 4; producer++) {
+            producers.push_back(thread([&intake, &running, producer]() {
+                for (int i = 0; i < 2000; i++) {
+                    intake.insertStudent(Student("Producer " + to_string(producer) + " " + to_string(i), i % 4,
+                                                 i % 5, i % 4, i % 3, (i / 3) % 3, i % 5, i % 3));
+                }
+                running--;
+            }));
+        }
+        set<string> names;
+        int served = 0;
+        while (running > 0) {
+            if (intake.numStudents() > 0) {
+                names.insert(intake.getNextStudent().getName());
+                served++;
+            }
+        }
+        for (unsigned int i = 0; i < producers.size(); i++) {
+            producers[i].join();
+        }
+
+        //once the producers are done, the rest comes out in priority order
+        bool result = (myQueue.numStudents() == 0);
+        int lastPriority = MIN;
+        while (intake.numStudents() > 0) {
+            Student student = intake.getNextStudent();
+            result = result && priorityFn2(student) >= lastPriority;
+            lastPriority = priorityFn2(student);
+            names.insert(student.getName());
+            served++;
+        }
+        if (!result || served != 8050 || names.size() != 8050) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testIntakeOrder() {
+    //an intake serves like the queue it wraps, batch after batch and with aging;
+    //ties may be broken differently, so the served students are compared by their aged priority
+    RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+    myQueue.setAgingRate(1);
+    RQueue empty(priorityFn1, MAXHEAP, LEFTIST);
+    empty.setAgingRate(1);
+    IntakeQueue intake(empty);
+    vector<int> enqueued;
+    auto agedPriority = [&enqueued](const Student &student) {
+        return priorityFn1(student) - enqueued[stoi(student.getName().substr(8))];
+    };
+    int epoch = 0;
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 37; i++) {
+            int n = round * 37 + i;
+            Student student("Student " + to_string(n), n % 4, n % 5, n % 4, n % 3, 0, 0, 0);
+            enqueued.push_back(epoch);
+            myQueue.insertStudent(student);
+            intake.insertStudent(student);
+        }
+        myQueue.advanceEpoch(2);
+        intake.advanceEpoch(2);
+        epoch += 2;
+        for (int i = 0; i < 11; i++) {
+            if (agedPriority(myQueue.getNextStudent()) != agedPriority(intake.getNextStudent())) {
+                return false;
+            }
+        }
+    }
+    while (myQueue.numStudents() > 0) {
+        if (intake.numStudents() != myQueue.numStudents() ||
+            agedPriority(myQueue.getNextStudent()) != agedPriority(intake.getNextStudent())) {
+            return false;
+        }
+    }
+
+    //inserts that could be rejected cannot be queued through an intake
+    bool result = (intake.numStudents() == 0);
+    RQueue radixQueue(priorityFn2, MINHEAP, RADIX);
+    RQueue indexedQueue(priorityFn2, MINHEAP, SKEW);
+    indexedQueue.setIndexed(true);
+    RQueue *rejected[] = {&radixQueue, &indexedQueue};
+    for (RQueue *queue : rejected) {
+        try {
+            IntakeQueue rejectedIntake(*queue);
+            result = false;
+        } catch (invalid_argument &e) {
+        }
+    }
+    return result;
+}
+
+bool Tester::testLazyMergeOrder() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        RQueue lazyQueue(priorityFn2, MINHEAP, structure);
+        lazyQueue.setLazyMerge(true);
+        RQueue eagerQueue(priorityFn2, MINHEAP, structure);
+
+        //many small merges, some of empty queues, with a few inserts and extractions in between
+        int merges = 0;
+        for (int round = 0; round < 300; round++) {
+            RQueue lazyPart(priorityFn2, MINHEAP, structure);
+            RQueue eagerPart(priorityFn2, MINHEAP, structure);
+            for (int i = 0; i < round % 7; i++) {
+                int n = round * 7 + i;
+                Student student("Student " + to_string(n), n % 4, n % 5, n % 4, n % 3, (n / 3) % 3, n % 5, n % 3);
+                lazyPart.insertStudent(student);
+                eagerPart.insertStudent(student);
+            }
+            merges += (lazyPart.numStudents() > 0 && lazyQueue.numStudents() > 0) ? 1 : 0;
+            lazyQueue.mergeWithQueue(lazyPart);
+            eagerQueue.mergeWithQueue(eagerPart);
+            if (lazyQueue.m_dummies != merges || lazyPart.numStudents() != 0 ||
+                lazyQueue.numStudents() != eagerQueue.numStudents()) {
+                return false;
+            }
+            if (round % 50 == 49) {
+                //an extraction purges every dummy and leaves a proper heap behind
+                if (priorityFn2(lazyQueue.getNextStudent()) != priorityFn2(eagerQueue.getNextStudent()) ||
+                    lazyQueue.m_dummies != 0 || lazyQueue.m_heap->m_student == nullptr ||
+                    (structure == LEFTIST && (!checkNPLValue(lazyQueue.m_heap) ||
+                                              !checkLEFTISTProperty(lazyQueue.m_heap))) ||
+                    (structure == BINOMIAL && !checkBINOMIALProperty(lazyQueue.m_heap, lazyQueue.m_size))) {
+                    return false;
+                }
+                merges = 0;
+            }
+        }
+
+        //a copy keeps the dummies, the original and the copy serve like the eager queue
+        RQueue copy(lazyQueue);
+        if (copy.m_dummies != lazyQueue.m_dummies || copy.numStudents() != eagerQueue.numStudents()) {
+            return false;
+        }
+        while (eagerQueue.numStudents() > 0) {
+            int priority = priorityFn2(eagerQueue.getNextStudent());
+            if (priorityFn2(lazyQueue.getNextStudent()) != priority || priorityFn2(copy.getNextStudent()) != priority) {
+                return false;
+            }
+        }
+        if (lazyQueue.numStudents() != 0 || copy.numStudents() != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testLazyMergeSnapshot() {
+    //a journaled lazy queue is recovered with its dummies, so it serves exactly the same students
+    const string journalPath = "rqueue-test.journal";
+    const string snapshotPath = "rqueue-test.snapshot";
+    RQueue expected(priorityFn1, MAXHEAP, SKEW);
+    {
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+        myQueue.setLazyMerge(true);
+        insertNamedStudents(myQueue, "First ", 20);
+        RQueue part(priorityFn1, MAXHEAP, LEFTIST);
+        insertNamedStudents(part, "Second ", 20);
+        myQueue.mergeWithQueue(part);
+
+        //the snapshot holds one dummy, the journal adds a second one
+        journal.attach(myQueue);
+        insertNamedStudents(part, "Third ", 20);
+        myQueue.mergeWithQueue(part);
+        journal.flush();
+        expected = myQueue;
+    }
+
+    bool result = (expected.m_dummies == 2);
+    {
+        RQueue recovered(priorityFn1, MAXHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        journal.recover(recovered);
+        journal.detach();
+        result = result && recovered.isLazyMerge() && recovered.m_dummies == 2 &&
+                 recovered.numStudents() == expected.numStudents();
+        while (result && expected.numStudents() > 0) {
+            result = (expected.getNextStudent() == recovered.getNextStudent());
+        }
+
+        //switching lazy merges off purges the dummies
+        RQueue part(priorityFn1, MAXHEAP, LEFTIST);
+        insertNamedStudents(part, "Fourth ", 5);
+        recovered.mergeWithQueue(part);
+        insertNamedStudents(part, "Fifth ", 5);
+        recovered.mergeWithQueue(part);
+        result = result && recovered.m_dummies == 1;
+        recovered.setLazyMerge(false);
+        result = result && recovered.m_dummies == 0 && recovered.m_heap->m_student != nullptr;
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+    return result;
+}
+
+bool Tester::testLazyMergeDeepCrown() {
+    //every lazy merge of a one-student section adds a dummy on top of the crown, so the crown is a chain
+    //as deep as the number of merges; nothing that walks the heap may recurse along it
+    const int sections = 150000;
+    const string journalPath = "rqueue-test.journal";
+    const string snapshotPath = "rqueue-test.snapshot";
+    RQueue copy(priorityFn1, MAXHEAP, SKEW);
+    bool result = true;
+    {
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        RQueue myQueue(priorityFn1, MAXHEAP, SKEW);
+        myQueue.setLazyMerge(true);
+        RQueue part(priorityFn1, MAXHEAP, SKEW);
+        for (int i = 0; i < sections; i++) {
+            part.insertStudent(Student("Student " + to_string(i), i % 4, i % 5, i % 4, i % 3, (i / 3) % 3, i % 5,
+                                       i % 3));
+            myQueue.mergeWithQueue(part);
+        }
+        journal.attach(myQueue);
+        journal.checkpoint();
+        copy = RQueue(myQueue);
+        RQueueStats stats = myQueue.stats();
+        result = (myQueue.m_dummies == sections - 1 && copy.m_dummies == sections - 1 &&
+                  stats.m_nodeCount == 2 * sections - 1 && stats.m_maxDepth >= sections - 1);
+        journal.flush();
+    }
+
+    {
+        RQueue recovered(priorityFn1, MAXHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        journal.recover(recovered);
+        journal.detach();
+        result = result && recovered.m_dummies == sections - 1 && recovered.numStudents() == sections;
+        while (result && copy.numStudents() > 0) {
+            result = (copy.getNextStudent() == recovered.getNextStudent());
+        }
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+    return result;
+}
+
+void Tester::storeLevelOrder(Node *root, vector<Node *> &nodes) {
+    //breadth-first traversal, the vector doubles as the queue
+    nodes.clear();
+    if (root != nullptr) {
+        nodes.push_back(root);
+    }
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        if (nodes[i]->m_left != nullptr) {
+            nodes.push_back(nodes[i]->m_left);
+        }
+        if (nodes[i]->m_right != nullptr) {
+            nodes.push_back(nodes[i]->m_right);
+        }
+    }
+}
+
+bool Tester::checkCompactLayout(Node *root, const vector<Node> &expected) {
+    //same nodes with the same children, level by level, and each node right after the previous one in memory
+    vector<Node *> nodes;
+    storeLevelOrder(root, nodes);
+    if (nodes.size() != expected.size()) {
+        return false;
+    }
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        if (nodes[i] != nodes[0] + i || nodes[i]->m_student != expected[i].m_student ||
+            nodes[i]->m_key != expected[i].m_key || nodes[i]->m_npl != expected[i].m_npl ||
+            nodes[i]->m_weight != expected[i].m_weight ||
+            (nodes[i]->m_left == nullptr) != (expected[i].m_left == nullptr) ||
+            (nodes[i]->m_right == nullptr) != (expected[i].m_right == nullptr)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testCompactLayout() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        //extractions and merges scatter the nodes, a lazy merge leaves a dummy in the heap
+        RQueue myQueue(priorityFn2, MINHEAP, structure);
+        myQueue.setLazyMerge(true);
+        insertMultipleStudents(myQueue);
+        for (int i = 0; i < 100; i++) {
+            myQueue.getNextStudent();
+        }
+        RQueue otherQueue(priorityFn2, MINHEAP, structure);
+        insertMultipleStudents(otherQueue);
+        myQueue.mergeWithQueue(otherQueue);
+
+        vector<Node *> nodes;
+        storeLevelOrder(myQueue.m_heap, nodes);
+        vector<Node> expected;
+        for (unsigned int i = 0; i < nodes.size(); i++) {
+            expected.push_back(*nodes[i]);
+        }
+        RQueue copy(myQueue);
+
+        myQueue.compact();
+        if (myQueue.m_dummies != 1 || myQueue.m_size != 500 || !checkCompactLayout(myQueue.m_heap, expected)) {
+            return false;
+        }
+
+        //the compacted heap keeps its exact shape, so it serves the students in the same order as before
+        while (copy.numStudents() > 0) {
+            if (!(copy.getNextStudent() == myQueue.getNextStudent())) {
+                return false;
+            }
+        }
+        myQueue.compact();
+        if (myQueue.numStudents() != 0 || myQueue.m_heap != nullptr) {
+            return false;
+        }
+    }
+
+    //array structures are left alone
+    RQueue arrayQueue(priorityFn2, MINHEAP, DARY);
+    insertMultipleStudents(arrayQueue);
+    arrayQueue.compact();
+    return checkDARYHeapProperty(arrayQueue) && checkRemovalOrder(arrayQueue);
+}
+
+bool Tester::testAutoCompact() {
+    RQueue myQueue(priorityFn2, MINHEAP, LEFTIST);
+    myQueue.setAutoCompact(true);
+    insertMultipleStudents(myQueue);
+    for (int i = 0; i < 50; i++) {
+        myQueue.getNextStudent();
+    }
+
+    //each full rebuild of the heap is followed by a compaction
+    vector<Node *> nodes;
+    myQueue.setStructure(SKEW);
+    storeLevelOrder(myQueue.m_heap, nodes);
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        if (nodes[i] != nodes[0] + i) {
+            return false;
+        }
+    }
+    myQueue.setPriorityFn(priorityFn1, MAXHEAP);
+    storeLevelOrder(myQueue.m_heap, nodes);
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        if (nodes[i] != nodes[0] + i) {
+            return false;
+        }
+    }
+    if (nodes.size() != 250 || !checkHeapProperty(myQueue.m_heap, priorityFn1, MAXHEAP)) {
+        return false;
+    }
+
+    //copies keep the setting, it is off by default
+    RQueue copy(myQueue);
+    RQueue plainQueue(priorityFn2, MINHEAP, LEFTIST);
+    return copy.isAutoCompact() && !plainQueue.isAutoCompact() && checkRemovalOrder(copy);
+}
+
+bool Tester::checkDrainOrder(RQueue &myQueue, int count) {
+    //the queue holds count students and serves them in priority order
+    if (myQueue.numStudents() != count) {
+        return false;
+    }
+    int prevPriority = INT32_MIN;
+    for (int i = 0; i < count; i++) {
+        int priority = myQueue.m_priorFunc(myQueue.getNextStudent());
+        if ((myQueue.m_heapType == MINHEAP) ? priority < prevPriority : (i > 0 && priority > prevPriority)) {
+            return false;
+        }
+        prevPriority = priority;
+    }
+    return myQueue.numStudents() == 0;
+}
+
+bool Tester::testRegistrySections() {
+    QueueRegistry registry(priorityFn2, MINHEAP, LEFTIST);
+    const int sections = 2000;
+    for (int id = 0; id < sections; id++) {
+        insertNamedStudents(registry.section(id * 7), "Section " + to_string(id) + " Student ", 1 + id % 15);
+    }
+
+    //every queue lives in the arena, with no pools or rarely used state of its own, and is found by its section id
+    if (registry.numSections() != sections || registry.find(3) != nullptr || registry.section(0).numStudents() != 1) {
+        return false;
+    }
+    for (int id = 0; id < sections; id++) {
+        RQueue *queue = registry.find(id * 7);
+        if (queue == nullptr || queue != &registry.section(id * 7) || queue->m_arena != &registry.m_arena ||
+            queue->m_nodes != &registry.m_arena.m_nodes || queue->numStudents() != 1 + id % 15 ||
+            queue->m_ownPools != nullptr || queue->m_extras != nullptr) {
+            return false;
+        }
+    }
+
+    //removing sections keeps the others reachable, their students go back to the arena
+    for (int id = 0; id < sections; id += 2) {
+        if (!registry.remove(id * 7)) {
+            return false;
+        }
+    }
+    if (registry.remove(0) || registry.find(0) != nullptr || registry.numSections() != sections / 2) {
+        return false;
+    }
+    for (int id = 1; id < sections; id += 2) {
+        RQueue *queue = registry.find(id * 7);
+        if (queue == nullptr || !checkDrainOrder(*queue, 1 + id % 15)) {
+            return false;
+        }
+    }
+
+    //queues of the arena are compacted within the arena, copies get pools of their own
+    RQueue &queue = registry.section(1);
+    insertMultipleStudents(queue);
+    for (int i = 0; i < 100; i++) {
+        queue.getNextStudent();
+    }
+    queue.compact();
+    vector<Node *> nodes;
+    storeLevelOrder(queue.m_heap, nodes);
+    for (unsigned int i = 0; i < nodes.size(); i++) {
+        if (nodes[i] != nodes[0] + i) {
+            return false;
+        }
+    }
+    RQueue copy(queue);
+    if (copy.m_arena != nullptr || copy.m_ownPools == nullptr || copy.m_nodes != &copy.m_ownPools->m_nodes ||
+        !checkHeapProperty(copy.m_heap, priorityFn2, MINHEAP)) {
+        return false;
+    }
+
+    //at the end of the term every queue goes at once
+    registry.clear();
+    if (registry.numSections() != 0 || registry.find(7) != nullptr || registry.section(7).numStudents() != 0) {
+        return false;
+    }
+    insertNamedStudents(registry.section(7), "Student ", 10);
+    return checkDrainOrder(registry.section(7), 10) && checkDrainOrder(copy, 200);
+}
+
+bool Tester::testRegistryMerge() {
+    QueueRegistry registry(priorityFn2, MINHEAP, SKEW);
+    QueueRegistry otherRegistry(priorityFn2, MINHEAP, SKEW);
+    insertNamedStudents(registry.section(1), "First ", 10);
+    insertNamedStudents(registry.section(2), "Second ", 12);
+    insertNamedStudents(otherRegistry.section(1), "Third ", 14);
+
+    //sections of one registry share the arena, so merging them hands over no memory
+    registry.section(1).mergeWithQueue(registry.section(2));
+    if (registry.section(1).numStudents() != 22 || registry.section(2).numStudents() != 0) {
+        return false;
+    }
+
+    //a queue with pools of its own is taken into the arena, a section of another registry is copied into it
+    RQueue outside(priorityFn2, MINHEAP, SKEW);
+    insertNamedStudents(outside, "Fourth ", 16);
+    registry.section(1).mergeWithQueue(outside);
+    registry.section(1).mergeWithQueue(otherRegistry.section(1));
+    if (outside.numStudents() != 0 || otherRegistry.section(1).numStudents() != 0 ||
+        otherRegistry.section(1).m_arena != &registry.m_arena || registry.section(1).numStudents() != 52) {
+        return false;
+    }
+    otherRegistry.clear();
+
+    //a section merged into a queue outside of the registry leaves the arena with its students
+    registry.section(3);
+    RQueue host(priorityFn2, MINHEAP, SKEW);
+    insertNamedStudents(host, "Fifth ", 8);
+    host.mergeWithQueue(registry.section(1));
+    registry.clear();
+    if (host.m_arena != nullptr || registry.find(1) != nullptr ||
+        !checkHeapProperty(host.m_heap, priorityFn2, MINHEAP)) {
+        return false;
+    }
+
+    //different configurations still cannot be merged
+    QueueRegistry leftistRegistry(priorityFn2, MINHEAP, LEFTIST);
+    insertNamedStudents(leftistRegistry.section(4), "Sixth ", 5);
+    try {
+        host.mergeWithQueue(leftistRegistry.section(4));
+        return false;
+    } catch (domain_error &e) {
+    }
+    return checkDrainOrder(host, 60) && checkDrainOrder(leftistRegistry.section(4), 5);
+}
+
+bool Tester::testFreezeThaw() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        RQueue myQueue(priorityFn2, MINHEAP, structure);
+        myQueue.setIndexed(true);
+        insertNamedStudents(myQueue, "Student ", 300);
+        myQueue.insertStudent(Student("Exchange student", 7, -1, 2, 1, 1, 9, 1));
+        for (int i = 0; i < 300; i += 3) {
+            myQueue.erase("Student " + to_string(i));
+        }
+        myQueue.getNextStudent();
+        RQueue expected(myQueue);
+
+        //the frozen queue keeps no node or student, about a dozen bytes per student instead
+        myQueue.freeze();
+        Student found;
+        if (!myQueue.isFrozen() || myQueue.m_heap != nullptr || !myQueue.m_entries.empty() ||
+            !myQueue.m_extras->m_buckets.empty() || myQueue.numStudents() != 200 ||
+            myQueue.m_extras->m_frozenData.size() > 16 * 200 || !myQueue.contains("Student 299") ||
+            myQueue.contains("Student 3") || !myQueue.find("Exchange student", found) || found.getLevel() != 7 ||
+            found.getIncome() != 9 || found.getMajor() != -1) {
+            return false;
+        }
+
+        //read-only calls and copies leave it frozen
+        RQueue copy(myQueue);
+        if (priorityFn2(myQueue.peekNextStudent()) != priorityFn2(expected.peekNextStudent()) ||
+            !myQueue.isFrozen() || !copy.isFrozen() || copy.numStudents() != 200) {
+            return false;
+        }
+
+        //the first change thaws it, the index and a radix heap's last key come back as well
+        Student late("Late student", 1, 1, 1, 1, 1, 1, 1);
+        myQueue.insertStudent(late);
+        expected.insertStudent(late);
+        copy.insertStudent(late);
+        if (myQueue.isFrozen() || !myQueue.m_extras->m_frozenData.empty() || !myQueue.contains("Student 299") ||
+            myQueue.m_lastKey != expected.m_lastKey) {
+            return false;
+        }
+        while (expected.numStudents() > 0) {
+            int priority = priorityFn2(expected.getNextStudent());
+            if (priorityFn2(myQueue.getNextStudent()) != priority || priorityFn2(copy.getNextStudent()) != priority) {
+                return false;
+            }
+        }
+        if (myQueue.numStudents() != 0 || copy.numStudents() != 0) {
+            return false;
+        }
+    }
+
+    //an empty queue freezes as well
+    RQueue emptyQueue(priorityFn1, MAXHEAP, SKEW);
+    emptyQueue.freeze();
+    if (!emptyQueue.isFrozen() || emptyQueue.numStudents() != 0) {
+        return false;
+    }
+    try {
+        emptyQueue.peekNextStudent();
+    } catch (out_of_range &e) {
+        return true;
+    }
+    return false;
+}
+
+bool Tester::testFreezeSnapshot() {
+    //a frozen queue is snapshotted as its buffer, and a journaled freeze is replayed
+    const string journalPath = "rqueue-test.journal";
+    const string snapshotPath = "rqueue-test.snapshot";
+    RQueue expected(priorityFn1, MAXHEAP, SKEW);
+    {
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+        insertNamedStudents(myQueue, "First ", 50);
+        myQueue.freeze();
+        journal.attach(myQueue);
+        insertNamedStudents(myQueue, "Second ", 50);
+        myQueue.freeze();
+        journal.flush();
+        expected = myQueue;
+    }
+
+    bool result = expected.isFrozen();
+    {
+        RQueue recovered(priorityFn1, MAXHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        journal.recover(recovered);
+        journal.detach();
+        result = result && recovered.isFrozen() && recovered.getStructure() == LEFTIST &&
+                 recovered.m_extras->m_frozenData == expected.m_extras->m_frozenData && recovered.numStudents() == 100;
+        while (result && expected.numStudents() > 0) {
+            result = (expected.getNextStudent() == recovered.getNextStudent());
+        }
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+    return result;
+}
+
+bool Tester::checkCounts(const RQueue &myQueue) {
+    //the counts agree with the students a copy of the queue serves
+    RQueue copy(myQueue);
+    vector<int> atPriority(MAX - MIN + 1, 0);
+    int below = 0, above = 0;
+    vector<vector<int> > values(NUM_ATTRIBUTES);
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        values[i].assign(ATTRIBUTE_MAX[i] + 1, 0);
+    }
+    while (copy.numStudents() > 0) {
+        Student student = copy.getNextStudent();
+        int priority = myQueue.m_priorFunc(student);
+        if (priority < MIN) {
+            below++;
+        } else if (priority > MAX) {
+            above++;
+        } else {
+            atPriority[priority - MIN]++;
+        }
+        for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+            int value = student.getAttribute((ATTRIBUTE) i);
+            if (value >= 0 && value <= ATTRIBUTE_MAX[i]) {
+                values[i][value]++;
+            }
+        }
+    }
+
+    for (int priority = MIN; priority <= MAX; priority++) {
+        int better = (myQueue.m_heapType == MINHEAP) ? below : above;
+        for (int other = MIN; other <= MAX; other++) {
+            if ((myQueue.m_heapType == MINHEAP) ? other < priority : other > priority) {
+                better += atPriority[other - MIN];
+            }
+        }
+        if (myQueue.countAt(priority) != atPriority[priority - MIN] || myQueue.countBetterThan(priority) != better) {
+            return false;
+        }
+    }
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        if (myQueue.histogram((ATTRIBUTE) i) != values[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testFreezeTakeOver() {
+    //a quota queue thaws the queue it takes over, withdrawn students stay out
+    RQueue myQueue(priorityFn2, MINHEAP, LEFTIST);
+    myQueue.setIndexed(true);
+    insertNamedStudents(myQueue, "Student ", 10);
+    myQueue.erase("Student 3");
+    myQueue.freeze();
+    QuotaQueue quotaQueue(myQueue, ATTR_MAJOR);
+    if (myQueue.numStudents() != 0 || myQueue.isFrozen() || quotaQueue.numStudents() != 9) {
+        return false;
+    }
+    int prevPriority = MIN;
+    for (int i = 0; i < 9; i++) {
+        Student student = quotaQueue.getNextStudent();
+        if (priorityFn2(student) < prevPriority || student.m_name == "Student 3") {
+            return false;
+        }
+        prevPriority = priorityFn2(student);
+    }
+
+    //an external queue does the same, whether the frozen queue fits its heap or becomes its first run
+    int sizes[] = {3, 10};
+    for (int size : sizes) {
+        RQueue frozen(priorityFn2, MINHEAP, LEFTIST);
+        insertNamedStudents(frozen, "Student ", size);
+        RQueue expected(frozen);
+        frozen.freeze();
+        ExternalQueue external(frozen, 8, ".", 2);
+        if (frozen.numStudents() != 0 || frozen.isFrozen() || external.numStudents() != size ||
+            external.numRuns() != (size == 10 ? 1 : 0)) {
+            return false;
+        }
+        while (expected.numStudents() > 0) {
+            if (priorityFn2(external.getNextStudent()) != priorityFn2(expected.getNextStudent())) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Tester::testCountsIncremental() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        RQueue myQueue(priorityFn2, MINHEAP, structure);
+        myQueue.setIndexed(true);
+        insertNamedStudents(myQueue, "Student ", 300);
+        //priority 12 and an income out of range land in the end slots
+        myQueue.insertStudent(Student("Exchange student", 7, -1, 2, 1, 1, 9, 1));
+        //nothing is counted until the first query, which counts the queue once
+        if (myQueue.counted() || !checkCounts(myQueue) || !myQueue.counted() ||
+            myQueue.countBetterThan(MAX) + myQueue.countAt(MAX) != 300) {
+            return false;
+        }
+
+        //merges add the counts of rhs and leave rhs with none, a re-keyed rhs is counted under the host's function
+        RQueue other(priorityFn2, MINHEAP, structure);
+        insertNamedStudents(other, "Other ", 100);
+        RQueue rekeyed(priorityFn1, MAXHEAP, SKEW);
+        insertNamedStudents(rekeyed, "Rekeyed ", 50);
+        myQueue.mergeWithQueue(other);
+        myQueue.mergeWithQueue(rekeyed, MERGE_REKEY);
+        if (!checkCounts(myQueue) || !checkCounts(other) || !checkCounts(rekeyed) || other.countBetterThan(MAX) != 0 ||
+            myQueue.countBetterThan(MAX) + myQueue.countAt(MAX) != 450) {
+            return false;
+        }
+
+        //withdrawn students stop counting right away, extracted ones as they leave
+        for (int i = 0; i < 300; i += 6) {
+            myQueue.erase("Student " + to_string(i));
+        }
+        if (!checkCounts(myQueue)) {
+            return false;
+        }
+        for (int i = 0; i < 40; i++) {
+            myQueue.getNextStudent();
+        }
+        if (!checkCounts(myQueue)) {
+            return false;
+        }
+
+        //a frozen queue keeps its counts, a new priority function counts every student again
+        myQueue.freeze();
+        if (!checkCounts(myQueue)) {
+            return false;
+        }
+        myQueue.setPriorityFn(priorityFn1, MAXHEAP);
+        if (!checkCounts(myQueue)) {
+            return false;
+        }
+        while (myQueue.numStudents() > 0) {
+            myQueue.getNextStudent();
+        }
+        if (!checkCounts(myQueue) || myQueue.countBetterThan(MIN) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testCountsErrors() {
+    //priorities are only counted for an int priority function, and only in [MIN, MAX]
+    RQueue myQueue(priorityFn1, MAXHEAP, LEFTIST);
+    insertNamedStudents(myQueue, "Student ", 20);
+    try {
+        myQueue.countAt(MAX + 1);
+        return false;
+    } catch (out_of_range &e) {
+    }
+    try {
+        myQueue.countBetterThan(MIN - 1);
+        return false;
+    } catch (out_of_range &e) {
+    }
+    try {
+        myQueue.histogram((ATTRIBUTE) NUM_ATTRIBUTES);
+        return false;
+    } catch (out_of_range &e) {
+    }
+
+    //histograms do not depend on the priority function
+    myQueue.setPriorityFn(priorityFnTimestamp, MINHEAP);
+    try {
+        myQueue.countAt(MIN);
+        return false;
+    } catch (domain_error &e) {
+    }
+    vector<int> majors = myQueue.histogram(ATTR_MAJOR);
+    if (majors.size() != CSC + 1 || majors[BIO] != 4 || majors[CSC] != 4) {
+        return false;
+    }
+
+    //the counts are cleared with the queue and copied with it
+    myQueue.setPriorityFn(priorityFn1, MAXHEAP);
+    RQueue copy(myQueue);
+    myQueue.clear();
+    return checkCounts(myQueue) && myQueue.histogram(ATTR_MAJOR)[CSC] == 0 && copy.histogram(ATTR_MAJOR)[CSC] == 4 &&
+           checkCounts(copy);
+}
+
+bool Tester::testTransactionRollback() {
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    for (STRUCTURE structure : structures) {
+        RQueue myQueue(priorityFn2, MINHEAP, structure);
+        myQueue.setIndexed(true);
+        insertNamedStudents(myQueue, "Student ", 300);
+        for (int i = 0; i < 300; i += 7) {
+            myQueue.erase("Student " + to_string(i));
+        }
+        myQueue.getNextStudent();
+        RQueue expected(myQueue);
+        vector<Node *> nodes;
+        vector<Student *> students;
+        storeDataInVector(nodes, myQueue.m_heap);
+        myQueue.collectStudents(students);
+
+        //tentative pops serve students in order, and they are no longer queued
+        myQueue.begin();
+        vector<Student> popped;
+        for (int i = 0; i < 40; i++) {
+            popped.push_back(myQueue.popTentative());
+            if (priorityFn2(popped.back()) != priorityFn2(expected.getNextStudent())) {
+                return false;
+            }
+        }
+        if (!myQueue.inTransaction() || myQueue.numStudents() != expected.numStudents() ||
+            myQueue.contains(popped[0].getName()) || !checkCounts(myQueue)) {
+            return false;
+        }
+
+        //a rollback brings back the same nodes and students, the best one popped is on top again
+        myQueue.rollback();
+        vector<Node *> nodesAfter;
+        vector<Student *> studentsAfter;
+        storeDataInVector(nodesAfter, myQueue.m_heap);
+        myQueue.collectStudents(studentsAfter);
+        sort(nodes.begin(), nodes.end());
+        sort(nodesAfter.begin(), nodesAfter.end());
+        sort(students.begin(), students.end());
+        sort(studentsAfter.begin(), studentsAfter.end());
+        //withdrawn students met on the way were dropped for good
+        if (myQueue.inTransaction() || !includes(nodes.begin(), nodes.end(), nodesAfter.begin(), nodesAfter.end()) ||
+            !includes(students.begin(), students.end(), studentsAfter.begin(), studentsAfter.end()) ||
+            myQueue.numStudents() != expected.numStudents() + 40 || !myQueue.contains(popped[0].getName()) ||
+            !checkCounts(myQueue) || priorityFn2(myQueue.peekNextStudent()) != priorityFn2(popped[0])) {
+            return false;
+        }
+        if ((structure == LEFTIST && !checkLEFTISTProperty(myQueue.m_heap)) ||
+            (structure == WBLEFTIST && !checkWBLEFTISTProperty(myQueue.m_heap)) ||
+            (structure == BINOMIAL && !checkBINOMIALProperty(myQueue.m_heap, myQueue.m_size)) ||
+            (structure == DARY && !checkDARYHeapProperty(myQueue))) {
+            return false;
+        }
+
+        //a commit drops the popped students for good; skew and leftist heaps pop them in the same order again
+        bool samePath = (structure == SKEW || structure == LEFTIST || structure == WBLEFTIST);
+        myQueue.begin();
+        for (int i = 0; i < 40; i++) {
+            if (!(myQueue.popTentative() == popped[i]) && samePath) {
+                return false;
+            }
+        }
+        myQueue.commit();
+        if (!checkCounts(myQueue) || myQueue.contains(popped[0].getName())) {
+            return false;
+        }
+        while (expected.numStudents() > 0) {
+            if (priorityFn2(myQueue.getNextStudent()) != priorityFn2(expected.getNextStudent())) {
+                return false;
+            }
+        }
+        if (myQueue.numStudents() != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testTransactionJournal() {
+    //only reads and pops are allowed inside a transaction
+    RQueue myQueue(priorityFn1, MAXHEAP, SKEW);
+    insertNamedStudents(myQueue, "Student ", 30);
+    RQueue other(priorityFn1, MAXHEAP, SKEW);
+    try {
+        myQueue.popTentative();
+        return false;
+    } catch (domain_error &e) {
+    }
+    myQueue.begin();
+    int failures = 0;
+    try {
+        myQueue.begin();
+    } catch (domain_error &e) {
+        failures++;
+    }
+    try {
+        myQueue.insertStudent(Student("Late student", 1, 1, 1, 1, 1, 1, 1));
+    } catch (domain_error &e) {
+        failures++;
+    }
+    try {
+        other.mergeWithQueue(myQueue);
+    } catch (domain_error &e) {
+        failures++;
+    }
+    try {
+        myQueue.freeze();
+    } catch (domain_error &e) {
+        failures++;
+    }
+    myQueue.popTentative();
+    myQueue.clear();
+    if (failures != 4 || myQueue.inTransaction() || myQueue.numStudents() != 0) {
+        return false;
+    }
+
+    //transactions are journaled as they happen, so recovery rebuilds the exact heap a rollback left behind,
+    //and a transaction that was still open at the crash is rolled back
+    const string journalPath = "rqueue-test.journal";
+    const string snapshotPath = "rqueue-test.snapshot";
+    RQueue expected(priorityFn1, MAXHEAP, SKEW);
+    {
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        RQueue journaled(priorityFn1, MAXHEAP, LEFTIST);
+        insertNamedStudents(journaled, "Student ", 100);
+        journal.attach(journaled);
+        journaled.begin();
+        for (int i = 0; i < 20; i++) {
+            journaled.popTentative();
+        }
+        journaled.rollback();
+        journaled.begin();
+        journaled.popTentative();
+        journaled.commit();
+        expected = journaled;
+        try {
+            journaled.begin();
+            journal.checkpoint();
+            return false;
+        } catch (domain_error &e) {
+        }
+        journaled.popTentative();
+        journal.flush();
+    }
+
+    bool result = true;
+    {
+        RQueue recovered(priorityFn1, MAXHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        journal.recover(recovered);
+        journal.detach();
+        result = !recovered.inTransaction() && recovered.numStudents() == 99;
+        while (result && expected.numStudents() > 0) {
+            result = (expected.getNextStudent() == recovered.getNextStudent());
+        }
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+    return result;
+}
+
+bool Tester::testTransactionTakeOver() {
+    //taking over a queue with an open transaction throws before anything changes, the rollback still works
+    RQueue myQueue(priorityFn2, MINHEAP, LEFTIST);
+    insertNamedStudents(myQueue, "Student ", 10);
+    RQueue expected(myQueue);
+    myQueue.begin();
+    myQueue.popTentative();
+    myQueue.popTentative();
+    try {
+        QuotaQueue quotaQueue(myQueue, ATTR_MAJOR);
+        return false;
+    } catch (domain_error &e) {
+    }
+    try {
+        ExternalQueue external(myQueue, 8, ".", 2);
+        return false;
+    } catch (domain_error &e) {
+    }
+    if (!myQueue.inTransaction() || myQueue.numStudents() != 8) {
+        return false;
+    }
+    myQueue.rollback();
+    if (myQueue.numStudents() != 10) {
+        return false;
+    }
+    while (expected.numStudents() > 0) {
+        if (!(myQueue.getNextStudent() == expected.getNextStudent())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testPopFromEachOrder() {
+    //queues of every structure and size, some indexed with a withdrawn student, frozen or lazily merged,
+    //each popped in a batch next to a twin popped on its own
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+    int sizes[] = {0, 1, 2, 3, 37, 200};
+    vector<RQueue *> queues;
+    vector<RQueue *> twins;
+    for (STRUCTURE structure : structures) {
+        for (int size : sizes) {
+            for (int copy = 0; copy < 2; copy++) {
+                RQueue *myQueue = new RQueue(priorityFn2, MINHEAP, structure);
+                (copy == 0 ? queues : twins).push_back(myQueue);
+                myQueue->setIndexed(size == 37);
+                insertNamedStudents(*myQueue, "Student ", size);
+                if (size == 37) {
+                    myQueue->erase("Student 4");
+                } else if (size == 3) {
+                    myQueue->freeze();
+                }
+            }
+        }
+    }
+    for (int copy = 0; copy < 2; copy++) {
+        RQueue *myQueue = new RQueue(priorityFn1, MAXHEAP, LEFTIST);
+        (copy == 0 ? queues : twins).push_back(myQueue);
+        myQueue->setLazyMerge(true);
+        insertNamedStudents(*myQueue, "Student ", 50);
+        RQueue other(priorityFn1, MAXHEAP, LEFTIST);
+        insertNamedStudents(other, "Other ", 50);
+        myQueue->mergeWithQueue(other);
+    }
+
+    bool result = true;
+    vector<Student> students;
+    for (int round = 0; result; round++) {
+        int popped = RQueue::popFromEach(queues, students);
+        int expected = 0;
+        for (unsigned int i = 0; i < queues.size() && result; i++) {
+            Student student;
+            if (twins[i]->numStudents() > 0) {
+                student = twins[i]->getNextStudent();
+                expected++;
+            }
+            result = (students[i] == student && queues[i]->numStudents() == twins[i]->numStudents());
+            if (result && round % 50 == 0) {
+                result = checkCounts(*queues[i]);
+            }
+
+            //skew and leftist heaps are left in the exact shape the recursive merges build
+            STRUCTURE structure = queues[i]->getStructure();
+            if (result && (structure == SKEW || structure == LEFTIST) && !queues[i]->isFrozen()) {
+                vector<Node *> nodes;
+                vector<Node *> twinNodes;
+                storeLevelOrder(queues[i]->m_heap, nodes);
+                storeLevelOrder(twins[i]->m_heap, twinNodes);
+                result = (nodes.size() == twinNodes.size());
+                for (unsigned int j = 0; j < nodes.size() && result; j++) {
+                    result = (*nodes[j]->m_student == *twinNodes[j]->m_student &&
+                              (nodes[j]->m_left == nullptr) == (twinNodes[j]->m_left == nullptr) &&
+                              nodes[j]->m_npl == twinNodes[j]->m_npl);
+                }
+                if (result && structure == LEFTIST) {
+                    result = checkLEFTISTProperty(queues[i]->m_heap);
+                }
+            }
+        }
+        result = result && (popped == expected);
+        if (popped == 0) {
+            break;
+        }
+    }
+    for (unsigned int i = 0; i < queues.size(); i++) {
+        delete queues[i];
+        delete twins[i];
+    }
+    return result;
+}
+
+bool Tester::testPopFromEachGuards() {
+    //an open transaction is rejected before any queue is popped
+    RQueue first(priorityFn1, MAXHEAP, SKEW);
+    RQueue second(priorityFn1, MAXHEAP, LEFTIST);
+    insertNamedStudents(first, "Student ", 20);
+    insertNamedStudents(second, "Student ", 20);
+    vector<RQueue *> queues = {&first, &second};
+    vector<Student> students;
+    second.begin();
+    try {
+        RQueue::popFromEach(queues, students);
+        return false;
+    } catch (domain_error &e) {
+    }
+    second.rollback();
+    if (first.numStudents() != 20 || second.numStudents() != 20 ||
+        RQueue::popFromEach(vector<RQueue *>(), students) != 0 || !students.empty()) {
+        return false;
+    }
+
+    //the pops are journaled like getNextStudent
+    const string journalPath = "rqueue-test.journal";
+    const string snapshotPath = "rqueue-test.snapshot";
+    RQueue expected(priorityFn1, MAXHEAP, SKEW);
+    {
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        RQueue journaled(priorityFn1, MAXHEAP, LEFTIST);
+        insertNamedStudents(journaled, "Student ", 100);
+        journal.attach(journaled);
+        queues = {&journaled, &first};
+        for (int i = 0; i < 5; i++) {
+            RQueue::popFromEach(queues, students);
+        }
+        expected = journaled;
+        journal.flush();
+    }
+
+    bool result = true;
+    {
+        RQueue recovered(priorityFn1, MAXHEAP, SKEW);
+        QueueJournal journal(journalPath, snapshotPath);
+        journal.registerPriorityFn("priorityFn1", priorityFn1);
+        journal.recover(recovered);
+        journal.detach();
+        result = (recovered.numStudents() == 95 && first.numStudents() == 15);
+        while (result && expected.numStudents() > 0) {
+            result = (expected.getNextStudent() == recovered.getNextStudent());
+        }
+    }
+    remove(journalPath.c_str());
+    remove(snapshotPath.c_str());
+    return result;
+}
+
+bool Tester::testReleaseWaves() {
+    //registration waves by level, seniors first, plus students due before the start, far beyond the wheel
+    //and at the very end of time; after every step the eligible students must be exactly the due ones
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, WBLEFTIST, BINOMIAL};
+    const int64_t far = (int64_t) 1 << 30;
+    int64_t steps[] = {-60, -50, 0, 3, 6, 500, 1000, 2003, 3006, 3007, 100000, far + 5, far + 1000, INT64_MAX};
+    for (STRUCTURE structure : structures) {
+        RQueue seed(priorityFn1, MAXHEAP, structure);
+        insertNamedStudents(seed, "Seed ", 10);
+        ReleaseQueue myQueue(seed, -100);
+        RQueue expected(priorityFn1, MAXHEAP, structure);
+        insertNamedStudents(expected, "Seed ", 10);
+        if (seed.numStudents() != 0 || myQueue.numStudents() != 10) {
+            return false;
+        }
+
+        vector<Student> students;
+        vector<int64_t> times;
+        for (int i = 0; i < 400; i++) {
+            students.push_back(Student("Student " + to_string(i), i % 4, i % 5, i % 4, i % 3, (i / 3) % 3, i % 5,
+                                       i % 3));
+            if (i % 10 == 0) {
+                times.push_back(-50 - i % 3);
+            } else if (i % 10 == 1) {
+                times.push_back(far + i);
+            } else if (i == 2) {
+                times.push_back(INT64_MAX);
+            } else {
+                times.push_back((SENI - students.back().getLevel()) * 1000 + i % 7);
+            }
+            myQueue.insertStudent(students.back(), times.back());
+        }
+
+        int64_t previous = myQueue.getTime();
+        for (int64_t step : steps) {
+            int due = 0;
+            int waiting = 0;
+            int64_t earliest = INT64_MAX;
+            for (unsigned int i = 0; i < students.size(); i++) {
+                if (times[i] > previous && times[i] <= step) {
+                    expected.insertStudent(students[i]);
+                    due++;
+                } else if (times[i] > step) {
+                    waiting++;
+                    earliest = min(earliest, times[i]);
+                }
+            }
+            if (myQueue.advanceTime(step) != due || myQueue.getTime() != step || myQueue.numWaiting() != waiting ||
+                myQueue.numStudents() != expected.numStudents() || (waiting > 0 && myQueue.nextRelease() != earliest)) {
+                return false;
+            }
+            previous = step;
+
+            //serve every eligible student, in priority order
+            while (expected.numStudents() > 0) {
+                if (priorityFn1(myQueue.getNextStudent()) != priorityFn1(expected.getNextStudent())) {
+                    return false;
+                }
+            }
+            if (myQueue.numStudents() != 0) {
+                return false;
+            }
+        }
+        if (myQueue.numWaiting() != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Tester::testReleaseErrors() {
+    //radix and indexed queues are rejected, and the rejected queue keeps its students
+    RQueue radix(priorityFn2, MINHEAP, RADIX);
+    RQueue indexed(priorityFn2, MINHEAP, SKEW);
+    indexed.setIndexed(true);
+    insertNamedStudents(indexed, "Student ", 5);
+    int failures = 0;
+    try {
+        ReleaseQueue myQueue(radix);
+    } catch (invalid_argument &e) {
+        failures++;
+    }
+    try {
+        ReleaseQueue myQueue(indexed);
+    } catch (invalid_argument &e) {
+        failures++;
+    }
+    if (failures != 2 || indexed.numStudents() != 5) {
+        return false;
+    }
+
+    //waiting students stay invisible, students due already are visible at once, and time only moves forward
+    RQueue empty(priorityFn2, MINHEAP, LEFTIST);
+    ReleaseQueue myQueue(empty, 10);
+    try {
+        myQueue.nextRelease();
+        return false;
+    } catch (out_of_range &e) {
+    }
+    myQueue.insertStudent(Student("Late student", 0, 0, 0, 0, 0, 0, 0), 20);
+    try {
+        myQueue.getNextStudent();
+        return false;
+    } catch (out_of_range &e) {
+    }
+    myQueue.insertStudent(Student("Early student", 3, 4, 3, 2, 2, 4, 2), 5);
+    if (myQueue.numStudents() != 1 || myQueue.numWaiting() != 1 || myQueue.nextRelease() != 20) {
+        return false;
+    }
+    try {
+        myQueue.advanceTime(9);
+        return false;
+    } catch (invalid_argument &e) {
+    }
+    if (myQueue.advanceTime(19) != 0 || myQueue.advanceTime(20) != 1 || myQueue.numStudents() != 2 ||
+        myQueue.getNextStudent().getName() != "Late student" || myQueue.getNextStudent().getName() != "Early student") {
+        return false;
+    }
+    return true;
+}
+
+bool Tester::checkPolicyResult(const vector<Student> &corpus, RQueue &policy, const PolicyResult &result,
+                               int seats) {
+    //the admitted students are the best ones by the key of the policy, equal keys in corpus order
+    if ((int) result.m_order.size() != seats) {
+        return false;
+    }
+    vector<pair<int64_t, int> > expected;
+    for (unsigned int i = 0; i < corpus.size(); i++) {
+        expected.push_back(make_pair(policy.rankKey(corpus[i]), (int) i));
+    }
+    sort(expected.begin(), expected.end());
+    RQueue admitted(policy);
+    for (int i = 0; i < seats; i++) {
+        if (result.m_order[i] != expected[i].second) {
+            return false;
+        }
+        admitted.insertStudent(corpus[result.m_order[i]]);
+    }
+
+    //the summary counts are those of a queue holding the admitted students
+    for (int i = 0; i < QueueCounts::PRIORITIES; i++) {
+        if (result.m_counts.m_priorities[i] != admitted.counts().m_priorities[i]) {
+            return false;
+        }
+    }
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        for (int value = 0; value < QueueCounts::VALUES; value++) {
+            if (result.m_counts.m_attributes[i][value] != admitted.counts().m_attributes[i][value]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Tester::testPolicySimulatorOrder() {
+    //every kind of policy over one corpus, all seats and a few seats, on one thread and on several
+    vector<Student> corpus;
+    for (int i = 0; i < 500; i++) {
+        corpus.push_back(Student("Student " + to_string(i), i % 4, i % 5, i % 4, i % 3, (i / 3) % 3, i % 5, i % 3));
+    }
+    PolicySimulator simulator(corpus);
+    vector<RQueue *> policies;
+    policies.push_back(new RQueue(priorityFn1, MAXHEAP, SKEW));
+    policies.push_back(new RQueue(priorityFn2, MINHEAP, SKEW));
+    policies.push_back(new RQueue(priorityFnTimestamp, MAXHEAP, SKEW));
+    policies.push_back(new RQueue(priorityFnScore, MINHEAP, SKEW));
+    policies.push_back(new RQueue(PrioritySpec("level + major + group desc, income asc"), SKEW));
+    simulator.addPolicy("priorityFn1", priorityFn1, MAXHEAP);
+    simulator.addPolicy("priorityFn2", priorityFn2, MINHEAP);
+    simulator.addPolicy("priorityFnTimestamp", priorityFnTimestamp, MAXHEAP);
+    simulator.addPolicy("priorityFnScore", priorityFnScore, MINHEAP);
+    int last = simulator.addPolicy("spec", PrioritySpec("level + major + group desc, income asc"));
+
+    bool result = (last == 4 && simulator.numPolicies() == 5 && simulator.numStudents() == 500);
+    vector<PolicyResult> all = simulator.run(-1, 3);
+    vector<PolicyResult> few = simulator.run(50, 1);
+    vector<PolicyResult> none = simulator.run(0);
+    result = result && all.size() == policies.size() && few.size() == policies.size() &&
+             none.size() == policies.size() && all[4].m_name == "spec";
+    for (unsigned int i = 0; i < policies.size() && result; i++) {
+        result = (all[i].m_name == few[i].m_name && checkPolicyResult(corpus, *policies[i], all[i], 500) &&
+                  checkPolicyResult(corpus, *policies[i], few[i], 50) &&
+                  checkPolicyResult(corpus, *policies[i], none[i], 0));
+    }
+    for (RQueue *policy : policies) {
+        delete policy;
+    }
+    return result;
+}
+
+bool Tester::testPolicySimulatorErrors() {
+    //a policy that throws fails the whole run with its exception, once every thread is done
+    vector<Student> corpus;
+    for (int i = 0; i < 100; i++) {
+        corpus.push_back(Student("Student " + to_string(i), i % 4, i % 5, i % 4, i % 3, (i / 3) % 3, i % 5, i % 3));
+    }
+    corpus.push_back(Student("Unranked student", 0, 0, 0, 0, 0, 0, 0));
+    PolicySimulator simulator(corpus);
+    if (!simulator.run().empty()) {
+        return false;
+    }
+    simulator.addPolicy("priorityFn1", priorityFn1, MAXHEAP);
+    simulator.addPolicy("priorityFnStrict", priorityFnStrict, MAXHEAP);
+    simulator.addPolicy("priorityFn2", priorityFn2, MINHEAP);
+    try {
+        simulator.run(-1, 2);
+        return false;
+    } catch (invalid_argument &e) {
+    }
+
+    //the corpus is a copy, later changes to the caller's students don't reach it
+    corpus.clear();
+    return simulator.numStudents() == 101;
+}
+
+int main() {
+    Tester tester;
+
+    cout << "\nTesting insertStudent (MINHEAP) - check whether heap property is satisfied after insertion:" << endl;
+    if (tester.testHeapPropertyAfterInsertMINHEAP()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing insertStudent (MAXHEAP) - check whether heap property is satisfied after insertion:" << endl;
+    if (tester.testHeapPropertyAfterInsertMAXHEAP()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting getNextStudent (MINHEAP) - check whether all removals happen in the correct order:" << endl;
+    if (tester.testRemovalOrderMINHEAP()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing getNextStudent (MAXHEAP) - check whether all removals happen in the correct order:" << endl;
+    if (tester.testRemovalOrderMAXHEAP()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting LEFTIST heap - check whether all nodes in a leftist heap have the correct NPL value:" << endl;
+    if (tester.testNPLValue()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing LEFTIST heap - check whether leftist heap preserves the property of such a heap:" << endl;
+    if (tester.testLEFTISTProperty()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting setPriorityFn - check whether after changing the priority function a correct heap is rebuilt "
+            "with the same data and the different priority function:" << endl;
+    if (tester.testSetPriorityFn()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing setStructure - check whether after changing the structure a correct heap is rebuilt with the same "
+            "data and the different structure:" << endl;
+    if (tester.testSetStructure()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting mergeWithQueue (edge) - successfully merges an empty queue with a normal queue:" << endl;
+    if (tester.testMergeWithQueueEdge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting copy constructor (normal) - successfully creates deep copy of normal queue:" << endl;
+    if (tester.testCopyConstructorNormal()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing copy constructor (edge) - successfully creates deep copy of empty queue:" << endl;
+    if (tester.testCopyConstructorEdge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting assignment operator (normal) - successfully creates deep copy of normal queue:" << endl;
+    if (tester.testAssignmentNormal()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing assignment operator (edge) - successfully creates deep copy of empty queue:" << endl;
+    if (tester.testAssignmentEdge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting getNextStudent (error) - attempting to dequeue an empty queue throws an out_of_range exception:"
+         << endl;
+    if (tester.testRemovalError()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting mergeWithQueue (error) - attempting to merge queues with different priority functions throws a "
+            "domain_error exception:" << endl;
+    if (tester.testMergeWithQueueError()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting stats - heap shape is measured correctly and dumped as JSON:" << endl;
+    if (tester.testStats()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting DARY heap - check whether the d-ary heap property holds and removals happen in order:" << endl;
+    if (tester.testDARYHeapProperty()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing DARY heap - check whether converting to and from the d-ary heap rebuilds a correct heap:"
+         << endl;
+    if (tester.testDARYSetStructure()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing DARY heap - check whether merging two d-ary heaps produces a correct heap:" << endl;
+    if (tester.testDARYMerge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting RADIX heap - check whether all removals happen in the correct order:" << endl;
+    if (tester.testRADIXRemovalOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing RADIX heap - check whether wide monotone priorities work and non-monotone inserts throw a "
+            "domain_error exception:" << endl;
+    if (tester.testRADIXMonotone()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting 64-bit priority functions - check whether removals happen in the correct order for every "
+            "structure:" << endl;
+    if (tester.testPriorityFn64()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing real priority functions - check whether removals follow the total order and merging with an "
+            "int queue throws a domain_error exception:" << endl;
+    if (tester.testPriorityFnReal()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing cached keys - check whether every node caches the key of its student:" << endl;
+    if (tester.testCachedKeys()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting priority spec - check whether a compiled spec serves students in lexicographic order:" << endl;
+    if (tester.testPrioritySpecOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing priority spec (error) - malformed specs throw invalid_argument and different specs cannot be "
+            "merged:" << endl;
+    if (tester.testPrioritySpecErrors()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting pooled storage - check whether nodes and students survive merges and are recycled:" << endl;
+    if (tester.testPooledStorage()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting WBLEFTIST heap - check whether subtree weights are correct and the heavier subtree is on the left:"
+         << endl;
+    if (tester.testWBLEFTISTProperty()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing WBLEFTIST heap - check whether merging and converting to a weight-biased heap keep the weights:"
+         << endl;
+    if (tester.testWBLEFTISTMerge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting BINOMIAL heap - check whether root degrees increase and every tree is a heap-ordered binomial tree:"
+         << endl;
+    if (tester.testBINOMIALProperty()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing BINOMIAL heap - check whether merging and converting to binomial trees keep every student:"
+         << endl;
+    if (tester.testBINOMIALMerge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting student index - check whether lookups, duplicate rejection and erase work in all structures:"
+         << endl;
+    if (tester.testIndexLookup()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing student index - check whether copies and merges keep the index, and shared students are rejected:"
+         << endl;
+    if (tester.testIndexMerge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting aging - check whether students that waited longer are served first in all structures:" << endl;
+    if (tester.testAgingOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing aging - check whether waiting time survives rekeying, and whether invalid aging throws:" << endl;
+    if (tester.testAgingRekey()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing aging - check whether a rekey that throws keeps the rate, the function and the order:" << endl;
+    if (tester.testAgingRekeyFailure()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting quota queue - check whether classes at their quota are skipped and the order is kept:" << endl;
+    if (tester.testQuotaMaxSeats()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing quota queue - check whether minimum shares are met within a seat limit in all structures:" << endl;
+    if (tester.testQuotaMinShare()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting mergeWithQueue (rekey) - check whether queues of any configuration merge into the host's:"
+         << endl;
+    if (tester.testMergeRekey()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing mergeWithQueue (rekey) - check whether merged students keep their waiting time:" << endl;
+    if (tester.testMergeRekeyAging()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing mergeWithQueue (rekey) - check whether a rekey that throws leaves both queues as they were:" << endl;
+    if (tester.testMergeRekeyFailure()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting external queue - check whether spilled runs are served in the order of an in-memory queue:"
+         << endl;
+    if (tester.testExternalOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing external queue - check whether radix order is enforced across the runs:" << endl;
+    if (tester.testExternalRadix()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting journal - check whether recovery replays the journal on top of the last snapshot:" << endl;
+    if (tester.testJournalRecovery()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing journal - check whether records that wrap around or outgrow the ring are recovered:" << endl;
+    if (tester.testJournalRingWrap()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting shared queue - check whether students inserted by several processes come out in order:" << endl;
+    if (tester.testSharedProcesses()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing shared queue - check whether the heap is repaired after a process died holding the lock:" << endl;
+    if (tester.testSharedRepair()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting intake queue - check whether students inserted by several threads are all served:" << endl;
+    if (tester.testIntakeConcurrent()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing intake queue - check whether batches are served in the order of the wrapped queue:" << endl;
+    if (tester.testIntakeOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting lazy merge - check whether lazily merged queues serve like eagerly merged ones:" << endl;
+    if (tester.testLazyMergeOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing lazy merge - check whether the dummies survive a snapshot and the journal:" << endl;
+    if (tester.testLazyMergeSnapshot()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing lazy merge - check whether a crown of 150000 dummies can be copied, measured and checkpointed:"
+         << endl;
+    if (tester.testLazyMergeDeepCrown()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting compaction - check whether compact keeps the shape and lays the nodes out level by level:"
+         << endl;
+    if (tester.testCompactLayout()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing compaction - check whether full rebuilds compact the heap when auto compaction is on:" << endl;
+    if (tester.testAutoCompact()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting queue registry - check whether sections are found, removed and cleared in a shared arena:"
+         << endl;
+    if (tester.testRegistrySections()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing queue registry - check whether sections merge within, into and out of the arena:" << endl;
+    if (tester.testRegistryMerge()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting frozen queues - check whether reads work on a frozen queue and the first change thaws it:"
+         << endl;
+    if (tester.testFreezeThaw()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing frozen queues - check whether frozen queues survive a snapshot and the journal:" << endl;
+    if (tester.testFreezeSnapshot()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing frozen queues - check whether quota and external queues take over every frozen student:" << endl;
+    if (tester.testFreezeTakeOver()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting priority counts - check whether counts and histograms follow every change of the queue:"
+         << endl;
+    if (tester.testCountsIncremental()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing priority counts - check whether counts reject other priority functions and bad arguments:"
+         << endl;
+    if (tester.testCountsErrors()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting transactions - check whether a rollback puts back the same nodes and a commit drops them:"
+         << endl;
+    if (tester.testTransactionRollback()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing transactions - check whether transactions are guarded, journaled and rolled back on recovery:"
+         << endl;
+    if (tester.testTransactionJournal()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing transactions - check whether quota and external queues refuse a queue with a transaction:"
+         << endl;
+    if (tester.testTransactionTakeOver()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting popFromEach - check whether a batch pops the same students and leaves the same heaps:" << endl;
+    if (tester.testPopFromEachOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing popFromEach - check whether transactions are rejected and the pops are journaled:" << endl;
+    if (tester.testPopFromEachGuards()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting ReleaseQueue - check whether students become eligible exactly when their time comes:" << endl;
+    if (tester.testReleaseWaves()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing ReleaseQueue - check whether unsupported queues, early reads and going back in time throw:"
+         << endl;
+    if (tester.testReleaseErrors()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    cout << "\nTesting PolicySimulator - check whether every policy admits the best students in the right order:"
+         << endl;
+    if (tester.testPolicySimulatorOrder()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+    cout << "Testing PolicySimulator - check whether a policy that throws fails the run:" << endl;
+    if (tester.testPolicySimulatorErrors()) {
+        cout << "\tTest passed!" << endl;
+    } else {
+        cout << "\t***Test failed!***" << endl;
+    }
+
+    return 0;
+}
+
+int priorityFn1(const Student &student) {
+    //this function works with a MAXHEAP
+    //priority value is determined based on some criteria
+    //priority value falls in the range [0-10]
+    //level + major + group
+    //the highest priority would be 3+4+3 = 10
+    //the lowest priority would be 0+0+0 = 0
+    //the larger value means the higher priority
+    int priority = student.getLevel() + student.getMajor() + student.getGroup();
+    return priority;
+}
+
+int priorityFn2(const Student &student) {
+    //this function works with a MINHEAP
+    //priority value is determined based on some criteria
+    //priority value falls in the range [0-10]
+    //race + gender + income + highschool
+    //the highest priority would be 0+0+0+0 = 0
+    //the lowest priority would be 2+2+4+2 = 10
+    //the smaller value means the higher priority
+    int priority = student.getRace() + student.getGender() + student.getIncome() + student.getHighschool();
+    return priority;
+}
+
+int priorityFnWide(const Student &student) {
+    //this function works with a MINHEAP
+    //priority value is the name read as a base-26 number, it falls in the range [0-11881375]
+    //longer names or other characters wrap around within that range
+    //the smaller value means the higher priority
+    const int64_t range = 11881376;
+    int64_t priority = 0;
+    string name = student.getName();
+    for (unsigned int i = 0; i < name.size(); i++) {
+        priority = ((priority * 26 + (name[i] - 'a')) % range + range) % range;
+    }
+    return (int) priority;
+}
+
+int64_t priorityFnTimestamp(const Student &student) {
+    //this function works with either heap type
+    //priority value is a microsecond timestamp in 2024, far outside the int range
+    //the name spreads the students over the year
+    int64_t yearStart = 1704067200000000LL;
+    return yearStart + (int64_t) priorityFnWide(student) * 2654435LL;
+}
+
+double priorityFnScore(const Student &student) {
+    //this function works with a MINHEAP
+    //priority value is a GPA-weighted score, it can be negative
+    //a student named "Nan Score" gets a NaN score
+    //the smaller value means the higher priority
+    if (student.getName() == "Nan Score") {
+        return nan("");
+    }
+    return 0.35 * student.getIncome() - 0.8 * student.getLevel() + priorityFnWide(student) / 1e7;
+}
+
+int priorityFnStrict(const Student &student) {
+    //this function works with a MAXHEAP
+    //priority value is the same as priorityFn1, but a student named "Unranked student" cannot be ranked
+    if (student.getName() == "Unranked student") {
+        throw invalid_argument("Student cannot be ranked");
+    }
+    return priorityFn1(student);
 }
@@ -1,61 +1,601 @@
 // UMBC - CMSC 341 - Spring 2024 - Proj3
 #include "rqueue.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <cctype>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sstream>
+#include <exception>
+
+#ifdef RQUEUE_STATS
+#include <chrono>
+
+//times one public operation and charges the comparisons made inside it to that operation
+//nested operations (e.g. the merge inside insertStudent) are charged to the outermost one
+class StatsScope {
+public:
+    StatsScope(int &opDepth, OpStats &op, const long long &comparisons) :
+            m_opDepth(opDepth), m_op(op), m_comparisons(comparisons), m_startComparisons(comparisons),
+            m_start(std::chrono::steady_clock::now()) {
+        m_opDepth++;
+    }
+    ~StatsScope() {
+        m_opDepth--;
+        if (m_opDepth == 0) {
+            std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - m_start;
+            m_op.m_calls++;
+            m_op.m_comparisons += m_comparisons - m_startComparisons;
+            m_op.m_latency.record(elapsed.count());
+        }
+    }
+    StatsScope(const StatsScope &) = delete;
+    StatsScope &operator=(const StatsScope &) = delete;
+private:
+    int &m_opDepth;
+    OpStats &m_op;
+    const long long &m_comparisons;
+    long long m_startComparisons;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+//tracks the recursion depth of the merge functions
+class MergeDepthGuard {
+public:
+    MergeDepthGuard(int &depth, int &maxDepth) : m_depth(depth) {
+        if (++m_depth > maxDepth) {
+            maxDepth = m_depth;
+        }
+    }
+    ~MergeDepthGuard() {
+        m_depth--;
+    }
+    MergeDepthGuard(const MergeDepthGuard &) = delete;
+    MergeDepthGuard &operator=(const MergeDepthGuard &) = delete;
+private:
+    int &m_depth;
+};
+
+#define RQ_COUNT(stmt) stmt
+#define RQ_SCOPE(op) StatsScope statsScope(m_opDepth, m_stats.op, m_stats.m_comparisons)
+#define RQ_MERGE_DEPTH MergeDepthGuard mergeDepthGuard(m_mergeDepth, m_stats.m_maxMergeDepth)
+#else
+#define RQ_COUNT(stmt)
+#define RQ_SCOPE(op)
+#define RQ_MERGE_DEPTH
+#endif
+
+//binary encoding of run files, snapshots and journal records (native byte order, read back on the same host);
+//students are packed with varints. Values go to an ostream or, on the journal's writer thread, to a byte array
+class ByteSink {
+public:
+    explicit ByteSink(char *bytes) : m_pos(bytes) {}
+    void write(const char *data, size_t size) {
+        memcpy(m_pos, data, size);
+        m_pos += size;
+    }
+    void put(char byte) {
+        *m_pos++ = byte;
+    }
+    char *position() const {return m_pos;}
+private:
+    char *m_pos;
+};
+
+const int MAX_VARINT = 10; // bytes of the longest varint
+
+template <class T, class Out>
+static void putValue(Out &out, const T &value) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <class T>
+static T getValue(istream &in) {
+    T value = T();
+    in.read(reinterpret_cast<char *>(&value), sizeof(value));
+    return value;
+}
+
+//7 bits per byte, the high bit says that more bytes follow
+template <class Out>
+static void putVarint(Out &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.put((char) (value | 0x80));
+        value >>= 7;
+    }
+    out.put((char) value);
+}
+
+static uint64_t getVarint(istream &in) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 7 * MAX_VARINT; shift += 7) {
+        int byte = in.get();
+        if (byte == EOF) {
+            break;
+        }
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    in.setstate(ios::failbit);
+    return 0;
+}
+
+template <class Out>
+static void putString(Out &out, const string &text) {
+    putVarint(out, text.size());
+    out.write(text.data(), text.size());
+}
+
+static string getString(istream &in) {
+    uint64_t size = getVarint(in);
+    string text;
+    if (in && size <= (1u << 24)) {
+        text.resize(size);
+        in.read(&text[0], size);
+    } else {
+        in.setstate(ios::failbit);
+    }
+    return text;
+}
+
+//attributes are zigzag encoded, so small negative values stay short as well
+template <class Out>
+static void putZigzag(Out &out, int64_t value) {
+    putVarint(out, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+template <class Out>
+static void putStudent(Out &out, const Student &student) {
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        putZigzag(out, student.getAttribute((ATTRIBUTE) i));
+    }
+    putString(out, student.getName());
+}
+
+static Student getStudent(istream &in) {
+    int fields[NUM_ATTRIBUTES];
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        uint64_t value = getVarint(in);
+        fields[i] = (int) (int64_t) ((value >> 1) ^ (~(value & 1) + 1));
+    }
+    string name = getString(in);
+    return Student(name, fields[ATTR_LEVEL], fields[ATTR_MAJOR], fields[ATTR_GROUP], fields[ATTR_RACE],
+                   fields[ATTR_GENDER], fields[ATTR_INCOME], fields[ATTR_HIGHSCHOOL]);
+}
+
+//upper bound of the packed size of a student
+static size_t studentBytes(const Student &student) {
+    return (NUM_ATTRIBUTES + 1) * MAX_VARINT + student.getName().size();
+}
+
+//frozen queues keep their students sorted by key, each one as the zigzag delta to the previous key, its
+//attributes and its name; attributes within their valid ranges form one mixed-radix number (low bit 0),
+//any other student is marked with a 1 and followed by its attributes one by one
+template <class Out>
+static void putFrozenStudent(Out &out, int64_t delta, const Student &student) {
+    putVarint(out, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+    uint64_t packed = 0;
+    bool inRange = true;
+    for (int i = NUM_ATTRIBUTES - 1; i >= 0; i--) {
+        int value = student.getAttribute((ATTRIBUTE) i);
+        inRange = inRange && value >= 0 && value <= ATTRIBUTE_MAX[i];
+        packed = packed * (ATTRIBUTE_MAX[i] + 1) + value;
+    }
+    if (inRange) {
+        putVarint(out, packed << 1);
+    } else {
+        putVarint(out, 1);
+        for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+            int64_t value = student.getAttribute((ATTRIBUTE) i);
+            putVarint(out, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+        }
+    }
+    putString(out, student.getName());
+}
+
+//decodes the students of a frozen queue one by one, in key order
+class FrozenReader {
+public:
+    explicit FrozenReader(const string &data) : m_pos(data.data()), m_end(data.data() + data.size()), m_key(0) {}
+    bool atEnd() const {return m_pos == m_end;}
+    bool next(int64_t &key, Student &student) { // false at the end or if the buffer is malformed
+        uint64_t delta = 0;
+        uint64_t packed = 0;
+        if (!varint(delta) || !varint(packed)) {
+            return false;
+        }
+        m_key = (int64_t) ((uint64_t) m_key + ((delta >> 1) ^ (~(delta & 1) + 1)));
+        int fields[NUM_ATTRIBUTES];
+        for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+            if (packed & 1) {
+                uint64_t value = 0;
+                if (!varint(value)) {
+                    return false;
+                }
+                fields[i] = (int) (int64_t) ((value >> 1) ^ (~(value & 1) + 1));
+            } else {
+                fields[i] = (int) ((packed >> 1) % (ATTRIBUTE_MAX[i] + 1));
+                packed = ((packed >> 1) / (ATTRIBUTE_MAX[i] + 1)) << 1;
+            }
+        }
+        uint64_t size = 0;
+        if (!varint(size) || size > (uint64_t) (m_end - m_pos)) {
+            return false;
+        }
+        key = m_key;
+        student = Student(string(m_pos, size), fields[ATTR_LEVEL], fields[ATTR_MAJOR], fields[ATTR_GROUP],
+                          fields[ATTR_RACE], fields[ATTR_GENDER], fields[ATTR_INCOME], fields[ATTR_HIGHSCHOOL]);
+        m_pos += size;
+        return true;
+    }
+private:
+    const char *m_pos;
+    const char *m_end;
+    int64_t m_key;  // key of the last student decoded
+
+    bool varint(uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 7 * MAX_VARINT && m_pos < m_end; shift += 7) {
+            uint8_t byte = *m_pos++;
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
 
 RQueue::RQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure) {
+    m_priorFunc = priFn;
+    m_priorFunc64 = nullptr;
+    m_priorFuncReal = nullptr;
+    m_useSpec = false;
+    initialize(heapType, structure);
+}
+
+RQueue::RQueue(prifn64_t priFn, HEAPTYPE heapType, STRUCTURE structure) {
+    m_priorFunc = nullptr;
+    m_priorFunc64 = priFn;
+    m_priorFuncReal = nullptr;
+    m_useSpec = false;
+    initialize(heapType, structure);
+}
+
+RQueue::RQueue(prifnreal_t priFn, HEAPTYPE heapType, STRUCTURE structure) {
+    m_priorFunc = nullptr;
+    m_priorFunc64 = nullptr;
+    m_priorFuncReal = priFn;
+    m_useSpec = false;
+    initialize(heapType, structure);
+}
+
+RQueue::RQueue(const PrioritySpec &spec, STRUCTURE structure) {
+    m_priorFunc = nullptr;
+    m_priorFunc64 = nullptr;
+    m_priorFuncReal = nullptr;
+    m_useSpec = true;
+    initialize(MINHEAP, structure);
+    extras().m_prioritySpec = spec;
+}
+
+void RQueue::initialize(HEAPTYPE heapType, STRUCTURE structure) {
+    //shared by the constructors, the priority function has already been set
     m_heap = nullptr;
     m_size = 0;
-    m_priorFunc = priFn;
     m_heapType = heapType;
     m_structure = structure;
+    m_arity = DEFAULT_ARITY;
+    m_lastKey = INT64_MIN;
+    m_indexed = false;
+    m_agingRate = 0;
+    m_epoch = 0;
+    m_journal = nullptr;
+    m_lazyMerge = false;
+    m_dummies = 0;
+    m_autoCompact = false;
+    m_frozen = false;
+    m_transaction = false;
+    m_extras = nullptr;
+    m_ownPools = new QueueArena();
+    m_nodes = &m_ownPools->m_nodes;
+    m_students = &m_ownPools->m_students;
+    m_arena = nullptr;
+    if (structure == RADIX) {
+        extras();
+    }
+#ifdef RQUEUE_STATS
+    m_mergeDepth = 0;
+    m_opDepth = 0;
+#endif
+}
+
+QueueExtras &RQueue::extras() {
+    if (m_extras == nullptr) {
+        m_extras = new QueueExtras();
+    }
+    return *m_extras;
 }
 
 RQueue::~RQueue() {
+    //the journal keeps the last state, destroying the queue does not clear it
+    if (m_journal != nullptr) {
+        m_journal->detach();
+    }
     clear();
+    delete m_extras;
+    delete m_ownPools;
 }
 
 void RQueue::clear() {
-    //deallocate all memory
-    destroyHeap(m_heap);
+    //deallocate all memory, the pools release whole blocks so there is no need to walk the heap;
+    //the blocks of an arena are shared with other queues, so there each object is given back on its own
+    RQ_COUNT(m_stats.m_deallocations += m_size);
+    releasePopped();
+    m_transaction = false;
+    if (m_arena == nullptr) {
+        m_ownPools->m_nodes.reset();
+        m_ownPools->m_students.reset();
+    } else {
+        releaseAll();
+    }
+    m_entries.clear();
 
-    //re-initialize member variables
+    //re-initialize member variables, the configuration in m_extras stays and kept counts start again from zero
     m_heap = nullptr;
     m_size = 0;
-}
+    m_lastKey = INT64_MIN;
+    m_dummies = 0;
+    m_frozen = false;
+    if (m_extras != nullptr) {
+        m_extras->m_buckets.clear();
+        m_extras->m_index.clear();
+        string().swap(m_extras->m_frozenData);
+        m_extras->m_counts = QueueCounts();
+    }
 
-void RQueue::destroyHeap(Node *node) {
-    //if node is not nullptr
-    if (node) {
-        //recursively deallocate memory for left and right sub-heaps
-        destroyHeap(node->m_left);
-        destroyHeap(node->m_right);
-        delete node;
+    if (m_journal != nullptr) {
+        m_journal->logOp(QueueJournal::OP_CLEAR);
     }
 }
 
 RQueue::RQueue(const RQueue &rhs) {
-    //mirror member variables
+    //mirror member variables, the copy is not journaled and has pools of its own
     m_size = rhs.m_size;
+    m_extras = nullptr;
+    m_ownPools = new QueueArena();
+    m_nodes = &m_ownPools->m_nodes;
+    m_students = &m_ownPools->m_students;
+    m_arena = nullptr;
+    copyConfig(rhs);
+    m_lastKey = rhs.m_lastKey;
+    m_journal = nullptr;
+    m_lazyMerge = rhs.m_lazyMerge;
+    m_dummies = rhs.m_dummies;
+    m_autoCompact = rhs.m_autoCompact;
+    m_frozen = rhs.m_frozen;
+    copyExtras(rhs);
+    m_transaction = false;
+#ifdef RQUEUE_STATS
+    m_mergeDepth = 0;
+    m_opDepth = 0;
+#endif
+
+    //make current object a deep copy of rhs
+    copyNodes(rhs.m_heap, m_heap);
+    copyEntries(rhs);
+    copyIndex(rhs);
+}
+
+void RQueue::copyConfig(const RQueue &rhs) {
+    //everything that decides the order of the students, but none of the students
     m_priorFunc = rhs.m_priorFunc;
+    m_priorFunc64 = rhs.m_priorFunc64;
+    m_priorFuncReal = rhs.m_priorFuncReal;
+    m_useSpec = rhs.m_useSpec;
+    if (m_useSpec) {
+        extras().m_prioritySpec = rhs.m_extras->m_prioritySpec;
+    }
     m_heapType = rhs.m_heapType;
     m_structure = rhs.m_structure;
+    if (m_structure == RADIX) {
+        extras();
+    }
+    m_arity = rhs.m_arity;
+    m_agingRate = rhs.m_agingRate;
+    m_epoch = rhs.m_epoch;
+}
 
-    //make current object a deep copy of rhs
-    copyNodes(rhs.m_heap, m_heap);
+void RQueue::copyExtras(const RQueue &rhs) {
+    //the frozen buffer and the kept counts, the buckets and the index are copied with the students
+    if (rhs.m_frozen) {
+        extras().m_frozenData = rhs.m_extras->m_frozenData;
+    }
+    if (rhs.counted()) {
+        extras().m_counted = true;
+        m_extras->m_counts = rhs.m_extras->m_counts;
+    } else if (m_extras != nullptr) {
+        m_extras->m_counted = false;
+    }
 }
 
-void RQueue::copyNodes(Node *sourceNode, Node *&destinationNode) {
-    if (sourceNode == nullptr) {
-        destinationNode = nullptr;
+void RQueue::initializeLike(const RQueue &rhs) {
+    initialize(rhs.m_heapType, rhs.m_structure);
+    copyConfig(rhs);
+}
+
+void RQueue::releaseAll() {
+    //the heap can be as deep as it is large, so it is walked with an explicit stack
+    vector<Node *> stack;
+    if (m_heap != nullptr) {
+        stack.push_back(m_heap);
+    }
+    while (!stack.empty()) {
+        Node *node = stack.back();
+        stack.pop_back();
+        if (node->m_left != nullptr) {
+            stack.push_back(node->m_left);
+        }
+        if (node->m_right != nullptr) {
+            stack.push_back(node->m_right);
+        }
+        if (node->m_student != nullptr) {
+            m_students->release(node->m_student);
+        }
+        m_nodes->release(node);
+    }
+    for (unsigned int i = 0; i < m_entries.size(); i++) {
+        m_students->release(m_entries[i].m_student);
+    }
+    if (m_structure == RADIX) {
+        vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+        for (unsigned int i = 0; i < buckets.size(); i++) {
+            for (unsigned int j = 0; j < buckets[i].size(); j++) {
+                m_students->release(buckets[i][j].m_student);
+            }
+        }
+    }
+    m_heap = nullptr;
+}
+
+void RQueue::moveToArena(QueueArena *arena) {
+    if (arena == m_arena) {
+        return;
+    }
+    if (m_arena == nullptr) {
+        //blocks of its own can simply be handed to the arena, the queue keeps no pools of its own there
+        arena->m_nodes.adopt(m_ownPools->m_nodes);
+        arena->m_students.adopt(m_ownPools->m_students);
+        delete m_ownPools;
+        m_ownPools = nullptr;
     } else {
-        //allocate memory and copy over the data from each node
-        destinationNode = new Node(*sourceNode);
+        //the blocks of an arena are shared, so the students are copied out with the exact same shape,
+        //then the copy's blocks go to the new pools together with its content
+        RQueue copy(*this);
+        QueueJournal *journal = m_journal;
+        m_journal = nullptr;
+        clear();
+        m_journal = journal;
+
+        if (arena == nullptr) {
+            m_ownPools = new QueueArena();
+        }
+        QueueArena *pools = (arena == nullptr) ? m_ownPools : arena;
+        pools->m_nodes.adopt(copy.m_ownPools->m_nodes);
+        pools->m_students.adopt(copy.m_ownPools->m_students);
+        m_heap = copy.m_heap;
+        m_size = copy.m_size;
+        m_lastKey = copy.m_lastKey;
+        m_dummies = copy.m_dummies;
+        m_entries.swap(copy.m_entries);
+        m_frozen = copy.m_frozen;
+        swap(m_extras, copy.m_extras);
+        copy.m_heap = nullptr;
+        copy.m_size = 0;
+        copy.m_dummies = 0;
+        copy.m_frozen = false;
+    }
+    m_nodes = (arena == nullptr) ? &m_ownPools->m_nodes : &arena->m_nodes;
+    m_students = (arena == nullptr) ? &m_ownPools->m_students : &arena->m_students;
+    m_arena = arena;
+}
+
+void RQueue::copyNodes(Node *sourceNode, Node *&destinationNode) {
+    //preorder with an explicit stack: the crown of a lazily merged heap is as deep as the number of merges
+    vector<pair<Node *, Node **> > stack(1, make_pair(sourceNode, &destinationNode));
+    while (!stack.empty()) {
+        Node *source = stack.back().first;
+        Node *&destination = *stack.back().second;
+        stack.pop_back();
+        if (source == nullptr) {
+            destination = nullptr;
+            continue;
+        }
+
+        //allocate memory and copy over the data from each node, dummies stay dummies
+        if (source->m_student == nullptr) {
+            destination = newDummy(nullptr, nullptr);
+        } else {
+            destination = newNode(*source->m_student, source->m_key);
+        }
+        destination->m_npl = source->m_npl;
+        destination->m_weight = source->m_weight;
+        stack.push_back(make_pair(source->m_right, &destination->m_right));
+        stack.push_back(make_pair(source->m_left, &destination->m_left));
+    }
+}
+
+void RQueue::copyEntries(const RQueue &rhs) {
+    //the array-backed heaps keep their layout, each entry gets its own copy of the student
+    m_entries = rhs.m_entries;
+    for (unsigned int i = 0; i < m_entries.size(); i++) {
+        m_entries[i].m_student = storeStudent(*m_entries[i].m_student);
+    }
+    if (rhs.m_structure == RADIX) {
+        vector<vector<HeapEntry> > &buckets = extras().m_buckets;
+        buckets = rhs.m_extras->m_buckets;
+        for (unsigned int i = 0; i < buckets.size(); i++) {
+            for (unsigned int j = 0; j < buckets[i].size(); j++) {
+                buckets[i][j].m_student = storeStudent(*buckets[i][j].m_student);
+            }
+        }
+    }
+}
+
+void RQueue::copyIndex(const RQueue &rhs) {
+    m_indexed = rhs.m_indexed;
+    if (!m_indexed) {
+        return;
+    }
 
-        //preorder traversal of heap
-        copyNodes(sourceNode->m_left, destinationNode->m_left);
-        copyNodes(sourceNode->m_right, destinationNode->m_right);
+    //the copy has the same layout as rhs, so both list their students in the same order
+    vector<Student *> source;
+    vector<Student *> destination;
+    rhs.collectStudents(source);
+    collectStudents(destination);
+    for (unsigned int i = 0; i < destination.size(); i++) {
+        extras().m_index.insert(destination[i], rhs.m_extras->m_index.isWithdrawn(source[i]));
     }
 }
 
+Node *RQueue::newNode(const Student &student, int64_t key) {
+    //the node and its student come from separate pools, so merges only touch the compact nodes
+    Node *node = m_nodes->allocate();
+    node->m_key = key;
+    node->m_left = nullptr;
+    node->m_right = nullptr;
+    node->m_student = storeStudent(student);
+    node->m_npl = 0;
+    node->m_weight = 1;
+    RQ_COUNT(m_stats.m_allocations++; m_stats.m_bytesAllocated += sizeof(Node) + sizeof(Student));
+    return node;
+}
+
+Node *RQueue::newDummy(Node *left, Node *right) {
+    //the smallest key, so the dummy is above any heap it is linked to
+    Node *node = m_nodes->allocate();
+    node->m_key = INT64_MIN;
+    node->m_left = left;
+    node->m_right = right;
+    node->m_student = nullptr;
+    node->m_npl = (left == nullptr || right == nullptr) ? 0 : min(left->m_npl, right->m_npl) + 1;
+    node->m_weight = 1 + ((left == nullptr) ? 0 : left->m_weight) + ((right == nullptr) ? 0 : right->m_weight);
+    RQ_COUNT(m_stats.m_allocations++; m_stats.m_bytesAllocated += sizeof(Node));
+    return node;
+}
+
 HEAPTYPE RQueue::getHeapType() const {
     return m_heapType;
 }
@@ -66,18 +606,39 @@ RQueue &RQueue::operator=(const RQueue &rhs) {
         return *this;
     }
 
+    //a journaled queue records the copy it becomes rather than clearing and rebuilding itself
+    QueueJournal *journal = m_journal;
+    string encoded;
+    if (journal != nullptr) {
+        ostringstream out;
+        rhs.writeConfig(out, *journal);
+        rhs.writeBody(out);
+        encoded = out.str();
+    }
+    m_journal = nullptr;
+
     //otherwise, destroy current object
     clear();
 
     //mirror member variables
     m_size = rhs.m_size;
-    m_priorFunc = rhs.m_priorFunc;
-    m_heapType = rhs.m_heapType;
-    m_structure = rhs.m_structure;
+    copyConfig(rhs);
+    m_lastKey = rhs.m_lastKey;
+    m_lazyMerge = rhs.m_lazyMerge;
+    m_dummies = rhs.m_dummies;
+    m_autoCompact = rhs.m_autoCompact;
+    m_frozen = rhs.m_frozen;
+    copyExtras(rhs);
 
     //make current object a deep copy of rhs
     copyNodes(rhs.m_heap, m_heap);
+    copyEntries(rhs);
+    copyIndex(rhs);
 
+    m_journal = journal;
+    if (journal != nullptr) {
+        journal->logQueue(QueueJournal::OP_ASSIGN, encoded);
+    }
     return *this;
 }
 
@@ -86,237 +647,4758 @@ void RQueue::mergeWithQueue(RQueue &rhs) {
     if (this == &rhs) {
         return;
     }
+    RQ_SCOPE(m_merge);
+    checkTransaction();
+    rhs.checkTransaction();
+    thaw();
+    rhs.thaw();
 
-    //merge host queue with rhs if conditions are met
-    if (m_structure == LEFTIST && rhs.m_structure == LEFTIST && m_priorFunc == rhs.m_priorFunc &&
-        m_heapType == rhs.m_heapType) {
-        m_heap = mergeLEFTIST(m_heap, rhs.m_heap);
-    } else if (m_structure == SKEW && rhs.m_structure == SKEW && m_priorFunc == rhs.m_priorFunc &&
-               m_heapType == rhs.m_heapType) {
-        m_heap = mergeSKEW(m_heap, rhs.m_heap);
-    } else {
-        throw domain_error("Cannot merge queues with different priority functions or different data structures");
+    //withdrawn students of rhs are dropped first, then an indexed host takes in the rest of rhs
+    if (rhs.m_indexed && rhs.m_extras->m_index.withdrawnCount() > 0) {
+        rhs.purgeWithdrawn();
+    }
+    //the blocks of an arena cannot be handed over, students of another arena move to the host's pools first
+    if (rhs.m_arena != nullptr && rhs.m_arena != m_arena) {
+        rhs.moveToArena(m_arena);
+    }
+    vector<Student *> added;
+    if (m_indexed) {
+        indexStudents(rhs, added);
+    }
+    //a host that keeps counts adds those of rhs, which are started while rhs can still be walked on its own
+    if (counted()) {
+        rhs.counts();
     }
 
-    //update heap size after merge
+    //the journal records the students of rhs in the exact shape they are merged in
+    string encoded;
+    if (m_journal != nullptr) {
+        ostringstream out;
+        rhs.writeBody(out);
+        encoded = out.str();
+    }
+
+    try {
+        //merge host queue with rhs if conditions are met
+        bool nodes = (m_structure == SKEW || m_structure == LEFTIST || m_structure == WBLEFTIST ||
+                      m_structure == BINOMIAL);
+        if (!m_lazyMerge && nodes) {
+            //an eager merge walks the right spines, which must not run through dummies
+            settle();
+            rhs.settle();
+        }
+        if (m_lazyMerge && nodes && m_structure == rhs.m_structure && samePriority(rhs)) {
+            //a lazy merge only links the roots, the spines are walked when the dummies are purged
+            if (m_heap == nullptr || rhs.m_heap == nullptr) {
+                m_heap = (m_heap == nullptr) ? rhs.m_heap : m_heap;
+            } else {
+                m_heap = newDummy(m_heap, rhs.m_heap);
+                m_dummies++;
+            }
+        } else if (m_structure == LEFTIST && rhs.m_structure == LEFTIST && samePriority(rhs)) {
+            m_heap = mergeLEFTIST(m_heap, rhs.m_heap);
+        } else if (m_structure == SKEW && rhs.m_structure == SKEW && samePriority(rhs)) {
+            m_heap = mergeSKEW(m_heap, rhs.m_heap);
+        } else if (m_structure == DARY && rhs.m_structure == DARY && samePriority(rhs)) {
+            mergeDARY(rhs);
+        } else if (m_structure == RADIX && rhs.m_structure == RADIX && samePriority(rhs)) {
+            mergeRADIX(rhs);
+        } else if (m_structure == WBLEFTIST && rhs.m_structure == WBLEFTIST && samePriority(rhs)) {
+            m_heap = mergeWBLEFTIST(m_heap, rhs.m_heap);
+        } else if (m_structure == BINOMIAL && rhs.m_structure == BINOMIAL && samePriority(rhs)) {
+            m_heap = mergeBINOMIAL(m_heap, rhs.m_heap);
+        } else {
+            throw domain_error("Cannot merge queues with different priority functions or different data structures");
+        }
+    } catch (...) {
+        //the queues are unchanged, so neither is the index
+        for (unsigned int i = 0; i < added.size(); i++) {
+            m_extras->m_index.remove(added[i]);
+        }
+        throw;
+    }
+
+    //update heap size and counts after merge
     m_size += rhs.m_size;
+    m_dummies += rhs.m_dummies;
+    if (counted()) {
+        m_extras->m_counts.add(rhs.m_extras->m_counts);
+    }
+
+    //the merged nodes and students now belong to the host, take over their memory unless both share an arena
+    if (rhs.m_arena == nullptr) {
+        m_nodes->adopt(rhs.m_ownPools->m_nodes);
+        m_students->adopt(rhs.m_ownPools->m_students);
+    }
 
     //leave rhs empty
     rhs.m_heap = nullptr;
     rhs.m_size = 0;
+    rhs.m_dummies = 0;
+    if (rhs.m_extras != nullptr) {
+        rhs.m_extras->m_index.clear();
+        rhs.m_extras->m_counts = QueueCounts();
+    }
+
+    if (m_journal != nullptr) {
+        m_journal->logQueue(QueueJournal::OP_MERGE, encoded);
+    }
+    if (rhs.m_journal != nullptr) {
+        rhs.m_journal->logOp(QueueJournal::OP_CLEAR);
+    }
 }
 
-Node *RQueue::mergeLEFTIST(Node *lhs, Node *rhs) {
-    if (lhs == nullptr) {
-        //base case 1
-        return rhs;
-    } else if (rhs == nullptr) {
-        //base case 2
-        return lhs;
-    } else if (priorityCheck(lhs, rhs)) {
-        //if lhs has higher priority
-        lhs->m_right = mergeLEFTIST(lhs->m_right, rhs);
+void RQueue::mergeWithQueue(RQueue &rhs, MERGEPOLICY policy) {
+    //protection against self-merging
+    if (this == &rhs) {
+        return;
+    }
+    checkTransaction();
+    rhs.checkTransaction();
+    thaw();
+    rhs.thaw();
 
-        if (lhs->m_left == nullptr) {
-            //if left side is empty, move right child to left side
-            lhs->m_left = lhs->m_right;
-            lhs->m_right = nullptr;
-        } else {
-            //if the NPL value of right child is larger than that of left child, swap them
-            if (lhs->m_right->m_npl > lhs->m_left->m_npl) {
-                Node *temp = lhs->m_left;
-                lhs->m_left = lhs->m_right;
-                lhs->m_right = temp;
-            }
-            //update NPL values
-            lhs->m_npl = lhs->m_right->m_npl + 1;
+    //a queue with another configuration is first rebuilt in the host's, in linear time
+    if (policy == MERGE_REKEY && (m_structure != rhs.m_structure || !samePriority(rhs))) {
+        rhs.convertTo(*this);
+        if (rhs.m_journal != nullptr) {
+            ostringstream out;
+            rhs.writeConfig(out, *rhs.m_journal);
+            rhs.writeBody(out);
+            rhs.m_journal->logQueue(QueueJournal::OP_ASSIGN, out.str());
         }
-        return lhs;
-    } else {
-        //if rhs has higher priority, swap lhs and rhs and call merge recursively
-        return mergeLEFTIST(rhs, lhs);
     }
+    mergeWithQueue(rhs);
 }
 
-Node *RQueue::mergeSKEW(Node *lhs, Node *rhs) {
-    if (lhs == nullptr) {
-        //base case 1
-        return rhs;
-    } else if (rhs == nullptr) {
-        //base case 2
-        return lhs;
-    } else if (priorityCheck(lhs, rhs)) {
-        //if lhs has higher priority, swap its children, then recursively merge rhs and the left sub-heap of lhs
-        //replace the left subtree of lhs with the result of the recursive merge
-        Node *temp = lhs->m_right;
-        lhs->m_right = lhs->m_left;
-        lhs->m_left = mergeSKEW(rhs, temp);
+void RQueue::convertTo(const RQueue &host) {
+    //withdrawn students are dropped rather than converted
+    purgeWithdrawn();
+    settle();
 
-        //once all merges are complete, return
-        return lhs;
+    //students keep the time they have waited, measured on the host's clock; every new key is computed before
+    //the queue changes, so a priority function that throws or an aged key that overflows leaves it intact
+    vector<HeapEntry> entries;
+    collectEpochs(entries, host.m_epoch);
+    computeKeys(entries, host.keyConfig());
+
+    //flatten the heap, take over the host configuration and bulk-build the new structure
+    if (m_structure == RADIX) {
+        drainBuckets();
+    } else if (m_structure != DARY) {
+        Node *oldNode = m_heap;
+        m_heap = nullptr;
+        moveNodesToArray(oldNode);
+    }
+    m_entries.swap(entries);
+    copyConfig(host);
+    if (m_structure == DARY) {
+        heapify();
+    } else if (m_structure == RADIX) {
+        fillBuckets();
     } else {
-        //if rhs has higher priority, swap lhs and rhs and call merge recursively
-        return mergeSKEW(rhs, lhs);
+        moveArrayToNodes();
+        rebuilt();
     }
+    recount();
 }
 
-bool RQueue::priorityCheck(Node *lhs, Node *rhs) {
-    //compares the priority of two nodes based on heap type
-    if ((m_heapType == MINHEAP && m_priorFunc(lhs->m_student) <= m_priorFunc(rhs->m_student)) ||
-        (m_heapType == MAXHEAP && m_priorFunc(lhs->m_student) >= m_priorFunc(rhs->m_student))) {
-        return true;
+void RQueue::indexStudents(const RQueue &rhs, vector<Student *> &added) {
+    //adds every student of rhs to the index, on a duplicate the index is restored and nothing is added
+    vector<Student *> students;
+    rhs.collectStudents(students);
+    for (unsigned int i = 0; i < students.size(); i++) {
+        if (!m_extras->m_index.insert(students[i])) {
+            for (unsigned int j = 0; j < added.size(); j++) {
+                m_extras->m_index.remove(added[j]);
+            }
+            added.clear();
+            throw domain_error("Cannot merge queues that hold the same student");
+        }
+        added.push_back(students[i]);
     }
-    return false;
 }
 
-void RQueue::insertStudent(const Student &student) {
-    //make a temporary heap with the same properties as the current one (to ensure merge can occur)
-    RQueue tempQueue(m_priorFunc, m_heapType, m_structure);
-
-    //allocate memory for new node using passed-in student object, make it the root of temporary heap
-    tempQueue.m_heap = new Node(student);
+void RQueue::collectStudents(vector<Student *> &students) const {
+    //every stored student, in the order of the underlying structure
+    if (m_structure == DARY) {
+        for (unsigned int i = 0; i < m_entries.size(); i++) {
+            students.push_back(m_entries[i].m_student);
+        }
+    } else if (m_structure == RADIX) {
+        const vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+        for (unsigned int i = 0; i < buckets.size(); i++) {
+            for (unsigned int j = 0; j < buckets[i].size(); j++) {
+                students.push_back(buckets[i][j].m_student);
+            }
+        }
+    } else {
+        collectStudents(m_heap, students);
+    }
+}
 
-    //merge the two heaps, essentially inserting node into current heap
-    mergeWithQueue(tempQueue);
+void RQueue::collectStudents(Node *node, vector<Student *> &students) const {
+    //preorder with an explicit stack, see copyNodes
+    vector<Node *> stack(1, node);
+    while (!stack.empty()) {
+        Node *curr = stack.back();
+        stack.pop_back();
+        if (curr != nullptr) {
+            if (curr->m_student != nullptr) {
+                students.push_back(curr->m_student);
+            }
+            stack.push_back(curr->m_right);
+            stack.push_back(curr->m_left);
+        }
+    }
+}
 
-    m_size++;
+void RQueue::collectEntries(vector<HeapEntry> &entries) const {
+    //every stored student with its cached key
+    if (m_structure == DARY) {
+        entries.insert(entries.end(), m_entries.begin(), m_entries.end());
+    } else if (m_structure == RADIX) {
+        const vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+        for (unsigned int i = 0; i < buckets.size(); i++) {
+            entries.insert(entries.end(), buckets[i].begin(), buckets[i].end());
+        }
+    } else {
+        collectEntries(m_heap, entries);
+    }
 }
 
-int RQueue::numStudents() const {
-    return m_size;
+void RQueue::collectEntries(Node *node, vector<HeapEntry> &entries) const {
+    //preorder with an explicit stack, see copyNodes
+    vector<Node *> stack(1, node);
+    while (!stack.empty()) {
+        Node *curr = stack.back();
+        stack.pop_back();
+        if (curr != nullptr) {
+            if (curr->m_student != nullptr) {
+                HeapEntry entry;
+                entry.m_key = curr->m_key;
+                entry.m_student = curr->m_student;
+                entries.push_back(entry);
+            }
+            stack.push_back(curr->m_right);
+            stack.push_back(curr->m_left);
+        }
+    }
 }
 
-prifn_t RQueue::getPriorityFn() const {
-    return m_priorFunc;
+void RQueue::insertKeyed(const Student &student, int64_t key) {
+    //the key was computed by a queue with the same configuration, e.g. with its aging offset
+    if (m_structure == DARY) {
+        HeapEntry entry;
+        entry.m_key = key;
+        entry.m_student = storeStudent(student);
+        m_entries.push_back(entry);
+        siftUp(m_entries.size() - 1);
+    } else if (m_structure == RADIX) {
+        if (key < m_lastKey) {
+            throw domain_error("Radix heap requires monotone priorities: student is ahead of the last one served");
+        }
+        HeapEntry entry;
+        entry.m_key = key;
+        entry.m_student = storeStudent(student);
+        insertRadix(entry);
+    } else {
+        settle();
+        m_heap = mergeNodes(m_heap, newNode(student, key));
+    }
+    m_size++;
+    countStudent(student, 1);
 }
 
-Student RQueue::getNextStudent() {
-    //throw error if queue is empty
-    if (m_size == 0) {
-        throw out_of_range("Queue is empty");
+int64_t RQueue::topKey() {
+    if (m_structure == DARY) {
+        return m_entries[0].m_key;
+    } else if (m_structure == RADIX) {
+        settleRadix();
+        return m_extras->m_buckets[0].back().m_key;
     }
+    settle();
+    return (m_structure == BINOMIAL) ? (*bestRoot())->m_key : m_heap->m_key;
+}
 
-    //get the highest priority student from root node
-    Student highestPriorityStudent = m_heap->m_student;
+void RQueue::setIndexed(bool indexed) {
+    checkTransaction();
+    thaw();
+    if (indexed == m_indexed) {
+        return;
+    }
+    if (indexed) {
+        //the index is built over the stored students, which must not share a name
+        vector<Student *> students;
+        collectStudents(students);
+        StudentIndex &index = extras().m_index;
+        for (unsigned int i = 0; i < students.size(); i++) {
+            if (!index.insert(students[i])) {
+                index.clear();
+                throw domain_error("Cannot index a queue that holds the same student twice");
+            }
+        }
+    } else {
+        //without the index, withdrawn students could not be told apart any more
+        purgeWithdrawn();
+        m_extras->m_index.clear();
+    }
+    m_indexed = indexed;
 
-    //save the left and right sub-heaps
-    Node *lhs = m_heap->m_left;
-    Node *rhs = m_heap->m_right;
+    if (m_journal != nullptr) {
+        m_journal->logValue(QueueJournal::OP_SET_INDEXED, indexed);
+    }
+}
 
-    //remove the root node from the heap
-    delete m_heap;
+bool RQueue::isIndexed() const {
+    return m_indexed;
+}
 
-    if (m_size == 1) {
-        //if there's only one node in the heap, empty the heap
+bool RQueue::contains(const string &name) const {
+    if (!m_indexed) {
+        throw domain_error("Queue is not indexed");
+    }
+    if (m_frozen) {
+        return findFrozen(name, nullptr);
+    }
+    return m_extras->m_index.find(name) != nullptr;
+}
+
+bool RQueue::find(const string &name, Student &student) const {
+    if (!m_indexed) {
+        throw domain_error("Queue is not indexed");
+    }
+    if (m_frozen) {
+        return findFrozen(name, &student);
+    }
+    Student *stored = m_extras->m_index.find(name);
+    if (stored == nullptr) {
+        return false;
+    }
+    student = *stored;
+    return true;
+}
+
+bool RQueue::erase(const string &name) {
+    checkTransaction();
+    thaw();
+    if (!m_indexed) {
+        throw domain_error("Queue is not indexed");
+    }
+    //the student is only marked, it is dropped when it reaches the top, but it is no longer counted
+    StudentIndex &index = m_extras->m_index;
+    Student *stored = index.find(name);
+    if (stored == nullptr) {
+        return false;
+    }
+    index.withdraw(name);
+    countStudent(*stored, -1);
+
+    //once withdrawn students make up half of the heap, drop them all at once
+    if (index.withdrawnCount() * 2 > m_size) {
+        purgeWithdrawn();
+    }
+
+    if (m_journal != nullptr) {
+        m_journal->logText(QueueJournal::OP_ERASE, name);
+    }
+    return true;
+}
+
+void RQueue::purgeWithdrawn() {
+    if (!m_indexed || m_extras->m_index.withdrawnCount() == 0) {
+        return;
+    }
+
+    if (m_structure == RADIX) {
+        //a bucket does not depend on the order of its entries, filter each one in place
+        for (unsigned int i = 0; i < m_extras->m_buckets.size(); i++) {
+            dropWithdrawn(m_extras->m_buckets[i]);
+        }
+        return;
+    }
+
+    //flatten the heap, drop the withdrawn entries, then rebuild
+    settle();
+    if (m_structure != DARY) {
+        Node *oldNode = m_heap;
         m_heap = nullptr;
+        moveNodesToArray(oldNode);
+    }
+    dropWithdrawn(m_entries);
+    if (m_structure == DARY) {
+        heapify();
     } else {
-        //otherwise, maintain min-heap or max-heap property by merging the two sub-heaps
-        if (m_structure == LEFTIST) {
-            m_heap = mergeLEFTIST(lhs, rhs);
+        moveArrayToNodes();
+        rebuilt();
+    }
+}
+
+void RQueue::dropWithdrawn(vector<HeapEntry> &entries) {
+    unsigned int kept = 0;
+    StudentIndex &index = m_extras->m_index;
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        if (index.isWithdrawn(entries[i].m_student)) {
+            index.remove(entries[i].m_student);
+            m_students->release(entries[i].m_student);
+            m_size--;
         } else {
-            m_heap = mergeSKEW(lhs, rhs);
+            entries[kept++] = entries[i];
         }
     }
+    entries.resize(kept);
+}
 
-    //update size of heap
-    m_size--;
+Node *RQueue::mergeLEFTIST(Node *lhs, Node *rhs) {
+    RQ_MERGE_DEPTH;
+    if (lhs == nullptr) {
+        //base case 1
+        return rhs;
+    } else if (rhs == nullptr) {
+        //base case 2
+        return lhs;
+    } else if (priorityCheck(lhs, rhs)) {
+        //if lhs has higher priority
+        lhs->m_right = mergeLEFTIST(lhs->m_right, rhs);
 
-    return highestPriorityStudent;
+        if (lhs->m_left == nullptr) {
+            //if left side is empty, move right child to left side
+            lhs->m_left = lhs->m_right;
+            lhs->m_right = nullptr;
+        } else {
+            //if the NPL value of right child is larger than that of left child, swap them
+            if (lhs->m_right->m_npl > lhs->m_left->m_npl) {
+                Node *temp = lhs->m_left;
+                lhs->m_left = lhs->m_right;
+                lhs->m_right = temp;
+            }
+            //update NPL values
+            lhs->m_npl = lhs->m_right->m_npl + 1;
+        }
+        return lhs;
+    } else {
+        //if rhs has higher priority, swap lhs and rhs and call merge recursively
+        return mergeLEFTIST(rhs, lhs);
+    }
 }
 
-void RQueue::setPriorityFn(prifn_t priFn, HEAPTYPE heapType) {
-    m_priorFunc = priFn;
-    m_heapType = heapType;
+Node *RQueue::mergeSKEW(Node *lhs, Node *rhs) {
+    RQ_MERGE_DEPTH;
+    if (lhs == nullptr) {
+        //base case 1
+        return rhs;
+    } else if (rhs == nullptr) {
+        //base case 2
+        return lhs;
+    } else if (priorityCheck(lhs, rhs)) {
+        //if lhs has higher priority, swap its children, then recursively merge rhs and the left sub-heap of lhs
+        //replace the left subtree of lhs with the result of the recursive merge
+        Node *temp = lhs->m_right;
+        lhs->m_right = lhs->m_left;
+        lhs->m_left = mergeSKEW(rhs, temp);
 
-    Node *oldNode = m_heap;
-    m_heap = nullptr;
-    rebuildHeap(oldNode);
+        //once all merges are complete, return
+        return lhs;
+    } else {
+        //if rhs has higher priority, swap lhs and rhs and call merge recursively
+        return mergeSKEW(rhs, lhs);
+    }
 }
 
-void RQueue::setStructure(STRUCTURE structure) {
-    m_structure = structure;
+Node *RQueue::mergeWBLEFTIST(Node *lhs, Node *rhs) {
+    if (lhs == nullptr) {
+        return rhs;
+    } else if (rhs == nullptr) {
+        return lhs;
+    }
 
-    Node *oldNode = m_heap;
-    m_heap = nullptr;
-    rebuildHeap(oldNode);
+    //the root with higher priority becomes the root of the merged heap
+    if (!priorityCheck(lhs, rhs)) {
+        Node *temp = lhs;
+        lhs = rhs;
+        rhs = temp;
+    }
+    Node *root = lhs;
+    RQ_COUNT(int steps = 0);
+
+    //walk down the right spines; the subtree sizes are known up front, so each node decides
+    //on the way down which side receives the merge of its right child with the other heap
+    while (true) {
+        RQ_COUNT(steps++);
+        Node *right = lhs->m_right;
+        int leftWeight = (lhs->m_left == nullptr) ? 0 : lhs->m_left->m_weight;
+        int mergedWeight = ((right == nullptr) ? 0 : right->m_weight) + rhs->m_weight;
+        lhs->m_weight += rhs->m_weight;
+
+        //the heavier subtree stays on the left
+        Node **slot = &lhs->m_right;
+        if (leftWeight < mergedWeight) {
+            lhs->m_right = lhs->m_left;
+            slot = &lhs->m_left;
+        }
+
+        if (right == nullptr) {
+            //nothing left to merge with, the other heap is attached as a whole
+            *slot = rhs;
+            break;
+        } else if (priorityCheck(right, rhs)) {
+            *slot = right;
+            lhs = right;
+        } else {
+            *slot = rhs;
+            lhs = rhs;
+            rhs = right;
+        }
+    }
+    RQ_COUNT(m_stats.m_maxMergeDepth = max(m_stats.m_maxMergeDepth, steps));
+
+    return root;
 }
 
-void RQueue::rebuildHeap(Node *oldNode) {
-    if (oldNode != nullptr) {
-        //postorder traversal
-        rebuildHeap(oldNode->m_left);
-        rebuildHeap(oldNode->m_right);
+Node *RQueue::mergeBINOMIAL(Node *lhs, Node *rhs) {
+    if (lhs == nullptr) {
+        return rhs;
+    } else if (rhs == nullptr) {
+        return lhs;
+    }
 
-        //remove inserted nodes from old heap
-        oldNode->m_left = nullptr;
-        oldNode->m_right = nullptr;
+    //merge the two root lists by degree, lhs first on equal degrees
+    Node *head = nullptr;
+    Node **tail = &head;
+    while (lhs != nullptr && rhs != nullptr) {
+        Node **smaller = (lhs->m_npl <= rhs->m_npl) ? &lhs : &rhs;
+        *tail = *smaller;
+        tail = &(*smaller)->m_right;
+        *smaller = (*smaller)->m_right;
+    }
+    *tail = (lhs != nullptr) ? lhs : rhs;
 
-        //insert each node into new "heap"
-        insertPointer(oldNode, m_heap);
+    //then link trees of equal degree, like the carries of a binary addition; there are at most
+    //three trees of a degree at a time, and only the last two of them are linked
+    RQ_COUNT(int steps = 0);
+    Node *prev = nullptr;
+    Node *curr = head;
+    Node *next = curr->m_right;
+    while (next != nullptr) {
+        RQ_COUNT(steps++);
+        if (curr->m_npl != next->m_npl || (next->m_right != nullptr && next->m_right->m_npl == curr->m_npl)) {
+            prev = curr;
+            curr = next;
+        } else if (priorityCheck(curr, next)) {
+            curr->m_right = next->m_right;
+            linkBINOMIAL(curr, next);
+        } else {
+            if (prev == nullptr) {
+                head = next;
+            } else {
+                prev->m_right = next;
+            }
+            linkBINOMIAL(next, curr);
+            curr = next;
+        }
+        next = curr->m_right;
     }
+    RQ_COUNT(m_stats.m_maxMergeDepth = max(m_stats.m_maxMergeDepth, steps));
+    return head;
 }
 
-void RQueue::insertPointer(Node *oldNode, Node *newNode) {
+void RQueue::linkBINOMIAL(Node *parent, Node *child) {
+    child->m_right = parent->m_left;
+    parent->m_left = child;
+    parent->m_npl++;
+}
+
+Node **RQueue::bestRoot() {
+    //the best student is at one of the O(log n) roots, the first one wins ties
+    Node **best = &m_heap;
+    for (Node **link = &m_heap->m_right; *link != nullptr; link = &(*link)->m_right) {
+        if (!priorityCheck(*best, *link)) {
+            best = link;
+        }
+    }
+    return best;
+}
+
+Node *RQueue::detachBINOMIAL() {
+    //unlink the best root
+    Node **link = bestRoot();
+    Node *top = *link;
+    *link = top->m_right;
+
+    //its children are ordered by decreasing degree, reversed they are a root list of their own
+    Node *children = nullptr;
+    Node *child = top->m_left;
+    while (child != nullptr) {
+        Node *next = child->m_right;
+        child->m_right = children;
+        children = child;
+        child = next;
+    }
+    m_heap = mergeBINOMIAL(m_heap, children);
+    m_size--;
+    return top;
+}
+
+Node *RQueue::mergeNodes(Node *lhs, Node *rhs) {
     if (m_structure == LEFTIST) {
-        m_heap = mergeLEFTIST(oldNode, newNode);
+        return mergeLEFTIST(lhs, rhs);
+    } else if (m_structure == WBLEFTIST) {
+        return mergeWBLEFTIST(lhs, rhs);
+    } else if (m_structure == BINOMIAL) {
+        return mergeBINOMIAL(lhs, rhs);
+    }
+    return mergeSKEW(lhs, rhs);
+}
+
+void RQueue::settle() {
+    if (m_dummies > 0) {
+        purgeDummies();
+    }
+}
+
+void RQueue::purgeDummies() {
+    //the dummies form a crown: every node below one is either a dummy or the root of a proper heap;
+    //the crown can be as deep as the number of lazy merges, so it is walked with an explicit stack
+    vector<Node *> heaps;
+    vector<Node *> crown(1, m_heap);
+    while (!crown.empty()) {
+        Node *node = crown.back();
+        crown.pop_back();
+        if (node == nullptr) {
+            continue;
+        } else if (node->m_student != nullptr) {
+            heaps.push_back(node);
+        } else {
+            crown.push_back(node->m_right);
+            crown.push_back(node->m_left);
+            m_nodes->release(node);
+            RQ_COUNT(m_stats.m_deallocations++);
+        }
+    }
+    m_dummies = 0;
+
+    //k heaps melded round by round cost O(k log(n/k)); the leftmost heap is the host the others were
+    //merged into, usually much larger, so its right spine is walked once at the end instead of every round
+    Node *host = heaps.empty() ? nullptr : heaps[0];
+    if (!heaps.empty()) {
+        heaps.erase(heaps.begin());
+    }
+    m_heap = mergeNodes(host, meldAll(heaps));
+}
+
+bool RQueue::priorityCheck(Node *lhs, Node *rhs) {
+    //compares the cached keys of two nodes, the heap type is already folded into the keys
+    RQ_COUNT(m_stats.m_comparisons++);
+    return lhs->m_key <= rhs->m_key;
+}
+
+bool RQueue::samePriority(const RQueue &rhs) const {
+    //cached keys are only comparable if both queues compute them the same way
+    return m_priorFunc == rhs.m_priorFunc && m_priorFunc64 == rhs.m_priorFunc64 &&
+           m_priorFuncReal == rhs.m_priorFuncReal && m_useSpec == rhs.m_useSpec &&
+           (!m_useSpec || m_extras->m_prioritySpec == rhs.m_extras->m_prioritySpec) && m_heapType == rhs.m_heapType &&
+           m_agingRate == rhs.m_agingRate && m_epoch == rhs.m_epoch;
+}
+
+void RQueue::insertStudent(const Student &student) {
+    checkTransaction();
+    thaw();
+    RQ_SCOPE(m_insert);
+
+    //an indexed queue holds each student at most once
+    if (m_indexed && m_extras->m_index.find(student.m_name) != nullptr) {
+        throw invalid_argument("Student is already in the queue");
+    }
+
+    Student *stored = nullptr;
+    if (m_structure == DARY) {
+        //array-backed heap, no node to allocate
+        stored = insertEntry(student);
+    } else if (m_structure == RADIX) {
+        HeapEntry entry;
+        entry.m_key = agedKey(student, m_epoch);
+        if (entry.m_key < m_lastKey) {
+            throw domain_error("Radix heap requires monotone priorities: student is ahead of the last one served");
+        }
+        entry.m_student = storeStudent(student);
+        insertRadix(entry);
+        stored = entry.m_student;
     } else {
-        m_heap = mergeSKEW(oldNode, newNode);
+        //allocate memory for new node using passed-in student object, computing its key once
+        settle();
+        Node *node = newNode(student, agedKey(student, m_epoch));
+        stored = node->m_student;
+
+        //merge the single node heap into the current heap
+        m_heap = mergeNodes(m_heap, node);
+    }
+
+    if (m_indexed) {
+        m_extras->m_index.insert(stored);
+    }
+    m_size++;
+    countStudent(student, 1);
+
+    if (m_journal != nullptr) {
+        m_journal->logInsert(student);
     }
 }
 
-STRUCTURE RQueue::getStructure() const {
-    return m_structure;
+int RQueue::numStudents() const {
+    //withdrawn students are still stored until they reach the top
+    return m_indexed ? m_size - m_extras->m_index.withdrawnCount() : m_size;
 }
 
-void RQueue::printStudentsQueue() const {
-    cout << "Contents of the queue: \n";
+prifn_t RQueue::getPriorityFn() const {
+    return m_priorFunc;
+}
 
-    //print the contents of the queue using preorder traversal
-    preorderPrint(m_heap);
+prifn64_t RQueue::getPriorityFn64() const {
+    return m_priorFunc64;
 }
 
-void RQueue::preorderPrint(Node *node) const {
-    if (node != nullptr) {
-        //visit all nodes and print each student's details
-        cout << "[" << m_priorFunc(node->m_student) << "] Student name: " << node->m_student.m_name << ", Major: "
-             << node->m_student.getMajorStr() << ", Gender: " << node->m_student.getGenderStr() << ", Level: "
-             << node->m_student.getLevelStr() << "\n";
-        preorderPrint(node->m_left);
-        preorderPrint(node->m_right);
+prifnreal_t RQueue::getPriorityFnReal() const {
+    return m_priorFuncReal;
+}
+
+Student RQueue::getNextStudent() {
+    checkTransaction();
+    thaw();
+    //throw error if queue is empty
+    if (numStudents() == 0) {
+        throw out_of_range("Queue is empty");
+    }
+    RQ_SCOPE(m_extract);
+
+    Student *top = extractTop();
+    if (m_indexed) {
+        //withdrawn students are dropped once they reach the top
+        while (m_extras->m_index.isWithdrawn(top)) {
+            m_extras->m_index.remove(top);
+            m_students->release(top);
+            top = extractTop();
+        }
+        m_extras->m_index.remove(top);
+    }
+    countStudent(*top, -1);
+
+    if (m_journal != nullptr) {
+        m_journal->logOp(QueueJournal::OP_EXTRACT);
     }
+    return releaseStudent(top);
 }
 
-void RQueue::dump() const {
-    if (m_size == 0) {
-        cout << "Empty heap.\n";
+//asks the cache for a node a later step of an interleaved merge reads
+static inline void prefetchNode(const void *node) {
+#if defined(__GNUC__)
+    __builtin_prefetch(node);
+#endif
+}
+
+int RQueue::popFromEach(const vector<RQueue *> &queues, vector<Student> &students) {
+    //one root merge in flight, the iterative form of mergeSKEW/mergeLEFTIST(m_lhs, m_rhs)
+    struct PendingMerge {
+        RQueue *m_queue;
+        bool m_skew;    // skew heap, otherwise leftist
+        Node *m_lhs;
+        Node *m_rhs;
+        Node **m_link;  // where the next node of the merged heap is linked
+        int m_spine;    // nodes linked so far, the leftist heap fixes their NPL bottom-up afterwards
+    };
+
+    for (RQueue *queue : queues) {
+        queue->checkTransaction();
+        prefetchNode(queue->m_heap);
+    }
+    students.assign(queues.size(), Student());
+    vector<Student *> tops(queues.size(), nullptr);
+    vector<PendingMerge> pending;
+    pending.reserve(queues.size());
+    int popped = 0;
+
+    //detach the roots; the queues the interleaved merges can't serve are popped on their own
+    for (size_t i = 0; i < queues.size(); i++) {
+        RQueue *queue = queues[i];
+        if ((queue->m_structure != SKEW && queue->m_structure != LEFTIST) || queue->m_frozen ||
+            queue->m_dummies > 0 || (queue->m_indexed && queue->m_extras->m_index.withdrawnCount() > 0)) {
+            if (queue->numStudents() > 0) {
+                students[i] = queue->getNextStudent();
+                popped++;
+            }
+            continue;
+        }
+        if (queue->m_size == 0) {
+            continue;
+        }
+        RQ_COUNT(queue->m_stats.m_extract.m_calls++);
+        Node *top = queue->m_heap;
+        tops[i] = top->m_student;
+        prefetchNode(top->m_student);
+        if (top->m_left == nullptr || top->m_right == nullptr) {
+            queue->m_heap = (top->m_left != nullptr) ? top->m_left : top->m_right;
+        } else {
+            prefetchNode(top->m_left);
+            prefetchNode(top->m_right);
+            pending.push_back({queue, queue->m_structure == SKEW, top->m_left, top->m_right, &queue->m_heap, 0});
+        }
+        queue->m_nodes->release(top);
+        queue->m_size--;
+        popped++;
+    }
+
+    //one step of every merge per round, finished merges drop out
+    vector<Node *> spine;
+    while (!pending.empty()) {
+        size_t live = 0;
+        for (PendingMerge &merge : pending) {
+            Node *winner = merge.m_lhs;
+            Node *other = merge.m_rhs;
+            if (!merge.m_queue->priorityCheck(winner, other)) {
+                swap(winner, other);
+            }
+            *merge.m_link = winner;
+            Node *next;
+            if (merge.m_skew) {
+                //swap the children, the old right child is merged into the left
+                next = winner->m_right;
+                winner->m_right = winner->m_left;
+                merge.m_link = &winner->m_left;
+                merge.m_lhs = other;
+                merge.m_rhs = next;
+            } else {
+                //the NPL fix reads the left child once the merge is done
+                prefetchNode(winner->m_left);
+                next = winner->m_right;
+                merge.m_link = &winner->m_right;
+                merge.m_lhs = next;
+                merge.m_rhs = other;
+            }
+            merge.m_spine++;
+            if (next != nullptr) {
+                prefetchNode(next);
+                pending[live++] = merge;
+                continue;
+            }
+            *merge.m_link = other;
+            if (!merge.m_skew) {
+                //restore the leftist property along the right spine, as the recursion unwinds in mergeLEFTIST
+                spine.clear();
+                for (Node *node = merge.m_queue->m_heap; (int) spine.size() < merge.m_spine; node = node->m_right) {
+                    spine.push_back(node);
+                }
+                for (int j = merge.m_spine - 1; j >= 0; j--) {
+                    Node *node = spine[j];
+                    if (node->m_left == nullptr) {
+                        node->m_left = node->m_right;
+                        node->m_right = nullptr;
+                    } else {
+                        if (node->m_right->m_npl > node->m_left->m_npl) {
+                            swap(node->m_left, node->m_right);
+                        }
+                        node->m_npl = node->m_right->m_npl + 1;
+                    }
+                }
+            }
+        }
+        pending.resize(live);
+    }
+
+    //the same bookkeeping as getNextStudent
+    for (size_t i = 0; i < queues.size(); i++) {
+        if (tops[i] == nullptr) {
+            continue;
+        }
+        RQueue *queue = queues[i];
+        if (queue->m_indexed) {
+            queue->m_extras->m_index.remove(tops[i]);
+        }
+        queue->countStudent(*tops[i], -1);
+        if (queue->m_journal != nullptr) {
+            queue->m_journal->logOp(QueueJournal::OP_EXTRACT);
+        }
+        students[i] = queue->releaseStudent(tops[i]);
+    }
+    return popped;
+}
+
+Student *RQueue::extractTop() {
+    if (m_structure == DARY) {
+        //take the top entry and refill the root with the last entry
+        HeapEntry top = m_entries[0];
+        m_entries[0] = m_entries.back();
+        m_entries.pop_back();
+        if (!m_entries.empty()) {
+            siftDown(0);
+        }
+        m_size--;
+        return top.m_student;
+    } else if (m_structure == RADIX) {
+        HeapEntry top = extractRadix();
+        m_size--;
+        return top.m_student;
+    }
+
+    //get the highest priority student from root node, then recycle the node
+    Node *top = detachRoot();
+    Student *highestPriorityStudent = top->m_student;
+    m_nodes->release(top);
+    RQ_COUNT(m_stats.m_deallocations++);
+
+    return highestPriorityStudent;
+}
+
+Node *RQueue::detachRoot() {
+    settle();
+    if (m_structure == BINOMIAL) {
+        return detachBINOMIAL();
+    }
+    Node *top = m_heap;
+
+    if (m_size == 1) {
+        //if there's only one node in the heap, empty the heap
+        m_heap = nullptr;
     } else {
-        dump(m_heap);
+        //otherwise, maintain min-heap or max-heap property by merging the two sub-heaps
+        m_heap = mergeNodes(top->m_left, top->m_right);
     }
-    cout << endl;
+
+    //update size of heap
+    m_size--;
+
+    return top;
 }
 
-void RQueue::dump(Node *pos) const {
-    if (pos != nullptr) {
-        cout << "(";
-        dump(pos->m_left);
-        if (m_structure == SKEW)
-            cout << m_priorFunc(pos->m_student) << ":" << pos->m_student.m_name;
-        else
-            cout << m_priorFunc(pos->m_student) << ":" << pos->m_student.m_name << ":" << pos->m_npl;
-        dump(pos->m_right);
-        cout << ")";
+void RQueue::setPriorityFn(prifn_t priFn, HEAPTYPE heapType) {
+    checkTransaction();
+    thaw();
+    string name = (m_journal != nullptr) ? m_journal->nameOf(priFn) : "";
+    KeyConfig config = keyConfig();
+    config.m_priorFunc = priFn;
+    config.m_priorFunc64 = nullptr;
+    config.m_priorFuncReal = nullptr;
+    config.m_useSpec = false;
+    config.m_heapType = heapType;
+    rekeyHeap(config);
+
+    if (m_journal != nullptr) {
+        m_journal->logPriorityFn(QueueJournal::FN_INT, name, heapType);
     }
 }
 
-ostream &operator<<(ostream &sout, const Student &student) {
-    sout << "Student name: " << student.m_name
-         << ", Major: " << student.getMajorStr()
-         << ", Gender: " << student.getGenderStr()
-         << ", Level: " << student.getLevelStr();
-    return sout;
+void RQueue::setPriorityFn(prifn64_t priFn, HEAPTYPE heapType) {
+    checkTransaction();
+    thaw();
+    string name = (m_journal != nullptr) ? m_journal->nameOf(priFn) : "";
+    KeyConfig config = keyConfig();
+    config.m_priorFunc = nullptr;
+    config.m_priorFunc64 = priFn;
+    config.m_priorFuncReal = nullptr;
+    config.m_useSpec = false;
+    config.m_heapType = heapType;
+    rekeyHeap(config);
+
+    if (m_journal != nullptr) {
+        m_journal->logPriorityFn(QueueJournal::FN_INT64, name, heapType);
+    }
 }
 
-ostream &operator<<(ostream &sout, const Node &node) {
-    sout << node.m_student;
-    return sout;
-}
\ No newline at end of file
+void RQueue::setPriorityFn(prifnreal_t priFn, HEAPTYPE heapType) {
+    checkTransaction();
+    thaw();
+    if (m_agingRate != 0) {
+        throw domain_error("Aging needs an integer priority function");
+    }
+    string name = (m_journal != nullptr) ? m_journal->nameOf(priFn) : "";
+    KeyConfig config = keyConfig();
+    config.m_priorFunc = nullptr;
+    config.m_priorFunc64 = nullptr;
+    config.m_priorFuncReal = priFn;
+    config.m_useSpec = false;
+    config.m_heapType = heapType;
+    rekeyHeap(config);
+
+    if (m_journal != nullptr) {
+        m_journal->logPriorityFn(QueueJournal::FN_REAL, name, heapType);
+    }
+}
+
+void RQueue::setPrioritySpec(const PrioritySpec &spec) {
+    checkTransaction();
+    thaw();
+    if (m_agingRate != 0) {
+        throw domain_error("Aging needs an integer priority function");
+    }
+    KeyConfig config = keyConfig();
+    config.m_priorFunc = nullptr;
+    config.m_priorFunc64 = nullptr;
+    config.m_priorFuncReal = nullptr;
+    config.m_useSpec = true;
+    config.m_prioritySpec = spec;
+    config.m_heapType = MINHEAP;
+    rekeyHeap(config);
+
+    if (m_journal != nullptr) {
+        m_journal->logText(QueueJournal::OP_SET_SPEC, spec.toString());
+    }
+}
+
+bool RQueue::usesPrioritySpec() const {
+    return m_useSpec;
+}
+
+PrioritySpec RQueue::getPrioritySpec() const {
+    return (m_extras != nullptr) ? m_extras->m_prioritySpec : PrioritySpec();
+}
+
+void RQueue::rekeyHeap(const KeyConfig &config) {
+    //students keep the time they have waited; every new key is computed before the queue changes, so a priority
+    //function that throws or an aged key that overflows leaves the configuration and the heap as they were
+    settle();
+    vector<HeapEntry> entries;
+    collectEpochs(entries, m_epoch);
+    computeKeys(entries, config);
+    setKeyConfig(config);
+
+    //the priority function may have changed, so the priorities are counted again
+    recount();
+    if (m_structure == DARY) {
+        //same students in the same order, rebuild in linear time
+        m_entries.swap(entries);
+        heapify();
+        return;
+    } else if (m_structure == RADIX) {
+        //a new priority function starts a new monotone sequence
+        drainBuckets();
+        m_entries.swap(entries);
+        fillBuckets();
+        return;
+    }
+
+    //the keys go back in the preorder collectEntries read them in, then the nodes are merged anew
+    vector<Node *> stack(1, m_heap);
+    unsigned int next = 0;
+    while (!stack.empty()) {
+        Node *node = stack.back();
+        stack.pop_back();
+        if (node != nullptr) {
+            node->m_key = entries[next++].m_key;
+            stack.push_back(node->m_right);
+            stack.push_back(node->m_left);
+        }
+    }
+    Node *oldNode = m_heap;
+    m_heap = nullptr;
+    rebuildHeap(oldNode);
+    rebuilt();
+}
+
+int64_t RQueue::agedKey(const Student &student, int64_t epoch) {
+    //every queued student ages at the same rate, so only the enqueue epoch goes into the key:
+    //rankKey - rate * (now - epoch) orders like rankKey + rate * epoch, and a tick changes nothing stored
+    int64_t key = rankKey(student);
+    if (m_agingRate == 0) {
+        return key;
+    }
+    int64_t offset;
+    if (__builtin_mul_overflow(m_agingRate, epoch, &offset) || __builtin_add_overflow(key, offset, &key)) {
+        throw overflow_error("Aged priority does not fit in 64 bits");
+    }
+    return key;
+}
+
+RQueue::KeyConfig RQueue::keyConfig() const {
+    KeyConfig config;
+    config.m_priorFunc = m_priorFunc;
+    config.m_priorFunc64 = m_priorFunc64;
+    config.m_priorFuncReal = m_priorFuncReal;
+    config.m_useSpec = m_useSpec;
+    if (m_extras != nullptr) {
+        config.m_prioritySpec = m_extras->m_prioritySpec;
+    }
+    config.m_heapType = m_heapType;
+    config.m_agingRate = m_agingRate;
+    return config;
+}
+
+void RQueue::setKeyConfig(const KeyConfig &config) {
+    m_priorFunc = config.m_priorFunc;
+    m_priorFunc64 = config.m_priorFunc64;
+    m_priorFuncReal = config.m_priorFuncReal;
+    m_useSpec = config.m_useSpec;
+    if (m_useSpec) {
+        extras().m_prioritySpec = config.m_prioritySpec;
+    }
+    m_heapType = config.m_heapType;
+    m_agingRate = config.m_agingRate;
+}
+
+void RQueue::collectEpochs(vector<HeapEntry> &entries, int64_t now) {
+    //without aging the time a student has waited is not recorded, so it counts from now
+    collectEntries(entries);
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        if (m_agingRate == 0) {
+            entries[i].m_key = now;
+        } else {
+            entries[i].m_key = (entries[i].m_key - rankKey(*entries[i].m_student)) / m_agingRate + now - m_epoch;
+        }
+    }
+}
+
+void RQueue::computeKeys(vector<HeapEntry> &entries, const KeyConfig &config) {
+    //agedKey works on the configuration of the queue, so it is swapped in for the computation only
+    KeyConfig own = keyConfig();
+    setKeyConfig(config);
+    try {
+        for (unsigned int i = 0; i < entries.size(); i++) {
+            entries[i].m_key = agedKey(*entries[i].m_student, entries[i].m_key);
+        }
+    } catch (...) {
+        setKeyConfig(own);
+        throw;
+    }
+    setKeyConfig(own);
+}
+
+void RQueue::setAgingRate(int64_t rate) {
+    checkTransaction();
+    thaw();
+    if (rate < 0) {
+        throw out_of_range("Aging rate must not be negative");
+    }
+    if (rate != 0 && (m_useSpec || m_priorFuncReal != nullptr)) {
+        throw domain_error("Aging needs an integer priority function");
+    }
+    if (rate == m_agingRate) {
+        return;
+    }
+
+    //students keep the time they have waited; without aging that time is not recorded,
+    //so switching aging on counts from the current epoch
+    KeyConfig config = keyConfig();
+    config.m_agingRate = rate;
+    rekeyHeap(config);
+
+    if (m_journal != nullptr) {
+        m_journal->logValue(QueueJournal::OP_SET_AGING, rate);
+    }
+}
+
+int64_t RQueue::getAgingRate() const {
+    return m_agingRate;
+}
+
+void RQueue::advanceEpoch(int64_t ticks) {
+    if (ticks < 0) {
+        throw out_of_range("Epoch cannot go backwards");
+    }
+    //the keys hold enqueue epochs, so waiting students move ahead of newcomers without any rekeying
+    m_epoch += ticks;
+
+    if (m_journal != nullptr) {
+        m_journal->logValue(QueueJournal::OP_ADVANCE_EPOCH, ticks);
+    }
+}
+
+int64_t RQueue::getEpoch() const {
+    return m_epoch;
+}
+
+void RQueue::setLazyMerge(bool lazy) {
+    if (!lazy) {
+        settle();
+    }
+    m_lazyMerge = lazy;
+
+    if (m_journal != nullptr) {
+        m_journal->logValue(QueueJournal::OP_SET_LAZY, lazy);
+    }
+}
+
+bool RQueue::isLazyMerge() const {
+    return m_lazyMerge;
+}
+
+void RQueue::compact() {
+    //popped nodes of a transaction may sit in the blocks compaction releases
+    checkTransaction();
+    if (m_structure == DARY || m_structure == RADIX || m_heap == nullptr) {
+        return;
+    }
+
+    //list the nodes level by level, the vector doubles as the queue
+    vector<Node *> order(1, m_heap);
+    for (unsigned int i = 0; i < order.size(); i++) {
+        if (order[i]->m_left != nullptr) {
+            order.push_back(order[i]->m_left);
+        }
+        if (order[i]->m_right != nullptr) {
+            order.push_back(order[i]->m_right);
+        }
+    }
+
+    //copy them into one fresh block in the same order: the children of a node are the next ones listed,
+    //so the copies find their children at the same positions; dummies of lazy merges are copied as they are
+    BlockPool<Node> own;
+    Node *block = ((m_arena == nullptr) ? own : *m_nodes).allocateBlock(order.size());
+    unsigned int next = 1;
+    for (unsigned int i = 0; i < order.size(); i++) {
+        Node *oldNode = order[i];
+        Node *newNode = block + i;
+        newNode->m_key = oldNode->m_key;
+        newNode->m_student = oldNode->m_student;
+        newNode->m_npl = oldNode->m_npl;
+        newNode->m_weight = oldNode->m_weight;
+        newNode->m_left = (oldNode->m_left != nullptr) ? block + next++ : nullptr;
+        newNode->m_right = (oldNode->m_right != nullptr) ? block + next++ : nullptr;
+    }
+    m_heap = block;
+    RQ_COUNT(m_stats.m_allocations += order.size(); m_stats.m_bytesAllocated += order.size() * sizeof(Node);
+             m_stats.m_deallocations += order.size());
+
+    //the old blocks hold no live node any more and are released together, the nodes of an arena one by one
+    if (m_arena == nullptr) {
+        m_ownPools->m_nodes.swap(own);
+    } else {
+        for (unsigned int i = 0; i < order.size(); i++) {
+            m_nodes->release(order[i]);
+        }
+    }
+}
+
+void RQueue::setAutoCompact(bool autoCompact) {
+    m_autoCompact = autoCompact;
+}
+
+bool RQueue::isAutoCompact() const {
+    return m_autoCompact;
+}
+
+void RQueue::rebuilt() {
+    if (m_autoCompact) {
+        compact();
+    }
+}
+
+void RQueue::freeze() {
+    checkTransaction();
+    if (m_frozen) {
+        return;
+    }
+    //withdrawn students and dummies are dropped first, so the buffer holds exactly the queued students
+    purgeWithdrawn();
+    settle();
+    vector<HeapEntry> entries;
+    collectEntries(entries);
+    stable_sort(entries.begin(), entries.end(), [](const HeapEntry &lhs, const HeapEntry &rhs) {
+        return lhs.m_key < rhs.m_key;
+    });
+
+    size_t bytes = 0;
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        bytes += MAX_VARINT + studentBytes(*entries[i].m_student);
+    }
+    string &data = extras().m_frozenData;
+    data.resize(bytes);
+    ByteSink sink(&data[0]);
+    int64_t prevKey = 0;
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        putFrozenStudent(sink, (int64_t) ((uint64_t) entries[i].m_key - (uint64_t) prevKey), *entries[i].m_student);
+        prevKey = entries[i].m_key;
+    }
+    data.resize(sink.position() - &data[0]);
+    data.shrink_to_fit();
+
+    //every node and student goes, pools of their own give back whole blocks
+    RQ_COUNT(m_stats.m_deallocations += m_size);
+    if (m_arena == nullptr) {
+        m_ownPools->m_nodes.reset();
+        m_ownPools->m_students.reset();
+    } else {
+        releaseAll();
+    }
+    m_heap = nullptr;
+    vector<HeapEntry>().swap(m_entries);
+    vector<vector<HeapEntry> >().swap(m_extras->m_buckets);
+    m_extras->m_index.clear();
+    m_frozen = true;
+
+    if (m_journal != nullptr) {
+        m_journal->logOp(QueueJournal::OP_FREEZE);
+    }
+}
+
+void RQueue::thaw() {
+    if (!m_frozen) {
+        return;
+    }
+    //the students come back in key order, the index is rebuilt along the way
+    FrozenReader reader(m_extras->m_frozenData);
+    m_entries.reserve(m_size);
+    HeapEntry entry;
+    Student student;
+    while (reader.next(entry.m_key, student)) {
+        entry.m_student = storeStudent(student);
+        if (m_indexed) {
+            m_extras->m_index.insert(entry.m_student);
+        }
+        m_entries.push_back(entry);
+    }
+    m_frozen = false;
+    string().swap(m_extras->m_frozenData);
+
+    //sorted keys already form a d-ary heap; the radix heap keeps its last key, which no stored key is below
+    if (m_structure == RADIX) {
+        for (unsigned int i = 0; i < m_entries.size(); i++) {
+            insertRadix(m_entries[i]);
+        }
+        m_entries.clear();
+    } else if (m_structure != DARY) {
+        moveArrayToNodes();
+        rebuilt();
+    }
+}
+
+bool RQueue::isFrozen() const {
+    return m_frozen;
+}
+
+Student RQueue::peekNextStudent() {
+    if (numStudents() == 0) {
+        throw out_of_range("Queue is empty");
+    }
+    if (m_frozen) {
+        //the first student of the buffer has the smallest key
+        FrozenReader reader(m_extras->m_frozenData);
+        int64_t key;
+        Student student;
+        reader.next(key, student);
+        return student;
+    }
+
+    //withdrawn students are dropped once they reach the top, as getNextStudent would; that and settling the
+    //dummies or the radix buckets change the heap, so the journal records the peek and replay does the same
+    int size = m_size;
+    int dummies = m_dummies;
+    int64_t lastKey = m_lastKey;
+    dropWithdrawnTops();
+    Student *top = topStudent();
+    if (m_journal != nullptr && (m_size != size || m_dummies != dummies || m_lastKey != lastKey)) {
+        m_journal->logOp(QueueJournal::OP_PEEK);
+    }
+    return *top;
+}
+
+void RQueue::dropWithdrawnTops() {
+    Student *top = topStudent();
+    while (m_indexed && m_extras->m_index.isWithdrawn(top)) {
+        m_extras->m_index.remove(top);
+        m_students->release(extractTop());
+        top = topStudent();
+    }
+}
+
+Student *RQueue::topStudent() {
+    if (m_structure == DARY) {
+        return m_entries[0].m_student;
+    } else if (m_structure == RADIX) {
+        settleRadix();
+        return m_extras->m_buckets[0].back().m_student;
+    }
+    settle();
+    return (m_structure == BINOMIAL) ? (*bestRoot())->m_student : m_heap->m_student;
+}
+
+bool RQueue::findFrozen(const string &name, Student *student) const {
+    FrozenReader reader(m_extras->m_frozenData);
+    int64_t key;
+    Student stored;
+    while (reader.next(key, stored)) {
+        if (stored.m_name == name) {
+            if (student != nullptr) {
+                *student = stored;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+int RQueue::countAt(int priority) const {
+    checkCounted(priority);
+    return counts().m_priorities[1 + priority - MIN];
+}
+
+int RQueue::countBetterThan(int priority) const {
+    checkCounted(priority);
+    //better priorities are the smaller ones of a MINHEAP and the larger ones of a MAXHEAP
+    int slot = 1 + priority - MIN;
+    int first = (m_heapType == MINHEAP) ? 0 : slot + 1;
+    int last = (m_heapType == MINHEAP) ? slot : QueueCounts::PRIORITIES;
+    const QueueCounts &kept = counts();
+    int count = 0;
+    for (int i = first; i < last; i++) {
+        count += kept.m_priorities[i];
+    }
+    return count;
+}
+
+vector<int> RQueue::histogram(ATTRIBUTE attribute) const {
+    if (attribute < 0 || attribute >= NUM_ATTRIBUTES) {
+        throw out_of_range("Unknown attribute");
+    }
+    const int *values = counts().m_attributes[attribute];
+    return vector<int>(values, values + ATTRIBUTE_MAX[attribute] + 1);
+}
+
+void RQueue::checkCounted(int priority) const {
+    if (m_priorFunc == nullptr) {
+        throw domain_error("Priority counts need an int priority function");
+    }
+    if (priority < MIN || priority > MAX) {
+        throw out_of_range("Priority is out of range");
+    }
+}
+
+bool RQueue::counted() const {
+    return m_extras != nullptr && m_extras->m_counted;
+}
+
+const QueueCounts &RQueue::counts() const {
+    //a queue nobody asks pays nothing per operation, the first query walks it once
+    if (!counted()) {
+        if (m_extras == nullptr) {
+            m_extras = new QueueExtras();
+        }
+        m_extras->m_counted = true;
+        recount();
+    }
+    return m_extras->m_counts;
+}
+
+void RQueue::countStudent(const Student &student, int delta) const {
+    if (!counted()) {
+        return;
+    }
+    //priorities and attribute values outside their ranges go to the slots at the ends
+    QueueCounts &counts = m_extras->m_counts;
+    if (m_priorFunc != nullptr) {
+        int priority = m_priorFunc(student);
+        int slot = (priority < MIN) ? 0 : (priority > MAX) ? QueueCounts::PRIORITIES - 1 : 1 + priority - MIN;
+        counts.m_priorities[slot] += delta;
+    }
+    const int values[NUM_ATTRIBUTES] = {student.m_level, student.m_major, student.m_group, student.m_race,
+                                        student.m_gender, student.m_income, student.m_highschool};
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        int slot = ((unsigned int) values[i] > (unsigned int) ATTRIBUTE_MAX[i]) ? QueueCounts::VALUES - 1 : values[i];
+        counts.m_attributes[i][slot] += delta;
+    }
+}
+
+void RQueue::recount() const {
+    if (!counted()) {
+        return;
+    }
+    //withdrawn students are no longer queued, so they are not counted
+    m_extras->m_counts = QueueCounts();
+    if (m_frozen) {
+        FrozenReader reader(m_extras->m_frozenData);
+        int64_t key;
+        Student student;
+        while (reader.next(key, student)) {
+            countStudent(student, 1);
+        }
+        return;
+    }
+    vector<Student *> students;
+    collectStudents(students);
+    for (unsigned int i = 0; i < students.size(); i++) {
+        if (!m_indexed || !m_extras->m_index.isWithdrawn(students[i])) {
+            countStudent(*students[i], 1);
+        }
+    }
+}
+
+void RQueue::begin() {
+    if (m_transaction) {
+        throw domain_error("A transaction is already open");
+    }
+    thaw();
+    m_transaction = true;
+    extras().m_beginLastKey = m_lastKey;
+
+    if (m_journal != nullptr) {
+        m_journal->logOp(QueueJournal::OP_BEGIN);
+    }
+}
+
+Student RQueue::popTentative() {
+    if (!m_transaction) {
+        throw domain_error("No transaction is open");
+    }
+    if (numStudents() == 0) {
+        throw out_of_range("Queue is empty");
+    }
+
+    //withdrawn students are dropped for good, the popped one keeps its node or entry and its key
+    dropWithdrawnTops();
+    Student *top;
+    if (m_structure == DARY || m_structure == RADIX) {
+        HeapEntry entry;
+        entry.m_key = topKey();
+        entry.m_student = extractTop();
+        m_extras->m_poppedEntries.push_back(entry);
+        top = entry.m_student;
+    } else {
+        Node *node = detachRoot();
+        node->m_left = nullptr;
+        node->m_right = nullptr;
+        m_extras->m_popped.push_back(node);
+        top = node->m_student;
+    }
+    if (m_indexed) {
+        m_extras->m_index.remove(top);
+    }
+    countStudent(*top, -1);
+
+    if (m_journal != nullptr) {
+        m_journal->logOp(QueueJournal::OP_POP);
+    }
+    return *top;
+}
+
+void RQueue::commit() {
+    if (!m_transaction) {
+        throw domain_error("No transaction is open");
+    }
+    releasePopped();
+    m_transaction = false;
+
+    if (m_journal != nullptr) {
+        m_journal->logOp(QueueJournal::OP_COMMIT);
+    }
+}
+
+void RQueue::rollback() {
+    if (!m_transaction) {
+        throw domain_error("No transaction is open");
+    }
+    vector<Node *> &poppedNodes = m_extras->m_popped;
+    vector<HeapEntry> &poppedEntries = m_extras->m_poppedEntries;
+    int popped = poppedNodes.size() + poppedEntries.size();
+    if (m_structure == SKEW || m_structure == LEFTIST || m_structure == WBLEFTIST) {
+        //the popped nodes came out in order and no key left in the heap is better, so a path through their left
+        //children that ends in the heap is a heap (NPL 0, every right subtree empty); it is popped in the same order
+        Node *chain = m_heap;
+        int weight = (m_heap != nullptr) ? m_heap->m_weight : 0;
+        for (int i = popped - 1; i >= 0; i--) {
+            poppedNodes[i]->m_left = chain;
+            poppedNodes[i]->m_npl = 0;
+            poppedNodes[i]->m_weight = ++weight;
+            chain = poppedNodes[i];
+        }
+        m_heap = chain;
+    } else if (m_structure == BINOMIAL) {
+        //each popped node is a tree of degree 0, they are melded like the carries of a counter
+        Node *roots = nullptr;
+        for (int i = 0; i < popped; i++) {
+            poppedNodes[i]->m_npl = 0;
+            roots = mergeBINOMIAL(roots, poppedNodes[i]);
+        }
+        m_heap = mergeBINOMIAL(roots, m_heap);
+    } else if (m_structure == DARY) {
+        addEntries(poppedEntries);
+    } else {
+        //the last key goes back to where it was; entries in buckets above its highest bit that changed
+        //keep their bucket, the rest are distributed again together with the popped entries
+        vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+        vector<HeapEntry> entries;
+        int low = radixBucket(m_extras->m_beginLastKey);
+        for (int i = 0; i <= low && i < (int) buckets.size(); i++) {
+            entries.insert(entries.end(), buckets[i].begin(), buckets[i].end());
+            buckets[i].clear();
+        }
+        m_lastKey = m_extras->m_beginLastKey;
+        for (unsigned int i = 0; i < entries.size(); i++) {
+            insertRadix(entries[i]);
+        }
+        //the first one popped goes last, so it is at the back of bucket 0 if its key is the last key
+        for (int i = popped - 1; i >= 0; i--) {
+            insertRadix(poppedEntries[i]);
+        }
+    }
+
+    //the students are queued again
+    for (int i = 0; i < popped; i++) {
+        Student *student = poppedNodes.empty() ? poppedEntries[i].m_student : poppedNodes[i]->m_student;
+        if (m_indexed) {
+            m_extras->m_index.insert(student);
+        }
+        countStudent(*student, 1);
+    }
+    m_size += popped;
+    poppedNodes.clear();
+    poppedEntries.clear();
+    m_transaction = false;
+
+    if (m_journal != nullptr) {
+        m_journal->logOp(QueueJournal::OP_ROLLBACK);
+    }
+}
+
+bool RQueue::inTransaction() const {
+    return m_transaction;
+}
+
+void RQueue::checkTransaction() const {
+    if (m_transaction) {
+        throw domain_error("Queue has an open transaction");
+    }
+}
+
+void RQueue::releasePopped() {
+    if (m_extras == nullptr) {
+        return;
+    }
+    vector<Node *> &poppedNodes = m_extras->m_popped;
+    vector<HeapEntry> &poppedEntries = m_extras->m_poppedEntries;
+    for (unsigned int i = 0; i < poppedNodes.size(); i++) {
+        m_students->release(poppedNodes[i]->m_student);
+        m_nodes->release(poppedNodes[i]);
+    }
+    for (unsigned int i = 0; i < poppedEntries.size(); i++) {
+        m_students->release(poppedEntries[i].m_student);
+    }
+    RQ_COUNT(m_stats.m_deallocations += poppedNodes.size());
+    poppedNodes.clear();
+    poppedEntries.clear();
+}
+
+void RQueue::setStructure(STRUCTURE structure) {
+    checkTransaction();
+    thaw();
+    settle();
+    bool usedNodes = (m_structure == SKEW || m_structure == LEFTIST || m_structure == WBLEFTIST ||
+                      m_structure == BINOMIAL);
+    bool useNodes = (structure == SKEW || structure == LEFTIST || structure == WBLEFTIST || structure == BINOMIAL);
+
+    if (!usedNodes || !useNodes) {
+        //flatten the current heap into the unordered entry array
+        if (usedNodes) {
+            Node *oldNode = m_heap;
+            m_heap = nullptr;
+            moveNodesToArray(oldNode);
+        } else if (m_structure == RADIX) {
+            drainBuckets();
+        }
+
+        //then rebuild it in the new structure
+        m_structure = structure;
+        if (structure == DARY) {
+            heapify();
+        } else if (structure == RADIX) {
+            fillBuckets();
+        } else {
+            moveArrayToNodes();
+            rebuilt();
+        }
+    } else {
+        m_structure = structure;
+
+        Node *oldNode = m_heap;
+        m_heap = nullptr;
+        rebuildHeap(oldNode);
+        rebuilt();
+    }
+
+    if (m_journal != nullptr) {
+        m_journal->logValue(QueueJournal::OP_SET_STRUCTURE, structure);
+    }
+}
+
+void RQueue::rebuildHeap(Node *oldNode) {
+    if (oldNode != nullptr) {
+        //postorder traversal
+        rebuildHeap(oldNode->m_left);
+        rebuildHeap(oldNode->m_right);
+
+        //remove inserted nodes from old heap
+        oldNode->m_left = nullptr;
+        oldNode->m_right = nullptr;
+        oldNode->m_npl = 0;
+        oldNode->m_weight = 1;
+
+        //insert each node into new "heap"
+        insertPointer(oldNode, m_heap);
+    }
+}
+
+void RQueue::insertPointer(Node *oldNode, Node *newNode) {
+    m_heap = mergeNodes(oldNode, newNode);
+}
+
+STRUCTURE RQueue::getStructure() const {
+    return m_structure;
+}
+
+void RQueue::printStudentsQueue() const {
+    cout << "Contents of the queue: \n";
+
+    //print the contents of the queue using preorder traversal, a frozen queue in priority order
+    if (m_frozen) {
+        FrozenReader reader(m_extras->m_frozenData);
+        int64_t key;
+        Student student;
+        while (reader.next(key, student)) {
+            printStudent(student);
+        }
+    } else if (m_structure == DARY) {
+        preorderPrintArray(0);
+    } else if (m_structure == RADIX) {
+        //a radix heap has no tree, print bucket by bucket
+        const vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+        for (unsigned int i = 0; i < buckets.size(); i++) {
+            for (unsigned int j = 0; j < buckets[i].size(); j++) {
+                printStudent(*buckets[i][j].m_student);
+            }
+        }
+    } else {
+        preorderPrint(m_heap);
+    }
+}
+
+void RQueue::preorderPrint(Node *node) const {
+    //visit all nodes and print each student's details, dummies of lazy merges hold none;
+    //preorder with an explicit stack, see copyNodes
+    vector<Node *> stack(1, node);
+    while (!stack.empty()) {
+        Node *curr = stack.back();
+        stack.pop_back();
+        if (curr != nullptr) {
+            if (curr->m_student != nullptr) {
+                printStudent(*curr->m_student);
+            }
+            stack.push_back(curr->m_right);
+            stack.push_back(curr->m_left);
+        }
+    }
+}
+
+void RQueue::printStudent(const Student &student) const {
+    //withdrawn students are no longer part of the queue
+    if (m_indexed && m_extras->m_index.isWithdrawn(&student)) {
+        return;
+    }
+    cout << "[";
+    printPriority(student);
+    cout << "] Student name: " << student.m_name << ", Major: " << student.getMajorStr() << ", Gender: "
+         << student.getGenderStr() << ", Level: " << student.getLevelStr() << "\n";
+}
+
+void RQueue::printPriority(const Student &student) const {
+    //prints the priority as returned by the priority function (or the packed key of a spec)
+    if (m_useSpec) {
+        cout << m_extras->m_prioritySpec.key(student);
+    } else if (m_priorFunc64 != nullptr) {
+        cout << m_priorFunc64(student);
+    } else if (m_priorFuncReal != nullptr) {
+        cout << m_priorFuncReal(student);
+    } else {
+        cout << m_priorFunc(student);
+    }
+}
+
+void RQueue::dump() const {
+    if (m_size == 0) {
+        cout << "Empty heap.\n";
+    } else if (m_frozen) {
+        cout << "Frozen heap: " << m_size << " students in " << m_extras->m_frozenData.size() << " bytes\n";
+    } else if (m_structure == DARY) {
+        dumpArray(0);
+    } else if (m_structure == RADIX) {
+        dumpBuckets();
+    } else {
+        dump(m_heap);
+    }
+    cout << endl;
+}
+
+void RQueue::dump(Node *pos) const {
+    //inorder with an explicit stack, see copyNodes; the second field counts the parts of the node already printed
+    vector<pair<Node *, int> > stack;
+    if (pos != nullptr) {
+        stack.push_back(make_pair(pos, 0));
+    }
+    while (!stack.empty()) {
+        Node *node = stack.back().first;
+        int printed = stack.back().second++;
+        if (printed == 0) {
+            cout << "(";
+            if (node->m_left != nullptr) {
+                stack.push_back(make_pair(node->m_left, 0));
+            }
+        } else if (printed == 1) {
+            if (node->m_student == nullptr) {
+                //dummy node of a lazy merge
+                cout << "*";
+            } else {
+                printPriority(*node->m_student);
+                if (m_structure == SKEW)
+                    cout << ":" << node->m_student->m_name;
+                else if (m_structure == WBLEFTIST)
+                    cout << ":" << node->m_student->m_name << ":" << node->m_weight;
+                else
+                    cout << ":" << node->m_student->m_name << ":" << node->m_npl;
+            }
+            if (node->m_right != nullptr) {
+                stack.push_back(make_pair(node->m_right, 0));
+            }
+        } else {
+            cout << ")";
+            stack.pop_back();
+        }
+    }
+}
+
+int RQueue::getArity() const {
+    return m_arity;
+}
+
+void RQueue::setArity(int arity) {
+    checkTransaction();
+    thaw();
+    if (arity < 2) {
+        throw out_of_range("Arity must be at least 2");
+    }
+    m_arity = arity;
+
+    //the parent/child index arithmetic changed, so the array must be rebuilt
+    if (m_structure == DARY) {
+        heapify();
+    }
+
+    if (m_journal != nullptr) {
+        m_journal->logValue(QueueJournal::OP_SET_ARITY, arity);
+    }
+}
+
+int64_t RQueue::rankKey(const Student &student) {
+    RQ_COUNT(m_stats.m_priorityCalls++);
+    int64_t priority;
+    if (m_useSpec) {
+        priority = m_extras->m_prioritySpec.key(student);
+    } else if (m_priorFunc64 != nullptr) {
+        priority = m_priorFunc64(student);
+    } else if (m_priorFuncReal != nullptr) {
+        priority = realKey(m_priorFuncReal(student));
+    } else {
+        priority = m_priorFunc(student);
+    }
+
+    //smaller keys are served first, so MAXHEAP priorities are inverted (~ cannot overflow, unlike negation)
+    return (m_heapType == MAXHEAP) ? ~priority : priority;
+}
+
+int64_t RQueue::realKey(double value) {
+    //all NaNs compare equal and above +infinity
+    if (value != value) {
+        value = numeric_limits<double>::quiet_NaN();
+    }
+
+    //IEEE total order: positive doubles already order like their bits, negative ones need the magnitude flipped
+    int64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits < 0) ? (bits ^ INT64_MAX) : bits;
+}
+
+Student *RQueue::storeStudent(const Student &student) {
+    Student *stored = m_students->allocate();
+    *stored = student;
+    return stored;
+}
+
+Student RQueue::releaseStudent(Student *stored) {
+    Student student = *stored;
+
+    //recycle the student, its payload is overwritten when it is reused
+    m_students->release(stored);
+    return student;
+}
+
+Student *RQueue::insertEntry(const Student &student) {
+    HeapEntry entry;
+    entry.m_key = agedKey(student, m_epoch);
+    entry.m_student = storeStudent(student);
+    m_entries.push_back(entry);
+    siftUp(m_entries.size() - 1);
+    return entry.m_student;
+}
+
+void RQueue::siftUp(int pos) {
+    HeapEntry entry = m_entries[pos];
+
+    //move parents down until the entry's position is found
+    while (pos > 0) {
+        int parent = (pos - 1) / m_arity;
+        RQ_COUNT(m_stats.m_comparisons++);
+        if (m_entries[parent].m_key <= entry.m_key) {
+            break;
+        }
+        m_entries[pos] = m_entries[parent];
+        pos = parent;
+    }
+    m_entries[pos] = entry;
+}
+
+void RQueue::siftDown(int pos) {
+    int size = m_entries.size();
+    HeapEntry entry = m_entries[pos];
+
+    while (true) {
+        //the children of pos are contiguous, so picking the best one touches at most one or two cache lines
+        int first = pos * m_arity + 1;
+        if (first >= size) {
+            break;
+        }
+        int last = min(first + m_arity, size);
+        int best = first;
+        for (int child = first + 1; child < last; child++) {
+            if (m_entries[child].m_key < m_entries[best].m_key) {
+                best = child;
+            }
+        }
+        RQ_COUNT(m_stats.m_comparisons += last - first);
+        if (m_entries[best].m_key >= entry.m_key) {
+            break;
+        }
+        m_entries[pos] = m_entries[best];
+        pos = best;
+    }
+    m_entries[pos] = entry;
+}
+
+void RQueue::heapify() {
+    //Floyd's method: sift down every internal node, from the last one up to the root
+    if (m_entries.size() < 2) {
+        return;
+    }
+    for (int pos = ((int) m_entries.size() - 2) / m_arity; pos >= 0; pos--) {
+        siftDown(pos);
+    }
+}
+
+void RQueue::mergeDARY(RQueue &rhs) {
+    //append the entries of rhs, the cached keys are still valid and mergeWithQueue takes over the students
+    addEntries(rhs.m_entries);
+    rhs.m_entries.clear();
+}
+
+void RQueue::addEntries(const vector<HeapEntry> &entries) {
+    int oldSize = m_entries.size();
+    m_entries.insert(m_entries.end(), entries.begin(), entries.end());
+
+    //a few new entries are cheaper to sift up, otherwise rebuild the whole array in linear time
+    int added = m_entries.size() - oldSize;
+    if (added * log2(m_entries.size()) < m_entries.size()) {
+        for (int pos = oldSize; pos < (int) m_entries.size(); pos++) {
+            siftUp(pos);
+        }
+    } else {
+        heapify();
+    }
+}
+
+void RQueue::insertBatch(vector<HeapEntry> &entries) {
+    //the batch is bulk-built on its own in linear time, then melded in with a single merge
+    m_size += entries.size();
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        countStudent(*entries[i].m_student, 1);
+    }
+    if (m_structure == DARY) {
+        addEntries(entries);
+        entries.clear();
+    } else {
+        settle();
+        Node *oldHeap = m_heap;
+        m_entries.swap(entries);
+        moveArrayToNodes();
+        m_heap = mergeNodes(oldHeap, m_heap);
+        m_entries.swap(entries);
+    }
+}
+
+void RQueue::moveNodesToArray(Node *node) {
+    if (node != nullptr) {
+        //postorder traversal, so each node can be released once its children are moved
+        moveNodesToArray(node->m_left);
+        moveNodesToArray(node->m_right);
+
+        //the entry takes over the student, only the node is released
+        HeapEntry entry;
+        entry.m_key = node->m_key;
+        entry.m_student = node->m_student;
+        m_entries.push_back(entry);
+
+        m_nodes->release(node);
+        RQ_COUNT(m_stats.m_deallocations++);
+    }
+}
+
+void RQueue::moveArrayToNodes() {
+    //allocate a node for every stored student, each one is a single-node heap
+    vector<Node *> heaps;
+    for (unsigned int i = 0; i < m_entries.size(); i++) {
+        Node *node = m_nodes->allocate();
+        node->m_key = m_entries[i].m_key;
+        node->m_left = nullptr;
+        node->m_right = nullptr;
+        node->m_student = m_entries[i].m_student;
+        node->m_npl = 0;
+        node->m_weight = 1;
+        RQ_COUNT(m_stats.m_allocations++; m_stats.m_bytesAllocated += sizeof(Node));
+        heaps.push_back(node);
+    }
+
+    //heaps of size 2^r cost O(r) to merge, so the whole build is linear instead of n inserts of O(log n)
+    m_heap = meldAll(heaps);
+
+    m_entries.clear();
+}
+
+Node *RQueue::meldAll(vector<Node *> &heaps) {
+    //merge the heaps pairwise, round by round
+    while (heaps.size() > 1) {
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i + 1 < heaps.size(); i += 2) {
+            heaps[kept++] = mergeNodes(heaps[i], heaps[i + 1]);
+        }
+        if (heaps.size() % 2 == 1) {
+            heaps[kept++] = heaps.back();
+        }
+        heaps.resize(kept);
+    }
+    return heaps.empty() ? nullptr : heaps[0];
+}
+
+void RQueue::preorderPrintArray(int pos) const {
+    if (pos < (int) m_entries.size()) {
+        //visit the entry, then each of its children from left to right
+        printStudent(*m_entries[pos].m_student);
+        for (int child = pos * m_arity + 1; child <= pos * m_arity + m_arity; child++) {
+            preorderPrintArray(child);
+        }
+    }
+}
+
+void RQueue::dumpArray(int pos) const {
+    if (pos < (int) m_entries.size()) {
+        //the first half of the children is printed before the entry, so d = 2 matches the binary dump
+        int first = pos * m_arity + 1;
+        int middle = first + m_arity / 2;
+        cout << "(";
+        for (int child = first; child < middle; child++) {
+            dumpArray(child);
+        }
+        const Student &student = *m_entries[pos].m_student;
+        printPriority(student);
+        cout << ":" << student.m_name;
+        for (int child = middle; child < first + m_arity; child++) {
+            dumpArray(child);
+        }
+        cout << ")";
+    }
+}
+
+int RQueue::radixBucket(int64_t key) const {
+    //the bucket is the position of the highest bit in which the key differs from the last extracted key
+    uint64_t diff = (uint64_t) key ^ (uint64_t) m_lastKey;
+    if (diff == 0) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(diff);
+}
+
+void RQueue::insertRadix(const HeapEntry &entry) {
+    vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+    if (buckets.empty()) {
+        buckets.resize(RADIX_BUCKETS);
+    }
+    buckets[radixBucket(entry.m_key)].push_back(entry);
+}
+
+HeapEntry RQueue::extractRadix() {
+    settleRadix();
+    HeapEntry top = m_extras->m_buckets[0].back();
+    m_extras->m_buckets[0].pop_back();
+    return top;
+}
+
+void RQueue::settleRadix() {
+    vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+    if (buckets[0].empty()) {
+        //find the first non-empty bucket, all its keys share the bits above the bucket index
+        int bucket = 1;
+        while (buckets[bucket].empty()) {
+            bucket++;
+        }
+
+        //its smallest key becomes the new last key
+        vector<HeapEntry> entries;
+        entries.swap(buckets[bucket]);
+        m_lastKey = entries[0].m_key;
+        for (unsigned int i = 1; i < entries.size(); i++) {
+            RQ_COUNT(m_stats.m_comparisons++);
+            if (entries[i].m_key < m_lastKey) {
+                m_lastKey = entries[i].m_key;
+            }
+        }
+
+        //redistribute, every entry moves to a strictly smaller bucket
+        for (unsigned int i = 0; i < entries.size(); i++) {
+            buckets[radixBucket(entries[i].m_key)].push_back(entries[i]);
+        }
+    }
+}
+
+void RQueue::mergeRADIX(RQueue &rhs) {
+    //check the whole queue first, so a failed merge leaves both queues unchanged
+    vector<vector<HeapEntry> > &buckets = rhs.m_extras->m_buckets;
+    for (unsigned int i = 0; i < buckets.size(); i++) {
+        for (unsigned int j = 0; j < buckets[i].size(); j++) {
+            if (buckets[i][j].m_key < m_lastKey) {
+                throw domain_error("Radix heap requires monotone priorities: merged queue is ahead of host queue");
+            }
+        }
+    }
+
+    //move the entries of rhs into the host buckets (their students are adopted by mergeWithQueue)
+    for (unsigned int i = 0; i < buckets.size(); i++) {
+        for (unsigned int j = 0; j < buckets[i].size(); j++) {
+            insertRadix(buckets[i][j]);
+        }
+    }
+
+    buckets.clear();
+    rhs.m_lastKey = INT64_MIN;
+}
+
+void RQueue::fillBuckets() {
+    //nothing has been extracted yet, so the monotone sequence restarts from the lowest possible key
+    m_lastKey = INT64_MIN;
+    extras().m_buckets.clear();
+    for (unsigned int i = 0; i < m_entries.size(); i++) {
+        insertRadix(m_entries[i]);
+    }
+    m_entries.clear();
+}
+
+void RQueue::drainBuckets() {
+    //move every bucket entry back into the unordered entry array
+    vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+    m_entries.clear();
+    for (unsigned int i = 0; i < buckets.size(); i++) {
+        m_entries.insert(m_entries.end(), buckets[i].begin(), buckets[i].end());
+    }
+    buckets.clear();
+    m_lastKey = INT64_MIN;
+}
+
+void RQueue::dumpBuckets() const {
+    //one group per non-empty bucket: {bucket| priority:name ...}
+    const vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+    for (unsigned int i = 0; i < buckets.size(); i++) {
+        if (!buckets[i].empty()) {
+            cout << "{" << i << "|";
+            for (unsigned int j = 0; j < buckets[i].size(); j++) {
+                const Student &student = *buckets[i][j].m_student;
+                cout << " ";
+                printPriority(student);
+                cout << ":" << student.m_name;
+            }
+            cout << "}";
+        }
+    }
+}
+
+StudentIndex::StudentIndex() : m_slots(), m_count(0), m_withdrawn(0) {}
+
+bool StudentIndex::insert(Student *student, bool withdrawn) {
+    //keep the table at most half full so probe sequences stay short
+    if (2 * (m_count + 1) > (int) m_slots.size()) {
+        grow();
+    }
+    size_t hash = std::hash<string>()(student->m_name);
+    if (!withdrawn && findSlot(student->m_name, hash) >= 0) {
+        return false;
+    }
+
+    size_t mask = m_slots.size() - 1;
+    size_t pos = hash & mask;
+    while (m_slots[pos].m_student != nullptr) {
+        pos = (pos + 1) & mask;
+    }
+    m_slots[pos].m_student = student;
+    m_slots[pos].m_hash = hash;
+    m_slots[pos].m_withdrawn = withdrawn;
+    m_count++;
+    if (withdrawn) {
+        m_withdrawn++;
+    }
+    return true;
+}
+
+Student *StudentIndex::find(const string &name) const {
+    int pos = findSlot(name, std::hash<string>()(name));
+    return (pos < 0) ? nullptr : m_slots[pos].m_student;
+}
+
+bool StudentIndex::withdraw(const string &name) {
+    int pos = findSlot(name, std::hash<string>()(name));
+    if (pos < 0) {
+        return false;
+    }
+    m_slots[pos].m_withdrawn = true;
+    m_withdrawn++;
+    return true;
+}
+
+bool StudentIndex::isWithdrawn(const Student *student) const {
+    //nothing to look up while no student is withdrawn, which keeps extraction cheap
+    if (m_withdrawn == 0) {
+        return false;
+    }
+    int pos = slotOf(student);
+    return pos >= 0 && m_slots[pos].m_withdrawn;
+}
+
+void StudentIndex::remove(const Student *student) {
+    int pos = slotOf(student);
+    if (pos < 0) {
+        return;
+    }
+    if (m_slots[pos].m_withdrawn) {
+        m_withdrawn--;
+    }
+    m_count--;
+
+    //backward-shift deletion: move later entries of the probe sequence into the hole
+    size_t mask = m_slots.size() - 1;
+    size_t hole = pos;
+    size_t next = pos;
+    while (true) {
+        next = (next + 1) & mask;
+        if (m_slots[next].m_student == nullptr) {
+            break;
+        }
+        //an entry stays if its home slot lies cyclically in (hole, next]
+        size_t home = m_slots[next].m_hash & mask;
+        bool stays = (hole < next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            m_slots[hole] = m_slots[next];
+            hole = next;
+        }
+    }
+    m_slots[hole].m_student = nullptr;
+    m_slots[hole].m_withdrawn = false;
+}
+
+void StudentIndex::clear() {
+    m_slots.clear();
+    m_count = 0;
+    m_withdrawn = 0;
+}
+
+int StudentIndex::findSlot(const string &name, size_t hash) const {
+    if (m_slots.empty()) {
+        return -1;
+    }
+    size_t mask = m_slots.size() - 1;
+    for (size_t pos = hash & mask; m_slots[pos].m_student != nullptr; pos = (pos + 1) & mask) {
+        const Slot &slot = m_slots[pos];
+        if (slot.m_hash == hash && !slot.m_withdrawn && slot.m_student->m_name == name) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+int StudentIndex::slotOf(const Student *student) const {
+    if (m_slots.empty()) {
+        return -1;
+    }
+    size_t mask = m_slots.size() - 1;
+    for (size_t pos = std::hash<string>()(student->m_name) & mask; m_slots[pos].m_student != nullptr;
+         pos = (pos + 1) & mask) {
+        if (m_slots[pos].m_student == student) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+void StudentIndex::grow() {
+    //double the table and reinsert every entry at its new home slot
+    vector<Slot> oldSlots(max((size_t) 16, 2 * m_slots.size()));
+    oldSlots.swap(m_slots);
+    size_t mask = m_slots.size() - 1;
+    for (unsigned int i = 0; i < oldSlots.size(); i++) {
+        if (oldSlots[i].m_student != nullptr) {
+            size_t pos = oldSlots[i].m_hash & mask;
+            while (m_slots[pos].m_student != nullptr) {
+                pos = (pos + 1) & mask;
+            }
+            m_slots[pos] = oldSlots[i];
+        }
+    }
+}
+
+static const char *ATTRIBUTE_NAMES[NUM_ATTRIBUTES] = {"level", "major", "group", "race", "gender", "income",
+                                                      "highschool"};
+
+PrioritySpec::PrioritySpec() : m_text(""), m_base(0), m_coeff() {
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        m_coeff[i] = 0;
+    }
+}
+
+PrioritySpec::PrioritySpec(const string &spec) : m_text(""), m_base(0), m_coeff() {
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        m_coeff[i] = 0;
+    }
+    parse(spec);
+}
+
+int64_t PrioritySpec::key(const Student &student) const {
+    //the whole spec is linear in the attributes, so the packed key is one weighted sum
+    //unsigned arithmetic, partial sums may wrap but the final key is always in range
+    uint64_t result = (uint64_t) m_base;
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        if (m_coeff[i] != 0) {
+            //out of range attributes are clamped so they cannot spill into another criterion
+            int value = student.getAttribute((ATTRIBUTE) i);
+            value = max(0, min(value, ATTRIBUTE_MAX[i]));
+            result += (uint64_t) m_coeff[i] * (uint64_t) value;
+        }
+    }
+    return (int64_t) result;
+}
+
+string PrioritySpec::toString() const {
+    return m_text;
+}
+
+bool PrioritySpec::operator==(const PrioritySpec &rhs) const {
+    return m_text == rhs.m_text;
+}
+
+bool PrioritySpec::operator!=(const PrioritySpec &rhs) const {
+    return !(*this == rhs);
+}
+
+void PrioritySpec::parse(const string &spec) {
+    //split the spec into words, numbers and the symbols + - * ,
+    vector<string> tokens;
+    for (unsigned int i = 0; i < spec.size();) {
+        char c = spec[i];
+        if (isspace((unsigned char) c)) {
+            i++;
+        } else if (isalpha((unsigned char) c) || isdigit((unsigned char) c)) {
+            string token = "";
+            while (i < spec.size() && (isalnum((unsigned char) spec[i]) || spec[i] == '_')) {
+                token += (char) tolower((unsigned char) spec[i]);
+                i++;
+            }
+            tokens.push_back(token);
+        } else if (c == '+' || c == '-' || c == '*' || c == ',') {
+            tokens.push_back(string(1, c));
+            i++;
+        } else {
+            throw invalid_argument("Unexpected character '" + string(1, c) + "' in priority spec");
+        }
+    }
+    if (tokens.empty()) {
+        throw invalid_argument("Priority spec is empty");
+    }
+
+    //parse each criterion into per-attribute weights and a direction
+    vector<vector<int64_t> > weights;
+    vector<bool> descending;
+    unsigned int pos = 0;
+    while (pos <= tokens.size()) {
+        vector<int64_t> criterion(NUM_ATTRIBUTES, 0);
+        bool desc = false;
+        bool expectTerm = true;
+        bool signSeen = false;
+        int64_t sign = 1;
+        while (pos < tokens.size() && tokens[pos] != ",") {
+            string token = tokens[pos++];
+            if (token == "+" || token == "-") {
+                if (signSeen) {
+                    throw invalid_argument("Misplaced '" + token + "' in priority spec");
+                }
+                sign = (token == "-") ? -1 : 1;
+                expectTerm = true;
+                signSeen = true;
+                continue;
+            }
+            if (!expectTerm) {
+                //only a direction may follow a complete term
+                if ((token == "asc" || token == "desc") && (pos == tokens.size() || tokens[pos] == ",")) {
+                    desc = (token == "desc");
+                    continue;
+                }
+                throw invalid_argument("Unexpected '" + token + "' in priority spec");
+            }
+
+            //a term is "attribute", "weight*attribute" or "attribute*weight"
+            int64_t weight = 1;
+            if (isdigit((unsigned char) token[0])) {
+                if (pos + 1 >= tokens.size() || tokens[pos] != "*" || token.size() > 6) {
+                    throw invalid_argument("Bad weight '" + token + "' in priority spec");
+                }
+                weight = stoll(token);
+                pos++;
+                token = tokens[pos++];
+            }
+            int attribute = 0;
+            while (attribute < NUM_ATTRIBUTES && token != ATTRIBUTE_NAMES[attribute]) {
+                attribute++;
+            }
+            if (attribute == NUM_ATTRIBUTES) {
+                throw invalid_argument("Unknown attribute '" + token + "' in priority spec");
+            }
+            if (pos + 1 < tokens.size() && tokens[pos] == "*" && isdigit((unsigned char) tokens[pos + 1][0])) {
+                if (tokens[pos + 1].size() > 6) {
+                    throw invalid_argument("Bad weight '" + tokens[pos + 1] + "' in priority spec");
+                }
+                weight *= stoll(tokens[pos + 1]);
+                pos += 2;
+            }
+            criterion[attribute] += sign * weight;
+            expectTerm = false;
+            signSeen = false;
+        }
+        if (expectTerm) {
+            throw invalid_argument("Missing attribute in priority spec");
+        }
+        weights.push_back(criterion);
+        descending.push_back(desc);
+        pos++;
+    }
+
+    //each criterion gets a bit field wide enough for its range, the first criterion is the most significant
+    vector<int> bits(weights.size(), 0);
+    vector<int64_t> lowest(weights.size(), 0);
+    vector<int64_t> highest(weights.size(), 0);
+    int totalBits = 0;
+    for (unsigned int c = 0; c < weights.size(); c++) {
+        for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+            lowest[c] += min((int64_t) 0, weights[c][i] * ATTRIBUTE_MAX[i]);
+            highest[c] += max((int64_t) 0, weights[c][i] * ATTRIBUTE_MAX[i]);
+        }
+        while (((int64_t) 1 << bits[c]) <= highest[c] - lowest[c]) {
+            bits[c]++;
+        }
+        totalBits += bits[c];
+    }
+    if (totalBits > 63) {
+        throw invalid_argument("Priority spec needs more than 63 bits");
+    }
+
+    //fold every field into the base and the per-attribute coefficients
+    int shift = totalBits;
+    m_text = "";
+    for (unsigned int c = 0; c < weights.size(); c++) {
+        shift -= bits[c];
+        int64_t unit = (int64_t) 1 << shift;
+        m_base += (descending[c] ? highest[c] : -lowest[c]) * unit;
+        for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+            m_coeff[i] += (descending[c] ? -weights[c][i] : weights[c][i]) * unit;
+        }
+
+        //normalized text: terms in attribute order, explicit direction
+        string criterion = "";
+        for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+            int64_t weight = weights[c][i];
+            if (weight != 0) {
+                if (criterion.empty()) {
+                    criterion += (weight < 0) ? "-" : "";
+                } else {
+                    criterion += (weight < 0) ? " - " : " + ";
+                }
+                if (weight != 1 && weight != -1) {
+                    criterion += to_string(weight < 0 ? -weight : weight) + "*";
+                }
+                criterion += ATTRIBUTE_NAMES[i];
+            }
+        }
+        m_text += (c > 0 ? ", " : "") + criterion + (descending[c] ? " desc" : " asc");
+    }
+}
+
+RQueueStats RQueue::stats() const {
+#ifdef RQUEUE_STATS
+    RQueueStats result = m_stats;
+    result.m_countersEnabled = true;
+#else
+    RQueueStats result;
+#endif
+
+    //walk the heap to measure its shape
+    long long depthSum = 0;
+    result.m_nodeCount = 0;
+    result.m_maxDepth = 0;
+    result.m_nplCounts.clear();
+    if (m_structure == DARY) {
+        //the d-ary heap is complete, so its shape follows from the size; every sift walks one root path
+        long long levelStart = 0;
+        long long levelWidth = 1;
+        int depth = 0;
+        while (levelStart < (long long) m_entries.size()) {
+            long long levelEnd = min(levelStart + levelWidth, (long long) m_entries.size());
+            depthSum += (levelEnd - levelStart) * depth;
+            result.m_maxDepth = depth;
+            levelStart = levelEnd;
+            levelWidth *= m_arity;
+            depth++;
+        }
+        result.m_nodeCount = m_entries.size();
+        result.m_avgDepth = (result.m_nodeCount > 0) ? (double) depthSum / result.m_nodeCount : 0.0;
+        result.m_rightSpine = depth;
+        return result;
+    } else if (m_structure == RADIX) {
+        //flat buckets, no tree shape to report
+        result.m_nodeCount = m_size;
+        return result;
+    }
+    collectShape(m_heap, result, depthSum);
+    result.m_avgDepth = (result.m_nodeCount > 0) ? (double) depthSum / result.m_nodeCount : 0.0;
+
+    //the right spine is the path every merge walks down
+    result.m_rightSpine = 0;
+    for (Node *curr = m_heap; curr != nullptr; curr = curr->m_right) {
+        result.m_rightSpine++;
+    }
+    return result;
+}
+
+void RQueue::collectShape(Node *node, RQueueStats &result, long long &depthSum) const {
+    //postorder with an explicit stack, see copyNodes; the NPL of a node is computed from its children
+    //(skew heaps do not store it), npls holds the NPL of every finished subtree whose parent is still open
+    struct Visit {
+        Node *m_node;
+        int m_depth;
+        bool m_expanded; // the children have been pushed
+    };
+    vector<Visit> stack;
+    vector<int> npls;
+    if (node != nullptr) {
+        stack.push_back({node, 0, false});
+    }
+    while (!stack.empty()) {
+        Visit &visit = stack.back();
+        Node *curr = visit.m_node;
+        int depth = visit.m_depth;
+        if (!visit.m_expanded) {
+            visit.m_expanded = true;
+            if (curr->m_right != nullptr) {
+                stack.push_back({curr->m_right, depth + 1, false});
+            }
+            if (curr->m_left != nullptr) {
+                stack.push_back({curr->m_left, depth + 1, false});
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        //a missing child has NPL -1
+        int rightNPL = -1;
+        int leftNPL = -1;
+        if (curr->m_right != nullptr) {
+            rightNPL = npls.back();
+            npls.pop_back();
+        }
+        if (curr->m_left != nullptr) {
+            leftNPL = npls.back();
+            npls.pop_back();
+        }
+        int npl = min(leftNPL, rightNPL) + 1;
+        npls.push_back(npl);
+
+        result.m_nodeCount++;
+        depthSum += depth;
+        if (depth > result.m_maxDepth) {
+            result.m_maxDepth = depth;
+        }
+        if ((int) result.m_nplCounts.size() <= npl) {
+            result.m_nplCounts.resize(npl + 1, 0);
+        }
+        result.m_nplCounts[npl]++;
+    }
+}
+
+void RQueue::resetStats() {
+#ifdef RQUEUE_STATS
+    m_stats = RQueueStats();
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() : m_count(0), m_max(0) {
+    for (int i = 0; i < BUCKETS; i++) {
+        m_buckets[i] = 0;
+    }
+}
+
+void LatencyHistogram::record(long long nanos) {
+    //find the power-of-two bucket of the sample
+    int bucket = 0;
+    while (bucket < BUCKETS - 1 && (nanos >> (bucket + 1)) > 0) {
+        bucket++;
+    }
+    m_buckets[bucket]++;
+    m_count++;
+    if (nanos > m_max) {
+        m_max = nanos;
+    }
+}
+
+long long LatencyHistogram::percentile(double p) const {
+    if (m_count == 0) {
+        return 0;
+    }
+
+    //walk the buckets until p percent of the samples are covered
+    long long target = (long long) (p / 100.0 * m_count);
+    long long seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += m_buckets[i];
+        if (seen > target) {
+            return min(((2LL << i) - 1), m_max);
+        }
+    }
+    return m_max;
+}
+
+RQueueStats::RQueueStats() :
+        m_nodeCount(0), m_maxDepth(0), m_avgDepth(0.0), m_rightSpine(0), m_nplCounts(),
+        m_countersEnabled(false), m_insert(), m_extract(), m_merge(), m_comparisons(0), m_priorityCalls(0),
+        m_maxMergeDepth(0), m_allocations(0), m_deallocations(0), m_bytesAllocated(0) {}
+
+QueueCounts::QueueCounts() {
+    memset(m_priorities, 0, sizeof(m_priorities));
+    memset(m_attributes, 0, sizeof(m_attributes));
+}
+
+void QueueCounts::add(const QueueCounts &rhs) {
+    for (int i = 0; i < PRIORITIES; i++) {
+        m_priorities[i] += rhs.m_priorities[i];
+    }
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        for (int j = 0; j < VALUES; j++) {
+            m_attributes[i][j] += rhs.m_attributes[i][j];
+        }
+    }
+}
+
+QueueExtras::QueueExtras() :
+        m_prioritySpec(), m_buckets(), m_index(), m_frozenData(), m_counted(false), m_counts(), m_popped(),
+        m_poppedEntries(), m_beginLastKey(INT64_MIN) {}
+
+static void dumpOpJSON(ostream &sout, const char *name, const OpStats &op) {
+    sout << "  \"" << name << "\": {\"calls\": " << op.m_calls
+         << ", \"comparisons\": " << op.m_comparisons
+         << ", \"comparisonsPerCall\": " << (op.m_calls > 0 ? (double) op.m_comparisons / op.m_calls : 0.0)
+         << ", \"latencyNs\": {\"p50\": " << op.m_latency.percentile(50)
+         << ", \"p90\": " << op.m_latency.percentile(90)
+         << ", \"p99\": " << op.m_latency.percentile(99)
+         << ", \"max\": " << op.m_latency.getMax() << "}},\n";
+}
+
+void RQueueStats::dumpJSON(ostream &sout) const {
+    sout << "{\n";
+    sout << "  \"nodeCount\": " << m_nodeCount << ",\n";
+    sout << "  \"maxDepth\": " << m_maxDepth << ",\n";
+    sout << "  \"avgDepth\": " << m_avgDepth << ",\n";
+    sout << "  \"rightSpine\": " << m_rightSpine << ",\n";
+    sout << "  \"nplHistogram\": [";
+    for (unsigned int i = 0; i < m_nplCounts.size(); i++) {
+        sout << (i > 0 ? ", " : "") << m_nplCounts[i];
+    }
+    sout << "],\n";
+    sout << "  \"countersEnabled\": " << (m_countersEnabled ? "true" : "false") << ",\n";
+    dumpOpJSON(sout, "insertStudent", m_insert);
+    dumpOpJSON(sout, "getNextStudent", m_extract);
+    dumpOpJSON(sout, "mergeWithQueue", m_merge);
+    sout << "  \"comparisons\": " << m_comparisons << ",\n";
+    sout << "  \"priorityCalls\": " << m_priorityCalls << ",\n";
+    sout << "  \"maxMergeDepth\": " << m_maxMergeDepth << ",\n";
+    sout << "  \"allocations\": " << m_allocations << ",\n";
+    sout << "  \"deallocations\": " << m_deallocations << ",\n";
+    sout << "  \"bytesAllocated\": " << m_bytesAllocated << "\n";
+    sout << "}\n";
+}
+
+ostream &operator<<(ostream &sout, const Student &student) {
+    sout << "Student name: " << student.m_name
+         << ", Major: " << student.getMajorStr()
+         << ", Gender: " << student.getGenderStr()
+         << ", Level: " << student.getLevelStr();
+    return sout;
+}
+
+ostream &operator<<(ostream &sout, const Node &node) {
+    sout << *node.m_student;
+    return sout;
+}
+
+QuotaQueue::QuotaQueue(RQueue &queue, ATTRIBUTE attribute) :
+        m_attribute(attribute), m_classes(), m_quotas(), m_topKeys(), m_tops(), m_seats(-1), m_taken(0),
+        m_reserving(false) {
+    //the students of an open transaction still belong to it
+    queue.checkTransaction();
+    if (attribute < ATTR_LEVEL || attribute >= NUM_ATTRIBUTES) {
+        throw out_of_range("Unknown attribute");
+    }
+
+    //a frozen queue keeps its students in its buffer, withdrawn students are not part of the queue any more
+    queue.thaw();
+    queue.purgeWithdrawn();
+    vector<HeapEntry> entries;
+    queue.collectEntries(entries);
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        classOf(*entries[i].m_student);
+    }
+
+    //one empty sub-queue per attribute value, ordered exactly like queue
+    int numClasses = ATTRIBUTE_MAX[attribute] + 1;
+    ClassQuota noQuota = {-1, 0, 0};
+    m_quotas.assign(numClasses, noQuota);
+    m_topKeys.assign(numClasses, 0);
+    for (int i = 0; i < numClasses; i++) {
+        RQueue *subQueue = new RQueue();
+        subQueue->initializeLike(queue);
+        subQueue->m_lastKey = queue.m_lastKey;
+        m_classes.push_back(subQueue);
+    }
+
+    //the cached keys move along, so aging offsets and radix order are kept
+    for (unsigned int i = 0; i < entries.size(); i++) {
+        m_classes[classOf(*entries[i].m_student)]->insertKeyed(*entries[i].m_student, entries[i].m_key);
+    }
+    queue.clear();
+    rebuildTops();
+}
+
+QuotaQueue::~QuotaQueue() {
+    for (unsigned int i = 0; i < m_classes.size(); i++) {
+        delete m_classes[i];
+    }
+}
+
+void QuotaQueue::setQuota(int value, int maxSeats, int minSeats) {
+    checkClass(value);
+    if (maxSeats < -1 || minSeats < 0 || (maxSeats != -1 && minSeats > maxSeats)) {
+        throw out_of_range("Invalid quota");
+    }
+    m_quotas[value].m_maxSeats = maxSeats;
+    m_quotas[value].m_minSeats = minSeats;
+    rebuildTops();
+}
+
+void QuotaQueue::setSeats(int seats) {
+    if (seats < -1) {
+        throw out_of_range("Invalid number of seats");
+    }
+    m_seats = seats;
+    rebuildTops();
+}
+
+void QuotaQueue::insertStudent(const Student &student) {
+    int value = classOf(student);
+    m_classes[value]->insertStudent(student);
+
+    //the class may have become admissible, or its best student may have changed
+    rebuildTops();
+}
+
+Student QuotaQueue::getNextStudent() {
+    if (m_tops.empty()) {
+        throw out_of_range("No student can be admitted within the quotas");
+    }
+
+    //take the class with the best student off the tops heap
+    auto before = [this](int lhs, int rhs) { return topsBefore(lhs, rhs); };
+    pop_heap(m_tops.begin(), m_tops.end(), before);
+    int value = m_tops.back();
+    m_tops.pop_back();
+
+    Student student = m_classes[value]->getNextStudent();
+    m_quotas[value].m_taken++;
+    m_taken++;
+
+    if ((m_seats != -1 && m_taken == m_seats) || mustReserve() != m_reserving) {
+        //the set of admissible classes changed as a whole
+        rebuildTops();
+    } else if (admissible(value)) {
+        //otherwise only this class moves, or stays off the heap if it reached its quota
+        m_topKeys[value] = m_classes[value]->topKey();
+        m_tops.push_back(value);
+        push_heap(m_tops.begin(), m_tops.end(), before);
+    }
+    return student;
+}
+
+int QuotaQueue::numStudents() const {
+    int count = 0;
+    for (unsigned int i = 0; i < m_classes.size(); i++) {
+        count += m_classes[i]->numStudents();
+    }
+    return count;
+}
+
+int QuotaQueue::seatsTaken(int value) const {
+    checkClass(value);
+    return m_quotas[value].m_taken;
+}
+
+void QuotaQueue::releaseInto(RQueue &queue) {
+    for (unsigned int i = 0; i < m_classes.size(); i++) {
+        queue.mergeWithQueue(*m_classes[i]);
+    }
+    m_tops.clear();
+}
+
+int QuotaQueue::classOf(const Student &student) const {
+    int value = student.getAttribute(m_attribute);
+    checkClass(value);
+    return value;
+}
+
+void QuotaQueue::checkClass(int value) const {
+    if (value < 0 || value > ATTRIBUTE_MAX[m_attribute]) {
+        throw out_of_range("Attribute value has no class");
+    }
+}
+
+bool QuotaQueue::admissible(int value) const {
+    const ClassQuota &quota = m_quotas[value];
+    if (m_classes[value]->numStudents() == 0 || (m_seats != -1 && m_taken >= m_seats) ||
+        (quota.m_maxSeats != -1 && quota.m_taken >= quota.m_maxSeats)) {
+        return false;
+    }
+    //while reserving, the remaining seats go to classes below their minimum share
+    return !m_reserving || quota.m_taken < quota.m_minSeats;
+}
+
+bool QuotaQueue::mustReserve() const {
+    //reserve once the seats still owed to minimum shares (as far as students are left) fill the rest
+    if (m_seats == -1) {
+        return false;
+    }
+    int owed = 0;
+    for (unsigned int i = 0; i < m_quotas.size(); i++) {
+        int missing = m_quotas[i].m_minSeats - m_quotas[i].m_taken;
+        if (missing > 0) {
+            owed += min(missing, m_classes[i]->numStudents());
+        }
+    }
+    return owed > 0 && owed >= m_seats - m_taken;
+}
+
+void QuotaQueue::rebuildTops() {
+    m_reserving = mustReserve();
+    m_tops.clear();
+    for (unsigned int i = 0; i < m_classes.size(); i++) {
+        if (admissible(i)) {
+            m_topKeys[i] = m_classes[i]->topKey();
+            m_tops.push_back(i);
+        }
+    }
+    make_heap(m_tops.begin(), m_tops.end(), [this](int lhs, int rhs) { return topsBefore(lhs, rhs); });
+}
+
+bool QuotaQueue::topsBefore(int lhs, int rhs) const {
+    //smaller keys are served first, ties go to the lower attribute value
+    if (m_topKeys[lhs] != m_topKeys[rhs]) {
+        return m_topKeys[lhs] > m_topKeys[rhs];
+    }
+    return lhs > rhs;
+}
+
+//numbers the external queues of this process, so that their run files never collide
+static std::atomic<long> externalQueueCount(0);
+
+ExternalQueue::ExternalQueue(RQueue &queue, int memoryBudget, const string &directory, int blockSize) :
+        m_heap(), m_runs(), m_heads(), m_directory(directory), m_filePrefix(), m_heapCapacity(0), m_maxRuns(0),
+        m_blockSize(blockSize), m_spilled(0), m_nextRun(0), m_lastKey(queue.m_lastKey) {
+    //the heap must be set up before anything can throw, its destructor runs either way
+    m_heap.initializeLike(queue);
+    queue.checkTransaction();
+    if (memoryBudget < 4 || blockSize < 1) {
+        throw invalid_argument("Memory budget must hold at least 4 students and a block at least 1");
+    }
+    m_filePrefix = "rqueue-" + to_string(getpid()) + "-" + to_string(externalQueueCount++) + "-";
+
+    //half of the budget for the insertion heap, the rest for the read buffers of at least two runs
+    m_heapCapacity = memoryBudget / 2;
+    int bufferBudget = memoryBudget - m_heapCapacity;
+    m_blockSize = min(m_blockSize, bufferBudget / 2);
+    m_maxRuns = bufferBudget / m_blockSize;
+
+    m_heap.m_lastKey = queue.m_lastKey;
+    queue.thaw();
+    queue.purgeWithdrawn();
+    if (queue.m_size >= m_heapCapacity) {
+        //too large to keep, the queue itself sorts it into the first run
+        writeRun(queue);
+    } else {
+        //the cached keys move along, so aging offsets and radix order are kept
+        vector<HeapEntry> entries;
+        queue.collectEntries(entries);
+        for (unsigned int i = 0; i < entries.size(); i++) {
+            m_heap.insertKeyed(*entries[i].m_student, entries[i].m_key);
+        }
+    }
+    queue.clear();
+}
+
+ExternalQueue::~ExternalQueue() {
+    while (!m_runs.empty()) {
+        closeRun(m_runs.back());
+    }
+}
+
+void ExternalQueue::insertStudent(const Student &student) {
+    if (m_heap.m_structure == RADIX && m_heap.agedKey(student, m_heap.m_epoch) < m_lastKey) {
+        //the insertion heap only knows the students it served itself
+        throw domain_error("Radix heap requires monotone priorities: student is ahead of the last one served");
+    }
+    m_heap.insertStudent(student);
+    if (m_heap.m_size >= m_heapCapacity) {
+        //the radix heap is drained up to its largest key, but the queue has not served those students yet
+        int64_t lastKey = m_heap.m_lastKey;
+        writeRun(m_heap);
+        m_heap.m_lastKey = lastKey;
+    }
+}
+
+Student ExternalQueue::getNextStudent() {
+    if (numStudents() == 0) {
+        throw out_of_range("Queue is empty");
+    }
+
+    //runs win ties, their students were inserted earlier
+    Run *best = m_heads.empty() ? nullptr : m_heads.front();
+    if (best == nullptr || (m_heap.m_size > 0 && m_heap.topKey() < best->m_buffer[best->m_next].m_key)) {
+        m_lastKey = m_heap.topKey();
+        return m_heap.getNextStudent();
+    }
+
+    auto before = [this](const Run *lhs, const Run *rhs) { return headsBefore(lhs, rhs); };
+    pop_heap(m_heads.begin(), m_heads.end(), before);
+    Run *run = m_heads.back();
+    m_heads.pop_back();
+    RunRecord &record = run->m_buffer[run->m_next++];
+    Student student = record.m_student;
+    m_lastKey = record.m_key;
+    m_spilled--;
+
+    //the run goes back with its next record, or is removed once it is exhausted
+    if (run->m_next < (int) run->m_buffer.size() || fillBuffer(run)) {
+        m_heads.push_back(run);
+        push_heap(m_heads.begin(), m_heads.end(), before);
+    } else {
+        closeRun(run);
+    }
+    return student;
+}
+
+long long ExternalQueue::numStudents() const {
+    return m_heap.m_size + m_spilled;
+}
+
+int ExternalQueue::numRuns() const {
+    return m_runs.size();
+}
+
+long long ExternalQueue::spilledStudents() const {
+    return m_spilled;
+}
+
+void ExternalQueue::advanceEpoch(int64_t ticks) {
+    m_heap.advanceEpoch(ticks);
+}
+
+void ExternalQueue::writeRun(RQueue &source) {
+    //make room for the read buffer of the new run
+    if ((int) m_runs.size() >= m_maxRuns) {
+        mergeRuns();
+    }
+
+    int id = m_nextRun++;
+    string path = runPath(id);
+    long long count = source.m_size;
+    {
+        ofstream out(path.c_str(), ios::binary | ios::trunc);
+        checkStream(out, path);
+        while (source.m_size > 0) {
+            //the source serves its students in order, so the run comes out sorted
+            int64_t key = source.topKey();
+            Student *student = source.extractTop();
+            writeRecord(out, key, *student);
+            source.countStudent(*student, -1);
+            source.m_students->release(student);
+        }
+        out.flush();
+        checkStream(out, path);
+    }
+    m_spilled += count;
+    openRun(path, id, count);
+}
+
+void ExternalQueue::mergeRuns() {
+    int id = m_nextRun++;
+    string path = runPath(id);
+    long long count = m_spilled;
+    {
+        ofstream out(path.c_str(), ios::binary | ios::trunc);
+        checkStream(out, path);
+        auto before = [this](const Run *lhs, const Run *rhs) { return headsBefore(lhs, rhs); };
+        while (!m_heads.empty()) {
+            pop_heap(m_heads.begin(), m_heads.end(), before);
+            Run *run = m_heads.back();
+            m_heads.pop_back();
+            RunRecord &record = run->m_buffer[run->m_next++];
+            writeRecord(out, record.m_key, record.m_student);
+            if (run->m_next < (int) run->m_buffer.size() || fillBuffer(run)) {
+                m_heads.push_back(run);
+                push_heap(m_heads.begin(), m_heads.end(), before);
+            } else {
+                closeRun(run);
+            }
+        }
+        out.flush();
+        checkStream(out, path);
+    }
+    openRun(path, id, count);
+}
+
+void ExternalQueue::openRun(const string &path, int id, long long count) {
+    Run *run = new Run();
+    run->m_id = id;
+    run->m_path = path;
+    run->m_unread = count;
+    m_runs.push_back(run);
+    run->m_file.open(path.c_str(), ios::binary);
+    checkStream(run->m_file, path);
+    if (fillBuffer(run)) {
+        m_heads.push_back(run);
+        push_heap(m_heads.begin(), m_heads.end(),
+                  [this](const Run *lhs, const Run *rhs) { return headsBefore(lhs, rhs); });
+    } else {
+        closeRun(run);
+    }
+}
+
+void ExternalQueue::closeRun(Run *run) {
+    run->m_file.close();
+    remove(run->m_path.c_str());
+    m_runs.erase(std::find(m_runs.begin(), m_runs.end(), run));
+    delete run;
+}
+
+bool ExternalQueue::fillBuffer(Run *run) {
+    long long count = min((long long) m_blockSize, run->m_unread);
+    run->m_buffer.resize(count);
+    run->m_next = 0;
+    for (long long i = 0; i < count; i++) {
+        if (!readRecord(run->m_file, run->m_buffer[i])) {
+            throw runtime_error("Cannot read run file " + run->m_path);
+        }
+    }
+    run->m_unread -= count;
+    return count > 0;
+}
+
+string ExternalQueue::runPath(int id) const {
+    return m_directory + "/" + m_filePrefix + to_string(id) + ".run";
+}
+
+void ExternalQueue::checkStream(const ios &stream, const string &path) const {
+    if (!stream) {
+        throw runtime_error("Cannot access run file " + path);
+    }
+}
+
+bool ExternalQueue::headsBefore(const Run *lhs, const Run *rhs) const {
+    //smaller keys are served first, ties go to the older run
+    int64_t lhsKey = lhs->m_buffer[lhs->m_next].m_key;
+    int64_t rhsKey = rhs->m_buffer[rhs->m_next].m_key;
+    if (lhsKey != rhsKey) {
+        return lhsKey > rhsKey;
+    }
+    return lhs->m_id > rhs->m_id;
+}
+
+void ExternalQueue::writeRecord(ostream &out, int64_t key, const Student &student) {
+    putValue(out, key);
+    putStudent(out, student);
+}
+
+bool ExternalQueue::readRecord(istream &in, RunRecord &record) {
+    record.m_key = getValue<int64_t>(in);
+    record.m_student = getStudent(in);
+    return (bool) in;
+}
+
+void RQueue::writeConfig(ostream &out, const QueueJournal &journal) const {
+    putValue<int8_t>(out, m_heapType);
+    putValue<int8_t>(out, m_structure);
+    putValue<int32_t>(out, m_arity);
+    putValue<int64_t>(out, m_agingRate);
+    putValue<int64_t>(out, m_epoch);
+    putValue<int8_t>(out, m_indexed);
+    putValue<int8_t>(out, m_lazyMerge);
+
+    //functions are written by the name they are registered under
+    if (m_useSpec) {
+        putValue<int8_t>(out, QueueJournal::FN_SPEC);
+        putString(out, m_extras->m_prioritySpec.toString());
+    } else if (m_priorFuncReal != nullptr) {
+        putValue<int8_t>(out, QueueJournal::FN_REAL);
+        putString(out, journal.nameOf(m_priorFuncReal));
+    } else if (m_priorFunc64 != nullptr) {
+        putValue<int8_t>(out, QueueJournal::FN_INT64);
+        putString(out, journal.nameOf(m_priorFunc64));
+    } else {
+        putValue<int8_t>(out, QueueJournal::FN_INT);
+        putString(out, journal.nameOf(m_priorFunc));
+    }
+}
+
+void RQueue::readConfig(istream &in, const QueueJournal &journal) {
+    int heapType = getValue<int8_t>(in);
+    int structure = getValue<int8_t>(in);
+    int arity = getValue<int32_t>(in);
+    int64_t agingRate = getValue<int64_t>(in);
+    int64_t epoch = getValue<int64_t>(in);
+    bool indexed = getValue<int8_t>(in) != 0;
+    bool lazyMerge = getValue<int8_t>(in) != 0;
+    int kind = getValue<int8_t>(in);
+    string name = getString(in);
+    if (!in || heapType < MINHEAP || heapType > MAXHEAP || structure < SKEW || structure > BINOMIAL || arity < 2 ||
+        agingRate < 0 || kind < QueueJournal::FN_INT || kind > QueueJournal::FN_SPEC) {
+        throw runtime_error("Malformed queue configuration");
+    }
+
+    m_priorFunc = nullptr;
+    m_priorFunc64 = nullptr;
+    m_priorFuncReal = nullptr;
+    m_useSpec = (kind == QueueJournal::FN_SPEC);
+    if (kind == QueueJournal::FN_SPEC) {
+        extras().m_prioritySpec = PrioritySpec(name);
+    } else if (kind == QueueJournal::FN_REAL) {
+        m_priorFuncReal = journal.named(name).m_priFnReal;
+    } else if (kind == QueueJournal::FN_INT64) {
+        m_priorFunc64 = journal.named(name).m_priFn64;
+    } else {
+        m_priorFunc = journal.named(name).m_priFn;
+    }
+    if (m_priorFunc == nullptr && m_priorFunc64 == nullptr && m_priorFuncReal == nullptr && !m_useSpec) {
+        throw runtime_error("Priority function " + name + " is registered with another type");
+    }
+    m_heapType = (HEAPTYPE) heapType;
+    m_structure = (STRUCTURE) structure;
+    m_arity = arity;
+    m_agingRate = agingRate;
+    m_epoch = epoch;
+    m_indexed = indexed;
+    m_lazyMerge = lazyMerge;
+    if (m_structure == RADIX || m_indexed) {
+        extras();
+    }
+}
+
+void RQueue::writeBody(ostream &out) const {
+    //the exact shape is kept, so replaying operations on top of it picks the same students
+    putValue<int64_t>(out, m_lastKey);
+    putValue<int32_t>(out, m_size);
+    putValue<int8_t>(out, m_frozen);
+    if (m_frozen) {
+        const string &data = m_extras->m_frozenData;
+        putValue<int64_t>(out, data.size());
+        out.write(data.data(), data.size());
+    } else if (m_structure == DARY) {
+        for (unsigned int i = 0; i < m_entries.size(); i++) {
+            writeEntry(out, m_entries[i]);
+        }
+    } else if (m_structure == RADIX) {
+        const vector<vector<HeapEntry> > &buckets = m_extras->m_buckets;
+        putValue<int32_t>(out, buckets.size());
+        for (unsigned int i = 0; i < buckets.size(); i++) {
+            putValue<int32_t>(out, buckets[i].size());
+            for (unsigned int j = 0; j < buckets[i].size(); j++) {
+                writeEntry(out, buckets[i][j]);
+            }
+        }
+    } else {
+        writeNodes(out, m_heap);
+    }
+}
+
+void RQueue::readBody(istream &in) {
+    m_lastKey = getValue<int64_t>(in);
+    int size = getValue<int32_t>(in);
+    bool frozen = getValue<int8_t>(in) != 0;
+    if (!in || size < 0) {
+        throw runtime_error("Malformed queue contents");
+    }
+    if (frozen) {
+        //the buffer must hold exactly size students
+        int64_t bytes = getValue<int64_t>(in);
+        if (!in || bytes < 0 || bytes > (int64_t) size * (int64_t) (MAX_VARINT * (NUM_ATTRIBUTES + 3) + (1 << 24))) {
+            throw runtime_error("Malformed queue contents");
+        }
+        string &data = extras().m_frozenData;
+        data.resize(bytes);
+        in.read(&data[0], bytes);
+        FrozenReader reader(data);
+        int64_t key;
+        Student student;
+        int count = 0;
+        while (reader.next(key, student)) {
+            count++;
+        }
+        if (count != size || !reader.atEnd()) {
+            throw runtime_error("Malformed queue contents");
+        }
+        m_frozen = true;
+    } else if (m_structure == DARY) {
+        for (int i = 0; i < size && in; i++) {
+            m_entries.push_back(readEntry(in));
+        }
+    } else if (m_structure == RADIX) {
+        int buckets = getValue<int32_t>(in);
+        if (!in || buckets < 0 || buckets > RADIX_BUCKETS) {
+            throw runtime_error("Malformed queue contents");
+        }
+        m_extras->m_buckets.resize(buckets);
+        for (int i = 0; i < buckets && in; i++) {
+            int count = getValue<int32_t>(in);
+            for (int j = 0; j < count && in; j++) {
+                m_extras->m_buckets[i].push_back(readEntry(in));
+            }
+        }
+    } else if (size > 0) {
+        m_heap = readNodes(in);
+    }
+    m_size = size;
+    if (!in) {
+        throw runtime_error("Malformed queue contents");
+    }
+    recount();
+}
+
+void RQueue::writeNodes(ostream &out, Node *node) const {
+    //preorder, each node says which children follow it and whether it is a dummy without an entry;
+    //walked with an explicit stack, see copyNodes
+    vector<Node *> stack(1, node);
+    while (!stack.empty()) {
+        Node *curr = stack.back();
+        stack.pop_back();
+        if (curr == nullptr) {
+            continue;
+        }
+        putValue<int8_t>(out, (curr->m_left != nullptr ? 1 : 0) | (curr->m_right != nullptr ? 2 : 0) |
+                              (curr->m_student == nullptr ? 4 : 0));
+        putValue<int32_t>(out, curr->m_npl);
+        putValue<int32_t>(out, curr->m_weight);
+        if (curr->m_student != nullptr) {
+            HeapEntry entry;
+            entry.m_key = curr->m_key;
+            entry.m_student = curr->m_student;
+            writeEntry(out, entry);
+        }
+        stack.push_back(curr->m_right);
+        stack.push_back(curr->m_left);
+    }
+}
+
+Node *RQueue::readNodes(istream &in) {
+    //the links still to be filled, in the preorder the nodes were written in
+    Node *root = nullptr;
+    vector<Node **> stack(1, &root);
+    while (!stack.empty()) {
+        Node **link = stack.back();
+        stack.pop_back();
+        int children = getValue<int8_t>(in);
+        int npl = getValue<int32_t>(in);
+        int weight = getValue<int32_t>(in);
+        HeapEntry entry;
+        entry.m_key = INT64_MIN;
+        entry.m_student = nullptr;
+        if (children & 4) {
+            m_dummies++;
+        } else {
+            entry = readEntry(in);
+        }
+        if (!in) {
+            throw runtime_error("Malformed queue contents");
+        }
+        Node *node = m_nodes->allocate();
+        node->m_key = entry.m_key;
+        node->m_student = entry.m_student;
+        node->m_npl = npl;
+        node->m_weight = weight;
+        node->m_left = nullptr;
+        node->m_right = nullptr;
+        *link = node;
+        if (children & 2) {
+            stack.push_back(&node->m_right);
+        }
+        if (children & 1) {
+            stack.push_back(&node->m_left);
+        }
+        RQ_COUNT(m_stats.m_allocations++; m_stats.m_bytesAllocated += sizeof(Node) + sizeof(Student));
+    }
+    return root;
+}
+
+void RQueue::writeEntry(ostream &out, const HeapEntry &entry) const {
+    putValue<int64_t>(out, entry.m_key);
+    putValue<int8_t>(out, m_indexed && m_extras->m_index.isWithdrawn(entry.m_student));
+    putStudent(out, *entry.m_student);
+}
+
+HeapEntry RQueue::readEntry(istream &in) {
+    HeapEntry entry;
+    entry.m_key = getValue<int64_t>(in);
+    bool withdrawn = getValue<int8_t>(in) != 0;
+    entry.m_student = storeStudent(getStudent(in));
+    if (m_indexed) {
+        m_extras->m_index.insert(entry.m_student, withdrawn);
+    }
+    return entry;
+}
+
+//the writer frames each batch by its size and checksum, so a batch torn by a crash is recognized;
+//inside the batches, every record starts with its size
+static const int BATCH_HEADER = 2 * sizeof(uint32_t);
+//in the ring, a record that is already encoded follows its tag and its size
+static const int RING_HEADER = 1 + sizeof(uint64_t);
+static const char JOURNAL_MAGIC[4] = {'R', 'Q', 'J', '1'};
+static const char SNAPSHOT_MAGIC[4] = {'R', 'Q', 'S', '1'};
+
+QueueJournal::QueueJournal(const string &path, const string &snapshotPath, int commitMs) :
+        m_path(path), m_snapshotPath(snapshotPath), m_commitMs(commitMs), m_queue(nullptr), m_functions(), m_fd(-1),
+        m_sequence(0), m_scratch(), m_ring(), m_head(0), m_tail(0), m_tailSeen(0), m_mutex(), m_wake(), m_synced(),
+        m_syncedBytes(0), m_failed(false), m_stop(false), m_flushRequested(false), m_writer() {
+    if (commitMs < 1) {
+        throw invalid_argument("Commit interval must be at least 1 ms");
+    }
+}
+
+QueueJournal::~QueueJournal() {
+    detach();
+}
+
+void QueueJournal::registerPriorityFn(const string &name, prifn_t priFn) {
+    NamedFn named = {name, priFn, nullptr, nullptr};
+    for (unsigned int i = 0; i < m_functions.size(); i++) {
+        if (m_functions[i].m_name == name) {
+            throw invalid_argument("Priority function name is already registered");
+        }
+    }
+    m_functions.push_back(named);
+}
+
+void QueueJournal::registerPriorityFn(const string &name, prifn64_t priFn) {
+    NamedFn named = {name, nullptr, priFn, nullptr};
+    for (unsigned int i = 0; i < m_functions.size(); i++) {
+        if (m_functions[i].m_name == name) {
+            throw invalid_argument("Priority function name is already registered");
+        }
+    }
+    m_functions.push_back(named);
+}
+
+void QueueJournal::registerPriorityFn(const string &name, prifnreal_t priFn) {
+    NamedFn named = {name, nullptr, nullptr, priFn};
+    for (unsigned int i = 0; i < m_functions.size(); i++) {
+        if (m_functions[i].m_name == name) {
+            throw invalid_argument("Priority function name is already registered");
+        }
+    }
+    m_functions.push_back(named);
+}
+
+long long QueueJournal::recover(RQueue &queue) {
+    //nothing that happens during recovery is journaled again
+    if (queue.m_journal != nullptr) {
+        queue.m_journal->detach();
+    }
+    detach();
+
+    long long replayed = replay(queue, readSnapshot(queue));
+    if (queue.inTransaction()) {
+        //the crash came before the commit
+        queue.rollback();
+    }
+
+    //the recovered state becomes the new snapshot
+    attach(queue);
+    return replayed;
+}
+
+void QueueJournal::attach(RQueue &queue) {
+    if (queue.m_journal != nullptr && queue.m_journal != this) {
+        throw domain_error("Queue is already journaled");
+    }
+    detach();
+
+    //throws for unregistered functions before the journal is touched
+    writeSnapshot(queue, m_sequence);
+    startJournal(m_sequence);
+    if (m_ring.empty()) {
+        m_ring.resize(RING_BYTES + RAW_RECORD_BYTES);
+    }
+    m_queue = &queue;
+    queue.m_journal = this;
+    m_writer = thread(&QueueJournal::writerLoop, this);
+}
+
+void QueueJournal::detach() {
+    if (m_queue == nullptr) {
+        return;
+    }
+    stopWriter();
+    close(m_fd);
+    m_fd = -1;
+    m_queue->m_journal = nullptr;
+    m_queue = nullptr;
+}
+
+void QueueJournal::checkpoint() {
+    if (m_queue == nullptr) {
+        throw domain_error("No queue is attached to the journal");
+    }
+    flush();
+
+    //the snapshot replaces the journal; a crash in between leaves both, and recovery skips what the snapshot holds.
+    //The writer has nothing left to write, so it does not touch the file meanwhile
+    writeSnapshot(*m_queue, m_sequence);
+    startJournal(m_sequence);
+}
+
+void QueueJournal::flush() {
+    if (m_queue != nullptr) {
+        requestCommit(m_head.load(memory_order_relaxed));
+    }
+}
+
+long long QueueJournal::getSequence() const {
+    return m_sequence;
+}
+
+void QueueJournal::logOp(OPCODE op) {
+    char *record = reserve(1);
+    if (record != nullptr) {
+        *record = (char) op;
+        publish(1);
+    } else {
+        char tag = (char) op;
+        append(&tag, 1);
+        m_sequence++;
+    }
+}
+
+void QueueJournal::logValue(OPCODE op, int64_t value) {
+    ByteSink out(beginRecord(op, MAX_VARINT));
+    putVarint(out, value);
+    endRecord(out.position());
+}
+
+void QueueJournal::logText(OPCODE op, const string &text) {
+    ByteSink out(beginRecord(op, MAX_VARINT + text.size()));
+    putString(out, text);
+    endRecord(out.position());
+}
+
+void QueueJournal::logInsert(const Student &student) {
+    //the hot path: the student is copied into the ring as it is, the writer encodes it
+    RawInsert insert;
+    insert.m_fields[ATTR_LEVEL] = student.m_level;
+    insert.m_fields[ATTR_MAJOR] = student.m_major;
+    insert.m_fields[ATTR_GROUP] = student.m_group;
+    insert.m_fields[ATTR_RACE] = student.m_race;
+    insert.m_fields[ATTR_GENDER] = student.m_gender;
+    insert.m_fields[ATTR_INCOME] = student.m_income;
+    insert.m_fields[ATTR_HIGHSCHOOL] = student.m_highschool;
+    insert.m_nameSize = student.m_name.size();
+    size_t size = 1 + sizeof(insert) + insert.m_nameSize;
+    if (size > (size_t) RAW_RECORD_BYTES) {
+        //a name too long for a raw record
+        ByteSink out(beginRecord(OP_INSERT, studentBytes(student)));
+        putStudent(out, student);
+        endRecord(out.position());
+        return;
+    }
+    char *record = reserve(size);
+    if (record != nullptr) {
+        record[0] = (char) OP_INSERT;
+        memcpy(record + 1, &insert, sizeof(insert));
+        memcpy(record + 1 + sizeof(insert), student.m_name.data(), insert.m_nameSize);
+        publish(size);
+    } else {
+        //the record wraps around the end of the ring, or has to wait for room
+        char tag = (char) OP_INSERT;
+        append(&tag, 1);
+        append(reinterpret_cast<const char *>(&insert), sizeof(insert));
+        append(student.m_name.data(), insert.m_nameSize);
+        m_sequence++;
+    }
+}
+
+void QueueJournal::logPriorityFn(FNKIND kind, const string &name, HEAPTYPE heapType) {
+    ByteSink out(beginRecord(OP_SET_FN, 2 + MAX_VARINT + name.size()));
+    putValue<int8_t>(out, kind);
+    putString(out, name);
+    putValue<int8_t>(out, heapType);
+    endRecord(out.position());
+}
+
+void QueueJournal::logQueue(OPCODE op, const string &encoded) {
+    //too large to go through the scratch space
+    char header[RING_HEADER + MAX_VARINT + 1];
+    ByteSink out(header + RING_HEADER);
+    putVarint(out, encoded.size() + 1);
+    putValue<int8_t>(out, op);
+    header[0] = (char) RING_ENCODED;
+    uint64_t size = out.position() - (header + RING_HEADER) + encoded.size();
+    memcpy(header + 1, &size, sizeof(size));
+    append(header, out.position() - header);
+    append(encoded.data(), encoded.size());
+    m_sequence++;
+}
+
+char *QueueJournal::beginRecord(OPCODE op, size_t maxPayload) {
+    //room for the ring header and the size in front of the record, which are only known at the end
+    if (m_scratch.size() < RING_HEADER + MAX_VARINT + 1 + maxPayload) {
+        m_scratch.resize(RING_HEADER + MAX_VARINT + 1 + maxPayload);
+    }
+    m_scratch[RING_HEADER + MAX_VARINT] = (char) op;
+    return &m_scratch[RING_HEADER + MAX_VARINT + 1];
+}
+
+void QueueJournal::endRecord(char *end) {
+    char *record = &m_scratch[RING_HEADER + MAX_VARINT];
+    char size[MAX_VARINT];
+    ByteSink out(size);
+    putVarint(out, end - record);
+    size_t sizeBytes = out.position() - size;
+    memcpy(record - sizeBytes, size, sizeBytes);
+
+    char *header = record - sizeBytes - RING_HEADER;
+    header[0] = (char) RING_ENCODED;
+    uint64_t encodedSize = end - record + sizeBytes;
+    memcpy(header + 1, &encodedSize, sizeof(encodedSize));
+    append(header, end - header);
+    m_sequence++;
+}
+
+char *QueueJournal::reserve(size_t size) {
+    //contiguous room at the head, so a short record is copied in one piece and published once
+    uint64_t head = m_head.load(memory_order_relaxed);
+    size_t offset = head & (RING_BYTES - 1);
+    if (RING_BYTES - offset < size) {
+        return nullptr;
+    }
+    if (RING_BYTES - (head - m_tailSeen) < size) {
+        m_tailSeen = m_tail.load(memory_order_acquire);
+        if (RING_BYTES - (head - m_tailSeen) < size) {
+            return nullptr;
+        }
+    }
+    return &m_ring[offset];
+}
+
+void QueueJournal::publish(size_t size) {
+    m_head.store(m_head.load(memory_order_relaxed) + size, memory_order_release);
+    m_sequence++;
+}
+
+void QueueJournal::append(const char *data, size_t size) {
+    //the hot path: copy into the ring and publish the new head, the writer picks it up at its next commit
+    while (size > 0) {
+        uint64_t head = m_head.load(memory_order_relaxed);
+        uint64_t room = RING_BYTES - (head - m_tailSeen);
+        if (room < size) {
+            m_tailSeen = m_tail.load(memory_order_acquire);
+            room = RING_BYTES - (head - m_tailSeen);
+            if (room == 0) {
+                waitForRoom();
+                continue;
+            }
+        }
+        size_t offset = head & (RING_BYTES - 1);
+        size_t chunk = min(size, (size_t) min(room, (uint64_t) (RING_BYTES - offset)));
+        memcpy(&m_ring[offset], data, chunk);
+        data += chunk;
+        size -= chunk;
+        m_head.store(head + chunk, memory_order_release);
+    }
+}
+
+void QueueJournal::waitForRoom() {
+    //the ring is full, commit now instead of at the end of the interval
+    requestCommit(m_tailSeen + 1);
+    m_tailSeen = m_tail.load(memory_order_acquire);
+}
+
+void QueueJournal::requestCommit(uint64_t position) {
+    unique_lock<mutex> lock(m_mutex);
+    m_flushRequested = true;
+    m_wake.notify_one();
+    m_synced.wait(lock, [this, position] { return m_syncedBytes >= position || m_failed; });
+    if (m_failed) {
+        throw runtime_error("Cannot write journal " + m_path);
+    }
+}
+
+string QueueJournal::nameOf(prifn_t priFn) const {
+    for (unsigned int i = 0; i < m_functions.size(); i++) {
+        if (priFn != nullptr && m_functions[i].m_priFn == priFn) {
+            return m_functions[i].m_name;
+        }
+    }
+    throw invalid_argument("Priority function is not registered with the journal");
+}
+
+string QueueJournal::nameOf(prifn64_t priFn) const {
+    for (unsigned int i = 0; i < m_functions.size(); i++) {
+        if (priFn != nullptr && m_functions[i].m_priFn64 == priFn) {
+            return m_functions[i].m_name;
+        }
+    }
+    throw invalid_argument("Priority function is not registered with the journal");
+}
+
+string QueueJournal::nameOf(prifnreal_t priFn) const {
+    for (unsigned int i = 0; i < m_functions.size(); i++) {
+        if (priFn != nullptr && m_functions[i].m_priFnReal == priFn) {
+            return m_functions[i].m_name;
+        }
+    }
+    throw invalid_argument("Priority function is not registered with the journal");
+}
+
+const QueueJournal::NamedFn &QueueJournal::named(const string &name) const {
+    for (unsigned int i = 0; i < m_functions.size(); i++) {
+        if (m_functions[i].m_name == name) {
+            return m_functions[i];
+        }
+    }
+    throw runtime_error("Priority function " + name + " is not registered with the journal");
+}
+
+void QueueJournal::writeSnapshot(const RQueue &queue, long long sequence) {
+    //written next to the old snapshot and renamed over it, so a crash leaves one or the other;
+    //the students popped by an open transaction are in neither the heap nor the snapshot
+    queue.checkTransaction();
+    ostringstream config;
+    queue.writeConfig(config, *this);
+    string temp = m_snapshotPath + ".tmp";
+    {
+        ofstream out(temp.c_str(), ios::binary | ios::trunc);
+        out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        putValue<int64_t>(out, sequence);
+        out << config.str();
+        queue.writeBody(out);
+        out.flush();
+        if (!out) {
+            throw runtime_error("Cannot write snapshot " + temp);
+        }
+    }
+    string directory = (m_snapshotPath.find('/') == string::npos) ? "." :
+                       m_snapshotPath.substr(0, m_snapshotPath.find_last_of('/') + 1);
+    if (!syncPath(temp) || rename(temp.c_str(), m_snapshotPath.c_str()) != 0 || !syncPath(directory)) {
+        throw runtime_error("Cannot write snapshot " + m_snapshotPath);
+    }
+}
+
+long long QueueJournal::readSnapshot(RQueue &queue) {
+    //returns the sequence the snapshot was taken at, or -1 if there is none
+    ifstream in(m_snapshotPath.c_str(), ios::binary);
+    if (!in.is_open()) {
+        return -1;
+    }
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    in.read(magic, sizeof(magic));
+    long long sequence = getValue<int64_t>(in);
+    if (!in || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 || sequence < 0) {
+        throw runtime_error("Malformed snapshot " + m_snapshotPath);
+    }
+    queue.clear();
+    queue.readConfig(in, *this);
+    queue.readBody(in);
+    return sequence;
+}
+
+long long QueueJournal::replay(RQueue &queue, long long snapshotSequence) {
+    m_sequence = max(snapshotSequence, 0LL);
+    ifstream in(m_path.c_str(), ios::binary);
+    char magic[sizeof(JOURNAL_MAGIC)];
+    in.read(magic, sizeof(magic));
+    long long sequence = getValue<int64_t>(in);
+    if (!in) {
+        //no journal, or it was torn while it was started
+        return 0;
+    }
+    if (memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0 || sequence > max(snapshotSequence, 0LL)) {
+        throw runtime_error("Journal " + m_path + " does not continue the snapshot");
+    }
+
+    //the intact batches, up to the first torn one
+    string records;
+    string batch;
+    while (true) {
+        uint32_t size = getValue<uint32_t>(in);
+        uint32_t sum = getValue<uint32_t>(in);
+        if (!in || size > (uint32_t) RING_BYTES) {
+            break;
+        }
+        batch.resize(size);
+        in.read(&batch[0], size);
+        if (!in || checksum(batch.data(), size) != sum) {
+            break;
+        }
+        records += batch;
+    }
+
+    //records the snapshot already holds are skipped, a record cut off by the crash ends the journal
+    istringstream recordsIn(records);
+    long long replayed = 0;
+    string record;
+    while (recordsIn.peek() != EOF) {
+        uint64_t size = getVarint(recordsIn);
+        if (!recordsIn || size == 0 || size > records.size()) {
+            break;
+        }
+        record.resize(size);
+        recordsIn.read(&record[0], size);
+        if (!recordsIn) {
+            break;
+        }
+        sequence++;
+        if (sequence > snapshotSequence) {
+            istringstream recordIn(record);
+            apply(queue, recordIn);
+            replayed++;
+        }
+    }
+    m_sequence = max(m_sequence, sequence);
+    return replayed;
+}
+
+void QueueJournal::apply(RQueue &queue, istream &in) {
+    int op = getValue<int8_t>(in);
+    switch (op) {
+        case OP_INSERT: queue.insertStudent(getStudent(in)); break;
+        case OP_EXTRACT: queue.getNextStudent(); break;
+        case OP_MERGE: {
+            //the merged queue had the configuration of the host
+            RQueue rhs;
+            rhs.initializeLike(queue);
+            rhs.readBody(in);
+            queue.mergeWithQueue(rhs);
+            break;
+        }
+        case OP_ASSIGN:
+            queue.clear();
+            queue.readConfig(in, *this);
+            queue.readBody(in);
+            break;
+        case OP_CLEAR: queue.clear(); break;
+        case OP_SET_FN: {
+            int kind = getValue<int8_t>(in);
+            const NamedFn &named = this->named(getString(in));
+            HEAPTYPE heapType = (HEAPTYPE) getValue<int8_t>(in);
+            if (kind == FN_REAL && named.m_priFnReal != nullptr) {
+                queue.setPriorityFn(named.m_priFnReal, heapType);
+            } else if (kind == FN_INT64 && named.m_priFn64 != nullptr) {
+                queue.setPriorityFn(named.m_priFn64, heapType);
+            } else if (kind == FN_INT && named.m_priFn != nullptr) {
+                queue.setPriorityFn(named.m_priFn, heapType);
+            } else {
+                throw runtime_error("Priority function " + named.m_name + " is registered with another type");
+            }
+            break;
+        }
+        case OP_SET_SPEC: queue.setPrioritySpec(PrioritySpec(getString(in))); break;
+        case OP_SET_STRUCTURE: queue.setStructure((STRUCTURE) getVarint(in)); break;
+        case OP_SET_ARITY: queue.setArity(getVarint(in)); break;
+        case OP_SET_INDEXED: queue.setIndexed(getVarint(in) != 0); break;
+        case OP_ERASE: queue.erase(getString(in)); break;
+        case OP_SET_AGING: queue.setAgingRate(getVarint(in)); break;
+        case OP_ADVANCE_EPOCH: queue.advanceEpoch(getVarint(in)); break;
+        case OP_SET_LAZY: queue.setLazyMerge(getVarint(in) != 0); break;
+        case OP_FREEZE: queue.freeze(); break;
+        case OP_BEGIN: queue.begin(); break;
+        case OP_POP: queue.popTentative(); break;
+        case OP_COMMIT: queue.commit(); break;
+        case OP_ROLLBACK: queue.rollback(); break;
+        case OP_PEEK: queue.peekNextStudent(); break;
+        default: throw runtime_error("Malformed journal record");
+    }
+    if (!in) {
+        throw runtime_error("Malformed journal record");
+    }
+}
+
+void QueueJournal::startJournal(long long sequence) {
+    if (m_fd < 0) {
+        m_fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }
+    if (m_fd < 0 || ftruncate(m_fd, 0) != 0) {
+        throw runtime_error("Cannot open journal " + m_path);
+    }
+    char header[sizeof(JOURNAL_MAGIC) + sizeof(int64_t)];
+    ByteSink out(header);
+    out.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    putValue<int64_t>(out, sequence);
+    if (!writeAll(header, sizeof(header)) || fdatasync(m_fd) != 0) {
+        throw runtime_error("Cannot write journal " + m_path);
+    }
+}
+
+void QueueJournal::writerLoop() {
+    //group commit: whatever was journaled during one interval is encoded, written and synced as one batch.
+    //The records are encoded straight from the ring, which is freed for the queue before the slow part;
+    //no journal record is more than twice as long as its raw record, so the batch buffer only grows
+    vector<char> batch;
+    uint64_t passThrough = 0;
+    unique_lock<mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait_for(lock, chrono::milliseconds(m_commitMs), [this] { return m_stop || m_flushRequested; });
+        m_flushRequested = false;
+        bool stopping = m_stop;
+        lock.unlock();
+
+        uint64_t head = m_head.load(memory_order_acquire);
+        uint64_t tail = m_tail.load(memory_order_relaxed);
+        bool written = true;
+        if (head != tail) {
+            //a record that wraps around the end of the ring is read on, from a copy of the ring's first bytes
+            size_t offset = tail & (RING_BYTES - 1);
+            if (offset + (head - tail) > (uint64_t) RING_BYTES) {
+                size_t wrapped = head - tail - (RING_BYTES - offset);
+                memcpy(&m_ring[RING_BYTES], &m_ring[0], min(wrapped, (size_t) RAW_RECORD_BYTES));
+            }
+            if (batch.size() < BATCH_HEADER + 2 * (head - tail)) {
+                batch.resize(BATCH_HEADER + 2 * (head - tail));
+            }
+            char *end = encodeRecords(tail, head, &batch[BATCH_HEADER], passThrough);
+            m_tail.store(tail, memory_order_release);
+            if (end != &batch[BATCH_HEADER]) {
+                written = writeBatches(batch.data(), end - batch.data()) && fdatasync(m_fd) == 0;
+            }
+        }
+
+        lock.lock();
+        if (written) {
+            m_syncedBytes = tail;
+        } else {
+            m_failed = true;
+        }
+        m_synced.notify_all();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+char *QueueJournal::encodeRecords(uint64_t &position, uint64_t head, char *out, uint64_t &passThrough) {
+    //turns the raw records from position to head into journal records and returns their end; position moves
+    //past them, and a record the queue is still copying stays in the ring until the next commit
+    ByteSink sink(out);
+    while (position < head) {
+        size_t offset = position & (RING_BYTES - 1);
+        const char *raw = &m_ring[offset];
+        size_t available = head - position;
+        if (passThrough > 0) {
+            //already encoded by the queue, and possibly longer than the ring
+            size_t chunk = (size_t) min(passThrough, (uint64_t) min(available, (size_t) RING_BYTES - offset));
+            sink.write(raw, chunk);
+            position += chunk;
+            passThrough -= chunk;
+            continue;
+        }
+        int op = (unsigned char) raw[0];
+        if (op == RING_ENCODED) {
+            if (available < (size_t) RING_HEADER) {
+                break;
+            }
+            memcpy(&passThrough, raw + 1, sizeof(passThrough));
+            position += RING_HEADER;
+        } else if (op == OP_INSERT) {
+            RawInsert insert;
+            if (available < 1 + sizeof(insert)) {
+                break;
+            }
+            memcpy(&insert, raw + 1, sizeof(insert));
+            size_t recordSize = 1 + sizeof(insert) + insert.m_nameSize;
+            if (available < recordSize) {
+                break;
+            }
+
+            //the same encoding as putStudent, after the size of the record
+            char fields[1 + (NUM_ATTRIBUTES + 1) * MAX_VARINT];
+            ByteSink fieldSink(fields);
+            fieldSink.put((char) op);
+            for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+                putZigzag(fieldSink, insert.m_fields[i]);
+            }
+            putVarint(fieldSink, insert.m_nameSize);
+            size_t fieldBytes = fieldSink.position() - fields;
+            putVarint(sink, fieldBytes + insert.m_nameSize);
+            sink.write(fields, fieldBytes);
+            sink.write(raw + 1 + sizeof(insert), insert.m_nameSize);
+            position += recordSize;
+        } else {
+            //an operation without a payload
+            sink.put(1);
+            sink.put((char) op);
+            position++;
+        }
+    }
+    return sink.position();
+}
+
+bool QueueJournal::writeBatches(char *batch, size_t size) {
+    //the records follow BATCH_HEADER free bytes; replay takes a batch longer than the ring for a torn one,
+    //so a long run of records is split, each header going over the end of the piece written before it
+    size_t offset = BATCH_HEADER;
+    while (offset < size) {
+        size_t piece = min(size - offset, (size_t) RING_BYTES);
+        uint32_t header[2] = {(uint32_t) piece, checksum(&batch[offset], piece)};
+        memcpy(&batch[offset - BATCH_HEADER], header, BATCH_HEADER);
+        if (!writeAll(&batch[offset - BATCH_HEADER], piece + BATCH_HEADER)) {
+            return false;
+        }
+        offset += piece;
+    }
+    return true;
+}
+
+void QueueJournal::stopWriter() {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    m_stop = false;
+}
+
+bool QueueJournal::writeAll(const char *data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = write(m_fd, data + written, size - written);
+        if (result < 0 && errno != EINTR) {
+            return false;
+        }
+        written += (result > 0) ? result : 0;
+    }
+    return true;
+}
+
+bool QueueJournal::syncPath(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = (fsync(fd) == 0);
+    close(fd);
+    return synced;
+}
+
+uint32_t QueueJournal::checksum(const char *data, size_t size) {
+    //multiply-xorshift over 8-byte words, the batches are megabytes
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+    uint64_t last = 0;
+    memcpy(&last, data + i, size - i);
+    hash = (hash ^ last) * 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 29;
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+SharedQueue::SharedQueue(const string &name, int capacity, prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure) :
+        m_name(name), m_segment(nullptr), m_bytes(0), m_keys(priFn, heapType, structure) {
+    if (capacity < 1) {
+        throw invalid_argument("Capacity must be positive");
+    }
+    if (structure != SKEW && structure != LEFTIST) {
+        throw invalid_argument("Shared queues support only skew and leftist heaps");
+    }
+    if ((size_t) capacity > (SIZE_MAX - sizeof(Segment)) / sizeof(SharedNode)) {
+        throw overflow_error("Shared queue capacity is too large");
+    }
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        throw runtime_error("Cannot create shared queue " + name + ": " + strerror(errno));
+    }
+    size_t bytes = sizeof(Segment) + capacity * sizeof(SharedNode);
+    if (ftruncate(fd, bytes) != 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw runtime_error("Cannot size shared queue " + name + ": " + strerror(error));
+    }
+    try {
+        map(fd, bytes);
+    } catch (...) {
+        shm_unlink(name.c_str());
+        throw;
+    }
+
+    //the segment starts out zeroed, so the magic number is still unset while it is being set up
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&m_segment->m_mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    m_segment->m_capacity = capacity;
+    m_segment->m_used = 0;
+    m_segment->m_size = 0;
+    m_segment->m_root = NONE;
+    m_segment->m_free = NONE;
+    m_segment->m_heapType = heapType;
+    m_segment->m_structure = structure;
+    m_segment->m_magic.store(Segment::MAGIC, memory_order_release);
+}
+
+SharedQueue::SharedQueue(const string &name, prifn_t priFn) :
+        m_name(name), m_segment(nullptr), m_bytes(0), m_keys(priFn, MINHEAP, SKEW) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw runtime_error("Cannot open shared queue " + name + ": " + strerror(errno));
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(Segment)) {
+        close(fd);
+        throw runtime_error("Shared queue " + name + " is not set up yet");
+    }
+    map(fd, status.st_size);
+    if (m_segment->m_magic.load(memory_order_acquire) != Segment::MAGIC ||
+        m_bytes != sizeof(Segment) + m_segment->m_capacity * sizeof(SharedNode)) {
+        munmap(m_segment, m_bytes);
+        throw runtime_error("Shared queue " + name + " is not set up yet");
+    }
+
+    //keys are computed by this process, in the creator's heap type
+    m_keys.setPriorityFn(priFn, (HEAPTYPE) m_segment->m_heapType);
+}
+
+SharedQueue::~SharedQueue() {
+    munmap(m_segment, m_bytes);
+}
+
+void SharedQueue::remove(const string &name) {
+    shm_unlink(name.c_str());
+}
+
+void SharedQueue::insertStudent(const Student &student) {
+    string name = student.getName();
+    if (name.size() > (size_t) MAX_NAME) {
+        throw invalid_argument("Student name is too long for a shared queue");
+    }
+
+    //the key is computed before taking the lock, the priority function may be slow
+    int64_t key = m_keys.rankKey(student);
+    lock();
+    int32_t index = allocateNode();
+    if (index == NONE) {
+        unlock();
+        throw overflow_error("Shared queue is full");
+    }
+    SharedNode &node = nodes()[index];
+    node.m_key = key;
+    node.m_left = NONE;
+    node.m_right = NONE;
+    node.m_npl = 0;
+    for (int i = 0; i < NUM_ATTRIBUTES; i++) {
+        node.m_attributes[i] = student.getAttribute((ATTRIBUTE) i);
+    }
+    memcpy(node.m_name, name.c_str(), name.size() + 1);
+    //the release store keeps the student's fields ahead of the mark, a repair never sees a partial student
+    node.m_queued.store(1, memory_order_release);
+    m_segment->m_root = merge(m_segment->m_root, index);
+    m_segment->m_size++;
+    unlock();
+}
+
+Student SharedQueue::getNextStudent() {
+    lock();
+    if (m_segment->m_size == 0) {
+        unlock();
+        throw out_of_range("Queue is empty");
+    }
+    int32_t root = m_segment->m_root;
+    SharedNode &node = nodes()[root];
+    char name[MAX_NAME + 1];
+    int32_t fields[NUM_ATTRIBUTES];
+    memcpy(name, node.m_name, sizeof(name));
+    memcpy(fields, node.m_attributes, sizeof(fields));
+
+    //the student is given up last: a process that dies before this keeps it queued for the repair,
+    //one that dies between here and returning it drops it, so a student is served at most once
+    m_segment->m_size--;
+    m_segment->m_root = merge(node.m_left, node.m_right);
+    releaseNode(root);
+    node.m_queued.store(0, memory_order_release);
+    unlock();
+    return Student(name, fields[ATTR_LEVEL], fields[ATTR_MAJOR], fields[ATTR_GROUP], fields[ATTR_RACE],
+                   fields[ATTR_GENDER], fields[ATTR_INCOME], fields[ATTR_HIGHSCHOOL]);
+}
+
+void SharedQueue::clear() {
+    lock();
+    for (int32_t i = 0; i < m_segment->m_used; i++) {
+        nodes()[i].m_queued.store(0, memory_order_relaxed);
+    }
+    m_segment->m_used = 0;
+    m_segment->m_size = 0;
+    m_segment->m_root = NONE;
+    m_segment->m_free = NONE;
+    unlock();
+}
+
+int SharedQueue::numStudents() const {
+    lock();
+    int size = m_segment->m_size;
+    unlock();
+    return size;
+}
+
+int SharedQueue::getCapacity() const {
+    return m_segment->m_capacity;
+}
+
+HEAPTYPE SharedQueue::getHeapType() const {
+    return (HEAPTYPE) m_segment->m_heapType;
+}
+
+STRUCTURE SharedQueue::getStructure() const {
+    return (STRUCTURE) m_segment->m_structure;
+}
+
+SharedQueue::SharedNode *SharedQueue::nodes() const {
+    return reinterpret_cast<SharedNode *>(m_segment + 1);
+}
+
+void SharedQueue::map(int fd, size_t bytes) {
+    void *address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw runtime_error("Cannot map shared queue " + m_name + ": " + strerror(error));
+    }
+    m_segment = static_cast<Segment *>(address);
+    m_bytes = bytes;
+}
+
+void SharedQueue::lock() const {
+    int result = pthread_mutex_lock(&m_segment->m_mutex);
+    if (result == EOWNERDEAD) {
+        //the previous owner died in the middle of an operation, its links cannot be trusted
+        repair();
+        pthread_mutex_consistent(&m_segment->m_mutex);
+    } else if (result != 0) {
+        throw runtime_error("Cannot lock shared queue " + m_name + ": " + strerror(result));
+    }
+}
+
+void SharedQueue::unlock() const {
+    pthread_mutex_unlock(&m_segment->m_mutex);
+}
+
+void SharedQueue::repair() const {
+    //students are marked queued only once they are complete, and unmarked only once they are unlinked
+    m_segment->m_root = NONE;
+    m_segment->m_free = NONE;
+    m_segment->m_size = 0;
+    for (int32_t i = m_segment->m_used - 1; i >= 0; i--) {
+        SharedNode &node = nodes()[i];
+        node.m_left = NONE;
+        node.m_right = NONE;
+        node.m_npl = 0;
+        if (node.m_queued.load(memory_order_acquire) == 1) {
+            m_segment->m_root = merge(m_segment->m_root, i);
+            m_segment->m_size++;
+        } else {
+            releaseNode(i);
+        }
+    }
+}
+
+int32_t SharedQueue::merge(int32_t lhs, int32_t rhs) const {
+    return (m_segment->m_structure == LEFTIST) ? mergeLEFTIST(lhs, rhs) : mergeSKEW(lhs, rhs);
+}
+
+int32_t SharedQueue::mergeLEFTIST(int32_t lhs, int32_t rhs) const {
+    //same merges as RQueue, with indexes for pointers
+    if (lhs == NONE) {
+        return rhs;
+    } else if (rhs == NONE) {
+        return lhs;
+    } else if (nodes()[lhs].m_key > nodes()[rhs].m_key) {
+        return mergeLEFTIST(rhs, lhs);
+    }
+    SharedNode &node = nodes()[lhs];
+    node.m_right = mergeLEFTIST(node.m_right, rhs);
+    if (node.m_left == NONE) {
+        node.m_left = node.m_right;
+        node.m_right = NONE;
+    } else {
+        if (nodes()[node.m_right].m_npl > nodes()[node.m_left].m_npl) {
+            int32_t temp = node.m_left;
+            node.m_left = node.m_right;
+            node.m_right = temp;
+        }
+        node.m_npl = nodes()[node.m_right].m_npl + 1;
+    }
+    return lhs;
+}
+
+int32_t SharedQueue::mergeSKEW(int32_t lhs, int32_t rhs) const {
+    if (lhs == NONE) {
+        return rhs;
+    } else if (rhs == NONE) {
+        return lhs;
+    } else if (nodes()[lhs].m_key > nodes()[rhs].m_key) {
+        return mergeSKEW(rhs, lhs);
+    }
+    SharedNode &node = nodes()[lhs];
+    int32_t temp = node.m_right;
+    node.m_right = node.m_left;
+    node.m_left = mergeSKEW(rhs, temp);
+    return lhs;
+}
+
+int32_t SharedQueue::allocateNode() const {
+    //recycle a released node, otherwise take the next one that was never used
+    if (m_segment->m_free != NONE) {
+        int32_t index = m_segment->m_free;
+        m_segment->m_free = nodes()[index].m_right;
+        return index;
+    }
+    if (m_segment->m_used == m_segment->m_capacity) {
+        return NONE;
+    }
+    return m_segment->m_used++;
+}
+
+void SharedQueue::releaseNode(int32_t node) const {
+    nodes()[node].m_right = m_segment->m_free;
+    m_segment->m_free = node;
+}
+
+IntakeQueue::IntakeQueue(RQueue &queue) : m_queue(), m_intake(nullptr), m_drained(), m_entries() {
+    //the queue must be set up before anything can throw, its destructor runs either way
+    m_queue.initializeLike(queue);
+    if (queue.m_structure == RADIX || queue.m_indexed) {
+        throw invalid_argument("Intake queues support neither radix heaps nor indexed queues");
+    }
+    m_queue.mergeWithQueue(queue);
+}
+
+IntakeQueue::~IntakeQueue() {
+    IntakeNode *node = m_intake.load(memory_order_acquire);
+    while (node != nullptr) {
+        IntakeNode *next = node->m_next;
+        delete node;
+        node = next;
+    }
+}
+
+void IntakeQueue::insertStudent(const Student &student) {
+    IntakeNode *node = new IntakeNode(student);
+    push(node, node);
+}
+
+Student IntakeQueue::getNextStudent() {
+    drain();
+    return m_queue.getNextStudent();
+}
+
+int IntakeQueue::numStudents() {
+    drain();
+    return m_queue.numStudents();
+}
+
+void IntakeQueue::drain() {
+    //nothing to do is the common case, and it costs a single load
+    if (m_intake.load(memory_order_relaxed) == nullptr) {
+        return;
+    }
+
+    //the consumer takes the whole stack at once; nodes are never popped one by one, so there is no ABA
+    IntakeNode *node = m_intake.exchange(nullptr, memory_order_acquire);
+    m_drained.clear();
+    for (; node != nullptr; node = node->m_next) {
+        m_drained.push_back(node);
+    }
+    reverse(m_drained.begin(), m_drained.end());
+
+    //keys first, so that an aging overflow leaves every student in the intake
+    m_entries.resize(m_drained.size());
+    try {
+        for (unsigned int i = 0; i < m_drained.size(); i++) {
+            m_entries[i].m_key = m_queue.agedKey(m_drained[i]->m_student, m_queue.m_epoch);
+        }
+    } catch (...) {
+        m_entries.clear();
+        for (unsigned int i = 0; i + 1 < m_drained.size(); i++) {
+            m_drained[i + 1]->m_next = m_drained[i];
+        }
+        push(m_drained.back(), m_drained.front());
+        throw;
+    }
+    for (unsigned int i = 0; i < m_drained.size(); i++) {
+        m_entries[i].m_student = m_queue.storeStudent(m_drained[i]->m_student);
+        delete m_drained[i];
+    }
+    m_drained.clear();
+    m_queue.insertBatch(m_entries);
+}
+
+void IntakeQueue::advanceEpoch(int64_t ticks) {
+    //students still in the intake get their keys when they are drained, at the epoch they are drained in
+    m_queue.advanceEpoch(ticks);
+}
+
+void IntakeQueue::push(IntakeNode *first, IntakeNode *last) {
+    //a failed compare-and-swap reloads the top into last->m_next, so the loop body is empty
+    last->m_next = m_intake.load(memory_order_relaxed);
+    while (!m_intake.compare_exchange_weak(last->m_next, first, memory_order_release, memory_order_relaxed)) {
+    }
+}
+
+QueueRegistry::QueueRegistry(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure)
+        : m_priorFunc(priFn), m_heapType(heapType), m_structure(structure), m_arena(), m_slots(), m_count(0) {
+    if (priFn == nullptr) {
+        throw invalid_argument("Priority function must be given");
+    }
+}
+
+QueueRegistry::~QueueRegistry() {
+    clear();
+}
+
+RQueue &QueueRegistry::section(int id) {
+    int pos = findSlot(id);
+    if (pos >= 0) {
+        return *m_slots[pos].m_queue;
+    }
+
+    //keep the table at most half full so probe sequences stay short
+    if (2 * (m_count + 1) > (int) m_slots.size()) {
+        grow();
+    }
+    RQueue *queue = new RQueue(m_priorFunc, m_heapType, m_structure);
+    queue->moveToArena(&m_arena);
+    size_t mask = m_slots.size() - 1;
+    size_t slot = homeSlot(id, mask);
+    while (m_slots[slot].m_queue != nullptr) {
+        slot = (slot + 1) & mask;
+    }
+    m_slots[slot].m_id = id;
+    m_slots[slot].m_queue = queue;
+    m_count++;
+    return *queue;
+}
+
+RQueue *QueueRegistry::find(int id) const {
+    int pos = findSlot(id);
+    return (pos < 0) ? nullptr : m_slots[pos].m_queue;
+}
+
+bool QueueRegistry::remove(int id) {
+    int pos = findSlot(id);
+    if (pos < 0) {
+        return false;
+    }
+    //the queue gives its nodes and students back to the arena for the other sections
+    delete m_slots[pos].m_queue;
+    m_count--;
+
+    //backward-shift deletion: move later entries of the probe sequence into the hole
+    size_t mask = m_slots.size() - 1;
+    size_t hole = pos;
+    size_t next = pos;
+    while (true) {
+        next = (next + 1) & mask;
+        if (m_slots[next].m_queue == nullptr) {
+            break;
+        }
+        //an entry stays if its home slot lies cyclically in (hole, next]
+        size_t home = homeSlot(m_slots[next].m_id, mask);
+        bool stays = (hole < next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!stays) {
+            m_slots[hole] = m_slots[next];
+            hole = next;
+        }
+    }
+    m_slots[hole].m_queue = nullptr;
+    return true;
+}
+
+int QueueRegistry::numSections() const {
+    return m_count;
+}
+
+void QueueRegistry::clear() {
+    //the arena is reset as a whole, so the queues forget their students instead of giving them back
+    for (unsigned int i = 0; i < m_slots.size(); i++) {
+        RQueue *queue = m_slots[i].m_queue;
+        if (queue != nullptr) {
+            queue->m_heap = nullptr;
+            queue->m_entries.clear();
+            if (queue->m_extras != nullptr) {
+                queue->m_extras->m_buckets.clear();
+            }
+            delete queue;
+        }
+    }
+    m_slots.clear();
+    m_count = 0;
+    m_arena.m_nodes.reset();
+    m_arena.m_students.reset();
+}
+
+size_t QueueRegistry::homeSlot(int id, size_t mask) {
+    //Fibonacci hashing spreads ids that differ by a multiple of the table size
+    return (size_t) (((uint64_t) (uint32_t) id * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+int QueueRegistry::findSlot(int id) const {
+    if (m_slots.empty()) {
+        return -1;
+    }
+    size_t mask = m_slots.size() - 1;
+    for (size_t pos = homeSlot(id, mask); m_slots[pos].m_queue != nullptr; pos = (pos + 1) & mask) {
+        if (m_slots[pos].m_id == id) {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+void QueueRegistry::grow() {
+    //double the table and reinsert every entry at its new home slot
+    vector<Slot> oldSlots(max((size_t) 16, 2 * m_slots.size()));
+    oldSlots.swap(m_slots);
+    size_t mask = m_slots.size() - 1;
+    for (unsigned int i = 0; i < oldSlots.size(); i++) {
+        if (oldSlots[i].m_queue != nullptr) {
+            size_t pos = homeSlot(oldSlots[i].m_id, mask);
+            while (m_slots[pos].m_queue != nullptr) {
+                pos = (pos + 1) & mask;
+            }
+            m_slots[pos] = oldSlots[i];
+        }
+    }
+}
+
+ReleaseQueue::ReleaseQueue(RQueue &queue, int64_t now)
+        : m_queue(), m_now(now), m_wheel(LEVELS * SLOTS), m_occupied(), m_overflow(),
+          m_overflowMin(numeric_limits<int64_t>::max()), m_waiting(0), m_due(), m_cascade(), m_entries() {
+    //the queue must be set up before anything can throw, its destructor runs either way
+    m_queue.initializeLike(queue);
+    if (queue.m_structure == RADIX || queue.m_indexed) {
+        throw invalid_argument("Release queues support neither radix heaps nor indexed queues");
+    }
+    m_queue.mergeWithQueue(queue);
+}
+
+void ReleaseQueue::insertStudent(const Student &student) {
+    m_queue.insertStudent(student);
+}
+
+void ReleaseQueue::insertStudent(const Student &student, int64_t eligibleAt) {
+    if (eligibleAt <= m_now) {
+        m_queue.insertStudent(student);
+        return;
+    }
+    Pending pending;
+    pending.m_time = eligibleAt;
+    pending.m_student = m_queue.storeStudent(student);
+    place(pending);
+}
+
+int ReleaseQueue::advanceTime(int64_t now) {
+    if (now < m_now) {
+        throw invalid_argument("Time cannot go backwards");
+    }
+    size_t before = m_due.size();
+    uint64_t target = tick(now);
+    while (m_waiting > 0) {
+        //jump straight to the next occupied slot, the empty ones in between cost nothing
+        int level;
+        int slot;
+        uint64_t start;
+        if (!nextSlot(level, slot, start)) {
+            //only the overflow list is left, its students enter the wheel with the clock
+            const int shift = SLOT_BITS * LEVELS;
+            level = LEVELS;
+            start = tick(m_overflowMin) >> shift << shift;
+        }
+        if (start > target) {
+            break;
+        }
+
+        //the clock enters the slot, so its students are due or move down a level
+        m_now = (int64_t) (start ^ (1ULL << 63));
+        m_cascade.clear();
+        if (level == LEVELS) {
+            m_cascade.swap(m_overflow);
+            m_overflowMin = numeric_limits<int64_t>::max();
+        } else {
+            m_cascade.swap(m_wheel[level * SLOTS + slot]);
+            m_occupied[level] &= ~(1ULL << slot);
+        }
+        m_waiting -= m_cascade.size();
+        for (const Pending &pending : m_cascade) {
+            place(pending);
+        }
+    }
+    m_now = now;
+
+    int released = m_due.size() - before;
+    release();
+    return released;
+}
+
+int64_t ReleaseQueue::getTime() const {
+    return m_now;
+}
+
+int64_t ReleaseQueue::nextRelease() const {
+    if (m_waiting == 0) {
+        throw out_of_range("No student is waiting");
+    }
+    //every earlier slot is empty, so the earliest student is in the first occupied one
+    int level;
+    int slot;
+    uint64_t start;
+    if (!nextSlot(level, slot, start)) {
+        return m_overflowMin;
+    }
+    int64_t earliest = numeric_limits<int64_t>::max();
+    for (const Pending &pending : m_wheel[level * SLOTS + slot]) {
+        earliest = min(earliest, pending.m_time);
+    }
+    return earliest;
+}
+
+Student ReleaseQueue::getNextStudent() {
+    release();
+    return m_queue.getNextStudent();
+}
+
+int ReleaseQueue::numStudents() const {
+    return m_queue.numStudents() + m_due.size();
+}
+
+int ReleaseQueue::numWaiting() const {
+    return m_waiting;
+}
+
+void ReleaseQueue::advanceEpoch(int64_t ticks) {
+    m_queue.advanceEpoch(ticks);
+}
+
+uint64_t ReleaseQueue::tick(int64_t time) {
+    //flipping the sign bit maps negative times below the positive ones
+    return (uint64_t) time ^ (1ULL << 63);
+}
+
+void ReleaseQueue::place(const Pending &pending) {
+    if (pending.m_time <= m_now) {
+        m_due.push_back(pending);
+        return;
+    }
+    m_waiting++;
+    uint64_t time = tick(pending.m_time);
+    int level = (63 - __builtin_clzll(time ^ tick(m_now))) / SLOT_BITS;
+    if (level >= LEVELS) {
+        m_overflow.push_back(pending);
+        m_overflowMin = min(m_overflowMin, pending.m_time);
+        return;
+    }
+    int slot = (time >> (level * SLOT_BITS)) & (SLOTS - 1);
+    m_wheel[level * SLOTS + slot].push_back(pending);
+    m_occupied[level] |= 1ULL << slot;
+}
+
+bool ReleaseQueue::nextSlot(int &level, int &slot, uint64_t &start) const {
+    //a waiting student is always in a slot after the clock's digit on its level, and the lower levels come first
+    uint64_t now = tick(m_now);
+    for (level = 0; level < LEVELS; level++) {
+        int digit = (now >> (level * SLOT_BITS)) & (SLOTS - 1);
+        uint64_t later = (digit == SLOTS - 1) ? 0 : m_occupied[level] & (~0ULL << (digit + 1));
+        if (later != 0) {
+            slot = __builtin_ctzll(later);
+            int shift = (level + 1) * SLOT_BITS;
+            start = (now >> shift << shift) | ((uint64_t) slot << (level * SLOT_BITS));
+            return true;
+        }
+    }
+    return false;
+}
+
+void ReleaseQueue::release() {
+    if (m_due.empty()) {
+        return;
+    }
+    //keys first, so that an aging overflow leaves every due student for the next try
+    m_entries.resize(m_due.size());
+    try {
+        for (unsigned int i = 0; i < m_due.size(); i++) {
+            m_entries[i].m_key = m_queue.agedKey(*m_due[i].m_student, m_queue.m_epoch);
+        }
+    } catch (...) {
+        m_entries.clear();
+        throw;
+    }
+    for (unsigned int i = 0; i < m_due.size(); i++) {
+        m_entries[i].m_student = m_due[i].m_student;
+    }
+    m_due.clear();
+    m_queue.insertBatch(m_entries);
+}
+
+PolicySimulator::PolicySimulator(const vector<Student> &corpus) : m_corpus(corpus), m_names(), m_policies() {
+}
+
+PolicySimulator::~PolicySimulator() {
+    for (RQueue *policy : m_policies) {
+        delete policy;
+    }
+}
+
+int PolicySimulator::addPolicy(const string &name, prifn_t priFn, HEAPTYPE heapType) {
+    return addPolicy(name, new RQueue(priFn, heapType, SKEW));
+}
+
+int PolicySimulator::addPolicy(const string &name, prifn64_t priFn, HEAPTYPE heapType) {
+    return addPolicy(name, new RQueue(priFn, heapType, SKEW));
+}
+
+int PolicySimulator::addPolicy(const string &name, prifnreal_t priFn, HEAPTYPE heapType) {
+    return addPolicy(name, new RQueue(priFn, heapType, SKEW));
+}
+
+int PolicySimulator::addPolicy(const string &name, const PrioritySpec &spec) {
+    return addPolicy(name, new RQueue(spec, SKEW));
+}
+
+int PolicySimulator::numPolicies() const {
+    return m_policies.size();
+}
+
+int PolicySimulator::numStudents() const {
+    return m_corpus.size();
+}
+
+vector<PolicyResult> PolicySimulator::run(int seats, int threads) {
+    int count = m_policies.size();
+    if (seats < 0 || seats > numStudents()) {
+        seats = numStudents();
+    }
+    if (threads <= 0) {
+        threads = max((int) thread::hardware_concurrency(), 1);
+    }
+    threads = min(threads, count);
+
+    //every thread takes the next policy until none is left; the policies share nothing but the corpus
+    vector<PolicyResult> results(count);
+    vector<exception_ptr> failures(count);
+    atomic<int> next(0);
+    auto work = [&]() {
+        for (int policy = next++; policy < count; policy = next++) {
+            try {
+                runPolicy(policy, seats, results[policy]);
+            } catch (...) {
+                failures[policy] = current_exception();
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++) {
+        pool.push_back(thread(work));
+    }
+    //the calling thread is one of the workers
+    work();
+    for (thread &worker : pool) {
+        worker.join();
+    }
+    for (const exception_ptr &failure : failures) {
+        if (failure) {
+            rethrow_exception(failure);
+        }
+    }
+    return results;
+}
+
+int PolicySimulator::addPolicy(const string &name, RQueue *policy) {
+    try {
+        m_names.push_back(name);
+        m_policies.push_back(policy);
+    } catch (...) {
+        m_names.resize(m_policies.size());
+        delete policy;
+        throw;
+    }
+    return m_policies.size() - 1;
+}
+
+void PolicySimulator::runPolicy(int policy, int seats, PolicyResult &result) {
+    RQueue &queue = *m_policies[policy];
+    vector<Ranked> ranked(m_corpus.size());
+    for (unsigned int i = 0; i < m_corpus.size(); i++) {
+        ranked[i].m_key = queue.rankKey(m_corpus[i]);
+        ranked[i].m_position = i;
+    }
+
+    //the seats best students are selected in linear time, then only they are put in order
+    auto before = [](const Ranked &lhs, const Ranked &rhs) {
+        return lhs.m_key < rhs.m_key || (lhs.m_key == rhs.m_key && lhs.m_position < rhs.m_position);
+    };
+    if (seats < (int) ranked.size()) {
+        nth_element(ranked.begin(), ranked.begin() + seats, ranked.end(), before);
+    }
+    sort(ranked.begin(), ranked.begin() + seats, before);
+
+    result.m_name = m_names[policy];
+    result.m_order.resize(seats);
+    //the policy queue holds no students, its counts only add up the admitted ones
+    QueueExtras &extras = queue.extras();
+    extras.m_counted = true;
+    extras.m_counts = QueueCounts();
+    for (int i = 0; i < seats; i++) {
+        result.m_order[i] = ranked[i].m_position;
+        queue.countStudent(m_corpus[ranked[i].m_position], 1);
+    }
+    result.m_counts = extras.m_counts;
+}
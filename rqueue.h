@@ -6,6 +6,16 @@
 #include <stdexcept>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <new>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <pthread.h>
 using namespace std;
 using std::ostream;
 using std::string;
@@ -15,6 +25,12 @@ class Grader;   // forward declaration (for grading purposes)
 class Tester;   // forward declaration (for testing purposes)
 class Student;  // forward declaration
 class RQueue;   // forward declaration
+class QueueJournal; // forward declaration
+class SharedQueue;  // forward declaration
+class IntakeQueue;  // forward declaration
+class QueueRegistry; // forward declaration
+class ReleaseQueue;  // forward declaration
+class PolicySimulator; // forward declaration
 
 // Constant parameters for scenario 1 (used for MAX heap)
 enum Level {FRESH, SOPH, JUNI, SENI};//freshman, sophomore, junior, senior
@@ -27,17 +43,33 @@ enum Income {TIER1, TIER2, TIER3, TIER4, TIER5};//Tier1 is the lowest income
 enum Highschool {LOW, MEDIUM, HIGH};//this defines the school rank
 const int MIN = 0;  // this is a min value for a priority
 const int MAX = 10; // this is a max value for a priority
+// Student attributes that policies can refer to by name
+enum ATTRIBUTE {ATTR_LEVEL, ATTR_MAJOR, ATTR_GROUP, ATTR_RACE, ATTR_GENDER, ATTR_INCOME, ATTR_HIGHSCHOOL};
+const int NUM_ATTRIBUTES = 7;
+const int ATTRIBUTE_MAX[NUM_ATTRIBUTES] = {SENI, CSC, RESE, MAJORITY, MALE, TIER5, HIGH}; // largest valid values
 
 enum HEAPTYPE {MINHEAP, MAXHEAP};
-enum STRUCTURE {SKEW, LEFTIST};
+// DARY is an array-backed d-ary heap, RADIX is a radix heap for monotone priorities,
+// WBLEFTIST is a weight-biased leftist heap (subtree sizes instead of NPL, merged top-down in one pass),
+// BINOMIAL is a binomial heap: a list of binomial trees, so no operation walks more than O(log n) nodes
+enum STRUCTURE {SKEW, LEFTIST, DARY, RADIX, WBLEFTIST, BINOMIAL};
+// MERGE_SAME merges only queues with the same configuration, MERGE_REKEY rebuilds rhs in the host's first
+enum MERGEPOLICY {MERGE_SAME, MERGE_REKEY};
+const int DEFAULT_ARITY = 4;  // branching factor of a DARY heap
+const int RADIX_BUCKETS = 65; // one bucket per bit of a 64-bit key, plus one for keys equal to the last extracted
 // Priority function pointer type
 typedef int (*prifn_t)(const Student&);
+// Priority function types for scores that do not fit the [MIN, MAX] range
+typedef int64_t (*prifn64_t)(const Student&);  // wide integer scores, e.g. timestamps
+typedef double (*prifnreal_t)(const Student&); // real scores, ordered by IEEE total order (NaN is last)
 
 class Student{
 public:
     friend class Grader; // for grading purposes
     friend class Tester; // for testing purposes
     friend class RQueue;
+    friend class StudentIndex;
+    friend class QueueJournal;
     Student(){
         m_name="";m_level=0;m_major=0;m_group=0;m_race=0;m_gender=0;m_income=0;m_highschool=0;
     }
@@ -63,6 +95,7 @@ public:
                 (m_race == rhs.m_race) && (m_gender == rhs.m_gender) &&
                 (m_income == rhs.m_income) && (m_highschool == rhs.m_highschool));
     }
+    string getName() const {return m_name;}
     int getLevel() const {return m_level;}
     int getMajor() const {return m_major;}
     int getGroup() const {return m_group;}
@@ -70,6 +103,21 @@ public:
     int getGender() const {return m_gender;}
     int getIncome() const {return m_income;}
     int getHighschool() const {return m_highschool;}
+    int getAttribute(ATTRIBUTE attribute) const{
+        int result = 0;
+        switch (attribute)
+        {
+            case ATTR_LEVEL: result = m_level; break;
+            case ATTR_MAJOR: result = m_major; break;
+            case ATTR_GROUP: result = m_group; break;
+            case ATTR_RACE: result = m_race; break;
+            case ATTR_GENDER: result = m_gender; break;
+            case ATTR_INCOME: result = m_income; break;
+            case ATTR_HIGHSCHOOL: result = m_highschool; break;
+            default: break;
+        }
+        return result;
+    }
     string getLevelStr() const{
         string result = "UNKNOWN";
         switch (m_level)
@@ -119,27 +167,290 @@ private:
     int m_income;         // for valid values refer to enum type Income
     int m_highschool;     // for valid values refer to enum type Highschool
 };
+// Nodes only carry what the merges touch; the student payload lives in the queue's student pool
 class Node{
 public:
     friend class Grader; // for grading purposes
     friend class Tester; // for testing purposes
     friend class RQueue;
-    Node(Student student) {
-        m_student = student;
+    Node() {
+        m_key = 0;
         m_right = nullptr;
         m_left = nullptr;
+        m_student = nullptr;
         m_npl = 0;
+        m_weight = 1;
     }
     void setNPL(int npl) {m_npl = npl;}
     int getNPL() const {return m_npl;}
-    Student getStudent() const {return m_student;}
+    int getWeight() const {return m_weight;} // nodes in this subtree, kept up to date by WBLEFTIST only
+    int64_t getKey() const {return m_key;}
+    Node* getLeft() const {return m_left;}
+    Node* getRight() const {return m_right;}
+    Student getStudent() const {return *m_student;}
     // Overloaded insertion operators for Student and Node
     friend ostream& operator<<(ostream& sout, const Node& node);
 private:
-    Student m_student;    // student information
+    int64_t m_key;        // cached priority, see RQueue::rankKey
     Node * m_right;       // right child
     Node * m_left;        // left child
-    int m_npl;            // null path length for leftist heap
+    Student * m_student;  // student information, owned by the queue's student pool; nullptr in a dummy node
+    int m_npl;            // null path length for leftist heap, degree of the tree for binomial heap
+    int m_weight;         // subtree size for weight-biased leftist heap
+};
+
+// Block allocator for nodes and students. Objects allocated together sit next to each other,
+// freed objects are recycled, and a pool can take over all blocks of another pool in constant time.
+template <class T>
+class BlockPool {
+public:
+    BlockPool() : m_first(nullptr), m_last(nullptr), m_spareFirst(nullptr), m_spareLast(nullptr), m_free(),
+                  m_blockSize(0) {}
+    ~BlockPool() {reset();}
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+    T* allocate() {
+        //recycle a freed object if there is one
+        if (!m_free.empty()) {
+            T* object = m_free.back();
+            m_free.pop_back();
+            return object;
+        }
+        //otherwise carve the first block that still has room, or a new block
+        while (m_spareFirst != nullptr && m_spareFirst->m_used == m_spareFirst->m_size) {
+            m_spareFirst = m_spareFirst->m_nextSpare;
+        }
+        if (m_spareFirst == nullptr) {
+            //blocks grow geometrically
+            m_blockSize = (m_blockSize == 0) ? FIRST_BLOCK : min(2 * m_blockSize, LAST_BLOCK);
+            newBlock(m_blockSize);
+        }
+        return objects(m_spareFirst) + m_spareFirst->m_used++;
+    }
+    void release(T* object) {m_free.push_back(object);}
+    void adopt(BlockPool& rhs) {
+        //take over every block of rhs, rhs must no longer reference any of its objects;
+        //blocks are chained through their headers, so splicing touches no more than two of them
+        if (rhs.m_first != nullptr) {
+            rhs.m_last->m_next = m_first;
+            m_first = rhs.m_first;
+            m_last = (m_last == nullptr) ? rhs.m_last : m_last;
+        }
+        if (rhs.m_spareFirst != nullptr) {
+            if (m_spareFirst == nullptr) {
+                m_spareFirst = rhs.m_spareFirst;
+            } else {
+                m_spareLast->m_nextSpare = rhs.m_spareFirst;
+            }
+            m_spareLast = rhs.m_spareLast;
+        }
+        //the shorter free list is appended to the longer one
+        if (m_free.size() < rhs.m_free.size()) {
+            m_free.swap(rhs.m_free);
+        }
+        m_free.insert(m_free.end(), rhs.m_free.begin(), rhs.m_free.end());
+        m_blockSize = max(m_blockSize, rhs.m_blockSize);
+        rhs.m_first = rhs.m_last = rhs.m_spareFirst = rhs.m_spareLast = nullptr;
+        rhs.m_free.clear();
+        rhs.m_blockSize = 0;
+    }
+    T* allocateBlock(int count) {
+        //count objects next to each other in a block of their own, bypassing the released objects
+        newBlock(count);
+        m_spareFirst->m_used = count;
+        return objects(m_spareFirst);
+    }
+    void swap(BlockPool& rhs) {
+        std::swap(m_first, rhs.m_first);
+        std::swap(m_last, rhs.m_last);
+        std::swap(m_spareFirst, rhs.m_spareFirst);
+        std::swap(m_spareLast, rhs.m_spareLast);
+        m_free.swap(rhs.m_free);
+        std::swap(m_blockSize, rhs.m_blockSize);
+    }
+    void reset() {
+        //release every block at once
+        while (m_first != nullptr) {
+            Block* block = m_first;
+            m_first = block->m_next;
+            for (int i = 0; i < block->m_size; i++) {
+                objects(block)[i].~T();
+            }
+            ::operator delete(block);
+        }
+        m_last = m_spareFirst = m_spareLast = nullptr;
+        m_free.clear();
+        m_blockSize = 0;
+    }
+private:
+    // header in front of the objects of each block
+    struct alignas(T) Block {
+        Block* m_next;       // next block of the pool
+        Block* m_nextSpare;  // next block that may still have unused objects
+        int m_size;          // objects in the block
+        int m_used;          // objects handed out so far
+    };
+    static constexpr int FIRST_BLOCK = 16;  // objects in the first block
+    static constexpr int LAST_BLOCK = 4096; // blocks stop growing at this size
+    Block* m_first;       // chain of every block of the pool
+    Block* m_last;
+    Block* m_spareFirst;  // chain of blocks with unused objects, carved front to back
+    Block* m_spareLast;
+    vector<T*> m_free;    // released objects waiting for reuse
+    int m_blockSize;      // size of the largest block so far
+
+    static T* objects(Block* block) {return reinterpret_cast<T*>(block + 1);}
+    void newBlock(int size) {
+        //the new block is carved before any other spare block
+        Block* block = static_cast<Block*>(::operator new(sizeof(Block) + size * sizeof(T)));
+        block->m_next = m_first;
+        block->m_nextSpare = m_spareFirst;
+        block->m_size = size;
+        block->m_used = 0;
+        for (int i = 0; i < size; i++) {
+            new (&objects(block)[i]) T();
+        }
+        m_first = block;
+        m_last = (m_last == nullptr) ? block : m_last;
+        m_spareLast = (m_spareFirst == nullptr) ? block : m_spareLast;
+        m_spareFirst = block;
+    }
+};
+
+// Open-addressing hash table (linear probing, backward-shift deletion) from student names to the
+// students stored in a queue. Withdrawn students stay in the table until the queue drops them.
+class StudentIndex {
+public:
+    StudentIndex();
+    bool insert(Student* student, bool withdrawn = false); // false if a queued student has the same name
+    Student* find(const string& name) const;                // queued student with this name, or nullptr
+    bool withdraw(const string& name);                      // false if no queued student has this name
+    bool isWithdrawn(const Student* student) const;
+    void remove(const Student* student);                    // forgets a stored student, queued or withdrawn
+    void clear();
+    int withdrawnCount() const {return m_withdrawn;}
+private:
+    struct Slot {
+        Student* m_student;  // nullptr if the slot is empty
+        size_t m_hash;       // hash of the student's name
+        bool m_withdrawn;    // erased from the queue, but still stored in it
+    };
+    vector<Slot> m_slots;    // the size is a power of two, at most half of the slots are used
+    int m_count;             // used slots
+    int m_withdrawn;         // used slots of withdrawn students
+
+    int findSlot(const string& name, size_t hash) const; // slot of the queued student, or -1
+    int slotOf(const Student* student) const;             // slot of this stored student, or -1
+    void grow();
+};
+
+// Declarative priority policy, e.g. "level + major + group desc, income asc".
+// Comma-separated criteria are compared lexicographically, each one is a weighted sum of attributes
+// ("2*income - race") sorted asc (default) or desc. The spec is compiled into one packed integer key
+// per student, so a queue using it still compares keys with a single integer compare.
+class PrioritySpec {
+public:
+    PrioritySpec();
+    explicit PrioritySpec(const string& spec); // throws invalid_argument on a malformed spec
+    int64_t key(const Student& student) const; // smaller keys come first in spec order
+    string toString() const;                   // normalized spec text
+    bool operator==(const PrioritySpec& rhs) const;
+    bool operator!=(const PrioritySpec& rhs) const;
+private:
+    string m_text;                     // normalized spec text
+    int64_t m_base;                    // constant part of the packed key
+    int64_t m_coeff[NUM_ATTRIBUTES];   // packed key contribution of one unit of each attribute
+
+    void parse(const string& spec);
+};
+
+// Entry of the array-backed heaps (d-ary and radix), the students themselves are kept in the student pool
+struct HeapEntry {
+    int64_t m_key;        // cached priority, see RQueue::rankKey
+    Student* m_student;   // student information, owned by the queue's student pool
+};
+
+// Latency histogram with power-of-two nanosecond buckets
+class LatencyHistogram {
+public:
+    static const int BUCKETS = 64;
+    LatencyHistogram();
+    void record(long long nanos);
+    long long percentile(double p) const; // upper bound of the bucket holding the p-th percentile
+    long long getCount() const {return m_count;}
+    long long getMax() const {return m_max;}
+private:
+    long long m_buckets[BUCKETS]; // m_buckets[i] counts samples in [2^i, 2^(i+1))
+    long long m_count;            // number of recorded samples
+    long long m_max;              // largest recorded sample
+};
+
+// Per-operation counters (only updated when built with RQUEUE_STATS)
+struct OpStats {
+    OpStats() : m_calls(0), m_comparisons(0), m_latency() {}
+    long long m_calls;          // number of calls to the operation
+    long long m_comparisons;    // priority comparisons made inside those calls
+    LatencyHistogram m_latency; // wall-clock time per call
+};
+
+// Snapshot of heap shape and hot-path counters returned by RQueue::stats()
+struct RQueueStats {
+    RQueueStats();
+    void dumpJSON(ostream& sout) const;
+
+    // shape of the heap, computed on demand by stats()
+    int m_nodeCount;            // number of nodes in the heap
+    int m_maxDepth;             // depth of the deepest node (root is 0)
+    double m_avgDepth;          // average depth of all nodes
+    int m_rightSpine;           // nodes on the path root -> rightmost, this bounds the merge cost
+    vector<int> m_nplCounts;    // m_nplCounts[k] is the number of nodes with null path length k
+
+    // hot-path counters, compiled out unless RQUEUE_STATS is defined
+    bool m_countersEnabled;     // true if the counters below are live
+    OpStats m_insert;           // insertStudent
+    OpStats m_extract;          // getNextStudent
+    OpStats m_merge;            // mergeWithQueue
+    long long m_comparisons;    // all priority comparisons, including rebuilds
+    long long m_priorityCalls;  // calls to the priority function
+    int m_maxMergeDepth;        // deepest recursion reached by mergeSKEW/mergeLEFTIST (nodes walked by mergeWBLEFTIST/mergeBINOMIAL)
+    long long m_allocations;    // nodes allocated
+    long long m_deallocations;  // nodes deallocated
+    long long m_bytesAllocated; // bytes allocated for nodes
+};
+
+// Counts of the queued students per priority and per attribute value. The first RQueue::countAt, countBetterThan
+// or histogram call of a queue walks it once, from then on every operation that adds or removes students keeps
+// them up to date, so later calls never walk the heap
+struct QueueCounts {
+    static const int PRIORITIES = MAX - MIN + 3; // [0] below MIN, [1 + p - MIN] for p in [MIN, MAX], last above MAX
+    static const int VALUES = CSC + 2;           // values of the widest attribute, last slot for values out of range
+    QueueCounts();
+    void add(const QueueCounts& rhs);
+    int m_priorities[PRIORITIES];                // only kept for an int priority function
+    int m_attributes[NUM_ATTRIBUTES][VALUES];
+};
+
+// Pools shared by the queues of a QueueRegistry, so a queue of a few students holds no blocks of its own
+struct QueueArena {
+    QueueArena() : m_nodes(), m_students() {}
+    BlockPool<Node> m_nodes;
+    BlockPool<Student> m_students;
+};
+
+// State of an RQueue that most queues never use (a priority spec, the radix buckets, the name index, the frozen
+// buffer, the counts, an open transaction), allocated by the first operation that needs it, so the tens of
+// thousands of tiny queues of a QueueRegistry are little more than a root pointer and a configuration
+struct QueueExtras {
+    QueueExtras();
+    PrioritySpec m_prioritySpec;          // compiled priority policy, used if RQueue::m_useSpec is set
+    vector<vector<HeapEntry> > m_buckets; // radix heap buckets, empty unless the structure is RADIX
+    StudentIndex m_index;                 // stored students by name, see RQueue::setIndexed
+    string m_frozenData;                  // students of a frozen queue, see RQueue::freeze
+    bool m_counted;                       // true once the counts are kept
+    QueueCounts m_counts;                 // per-priority and per-attribute counts of the queued students
+    vector<Node*> m_popped;               // nodes detached by popTentative, in the order they were popped
+    vector<HeapEntry> m_poppedEntries;    // the same for the d-ary and radix heaps
+    int64_t m_beginLastKey;               // last key of the radix heap when the transaction began
 };
 
 class RQueue {
@@ -147,48 +458,700 @@ class RQueue {
 public:
     friend class Grader; // for grading purposes
     friend class Tester; // for testing purposes
+    friend class QuotaQueue;
+    friend class ExternalQueue;
+    friend class QueueJournal;
+    friend class SharedQueue;
+    friend class IntakeQueue;
+    friend class QueueRegistry;
+    friend class ReleaseQueue;
+    friend class PolicySimulator;
     RQueue(){}
     RQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure);
+    RQueue(prifn64_t priFn, HEAPTYPE heapType, STRUCTURE structure);
+    RQueue(prifnreal_t priFn, HEAPTYPE heapType, STRUCTURE structure);
+    // Serve students in the order of a priority spec (the heap type is MINHEAP)
+    RQueue(const PrioritySpec& spec, STRUCTURE structure);
     ~RQueue();
     RQueue(const RQueue& rhs);
     RQueue& operator=(const RQueue& rhs);
     void insertStudent(const Student& student);
     Student getNextStudent(); // Return the highest priority student
     void mergeWithQueue(RQueue& rhs);
+    // With MERGE_REKEY, rhs may use another priority function, heap type or structure: it is re-keyed
+    // and bulk-built in the host's configuration in O(m), then merged
+    void mergeWithQueue(RQueue& rhs, MERGEPOLICY policy);
     void clear();
     int numStudents() const; // Return number of orders in queue
     void printStudentsQueue() const; // Print the queue using preorder traversal
     prifn_t getPriorityFn() const;
+    prifn64_t getPriorityFn64() const;     // nullptr unless the queue uses a 64-bit priority function
+    prifnreal_t getPriorityFnReal() const; // nullptr unless the queue uses a real priority function
     // Set a new priority function. Must rebuild the heap!!!
     void setPriorityFn(prifn_t priFn, HEAPTYPE heapType);
+    void setPriorityFn(prifn64_t priFn, HEAPTYPE heapType);
+    void setPriorityFn(prifnreal_t priFn, HEAPTYPE heapType);
+    // Replace the priority function with a priority spec. Must rebuild the heap!!!
+    void setPrioritySpec(const PrioritySpec& spec);
+    bool usesPrioritySpec() const;
+    PrioritySpec getPrioritySpec() const;
     HEAPTYPE getHeapType() const;
     STRUCTURE getStructure() const;
     // Set a new data structure (skew/leftist). Must rebuild the heap!!!
     void setStructure(STRUCTURE structure);
+    int getArity() const;
+    // Set the branching factor of the DARY heap (at least 2). Rebuilds the heap.
+    void setArity(int arity);
     void dump() const; // For debugging purposes
+    RQueueStats stats() const; // Heap shape plus hot-path counters (counters need RQUEUE_STATS)
+    void resetStats(); // Zero the hot-path counters
+    // Keep a hash index of the students by name. An indexed queue rejects duplicate names
+    // (insertStudent throws invalid_argument) and supports the lookups below.
+    void setIndexed(bool indexed);
+    bool isIndexed() const;
+    bool contains(const string& name) const;           // throws domain_error unless indexed
+    bool find(const string& name, Student& student) const; // copies the student if it is queued
+    bool erase(const string& name);                    // withdraws the student, false if not queued
+    // Aging: each epoch a student waits moves it one aging rate further towards the front
+    // (+rate priority for MAXHEAP, -rate for MINHEAP). Needs an int or 64-bit priority function,
+    // and queues are merged only if they have the same rate and epoch.
+    void setAgingRate(int64_t rate); // Rebuilds the heap; students keep the time they have waited
+    int64_t getAgingRate() const;
+    void advanceEpoch(int64_t ticks = 1); // O(1), no key changes
+    int64_t getEpoch() const;
+    // Lazy merge (SKEW, LEFTIST, WBLEFTIST and BINOMIAL structures): mergeWithQueue only links the two roots
+    // under a dummy node in O(1), and the dummies are purged the next time the heap order is needed (extraction,
+    // insertion or a rebuild). A purge that removes k dummies melds the k heaps below them pairwise in
+    // O(k log(n/k)), so each merge costs O(1) plus an amortized O(log n) share of the next purge.
+    // DARY and RADIX hold no nodes to link and always merge eagerly, whatever the setting.
+    void setLazyMerge(bool lazy); // switching it off purges the dummies
+    bool isLazyMerge() const;
+    // Compaction (skew, leftist and binomial structures): merges and extractions leave the nodes scattered
+    // over the pool, compact() moves them into one block in breadth-first order, so the top levels every
+    // merge walks share cache lines and traversals read memory front to back. O(n), the heap keeps its exact
+    // shape, so nothing is journaled. Other structures are arrays already and are left alone.
+    void compact();
+    void setAutoCompact(bool autoCompact); // compact after every full rebuild of the heap
+    bool isAutoCompact() const;
+    // Freezing, for queues that sit idle: freeze() packs the students into one buffer sorted by key (key deltas,
+    // attributes packed into one varint, names inline) and releases every node and student. numStudents,
+    // peekNextStudent, contains, find, the prints, copies and snapshots work on the buffer; the first call that
+    // changes the queue thaws it, and the sorted students are bulk-built back into the heap in linear time.
+    void freeze();
+    void thaw();
+    bool isFrozen() const;
+    Student peekNextStudent(); // the student getNextStudent would return, throws out_of_range if empty
+    // Counts of the queued students: the first call walks the queue in O(n), from then on the counts are maintained
+    // on every insertion, extraction, withdrawal and merge and the calls are O(1). Priorities are the values of the
+    // int priority function (without aging), in [MIN, MAX]; other priority functions throw domain_error.
+    int countAt(int priority) const;         // queued students with this priority, out_of_range outside [MIN, MAX]
+    int countBetterThan(int priority) const; // queued students with a strictly better priority, i.e. served first
+    vector<int> histogram(ATTRIBUTE attribute) const; // [v] is the number of queued students whose attribute is v
+    // Transactions: popTentative serves students in order like getNextStudent, but only detaches their nodes.
+    // commit() releases them; rollback() melds them back with their original keys in one pass and allocates
+    // nothing (skew and leftist heaps get them back on top, in the order they were popped). Until then the queue
+    // can only be read and popped: every other change, merges, freezing, compaction and snapshots throw
+    // domain_error. clear() drops the popped students.
+    void begin();           // throws domain_error if a transaction is already open
+    Student popTentative(); // throws domain_error without a transaction, out_of_range if the queue is empty
+    void commit();
+    void rollback();
+    bool inTransaction() const;
+    // Pops the next student of every queue, students[i] from queues[i] (Student() if it is empty; the queues must be
+    // distinct), and returns the number popped. The root merges of the skew and leftist queues advance one step per
+    // queue in turn, each step prefetching the node the next one reads, so the cache misses of independent queues
+    // overlap. Other queues are popped by getNextStudent. Throws domain_error, before popping anything, if a queue
+    // has an open transaction.
+    static int popFromEach(const vector<RQueue*>& queues, vector<Student>& students);
 private:
     Node * m_heap;          // Pointer to root of skew heap
     int m_size;             // Current size of the heap
     prifn_t m_priorFunc;    // Function to compute priority
+    prifn64_t m_priorFunc64;     // 64-bit priority function, used instead of m_priorFunc if set
+    prifnreal_t m_priorFuncReal; // real priority function, used instead of m_priorFunc if set
+    bool m_useSpec;              // true if keys come from the priority spec of m_extras instead of a function
     HEAPTYPE m_heapType;    // MINHEAP or MAXHEAP
-    STRUCTURE m_structure;  // skew heap or leftist heap
+    STRUCTURE m_structure;  // skew heap, leftist heap or d-ary heap
+    vector<HeapEntry> m_entries; // d-ary heap of keys, empty unless m_structure is DARY
+    QueueArena* m_ownPools;           // pools of its own, nullptr while the queue lives in an arena
+    BlockPool<Node>* m_nodes;         // nodes of the heap, from m_ownPools or from the arena
+    BlockPool<Student>* m_students;   // students referenced by nodes and entries, from m_ownPools or the arena
+    QueueArena* m_arena;              // arena of the registry that owns the queue, nullptr if it has its own pools
+    int m_arity;            // branching factor of the d-ary heap
+    int64_t m_lastKey;      // key of the last student extracted from the radix heap
+    bool m_indexed;         // true if the index of m_extras is maintained
+    int64_t m_agingRate;    // priority gained per epoch of waiting, 0 disables aging
+    int64_t m_epoch;        // current epoch, keys hold the epoch each student was enqueued in
+    QueueJournal* m_journal; // journal of the operations on this queue, nullptr if not journaled
+    bool m_lazyMerge;       // true if merges link the roots under a dummy node
+    int m_dummies;          // dummy nodes in the heap, they form a crown above every real node
+    bool m_autoCompact;     // true if full rebuilds are followed by compact()
+    bool m_frozen;          // true if the students are only kept in the frozen buffer of m_extras
+    bool m_transaction;     // true between begin and commit or rollback
+    // rarely used state, nullptr until the first operation that needs it; a spec, radix, indexed, frozen or counted
+    // queue and one with an open transaction always has it. Mutable, the first count query allocates it
+    mutable QueueExtras* m_extras;
+#ifdef RQUEUE_STATS
+    RQueueStats m_stats;    // hot-path counters
+    int m_mergeDepth;       // current recursion depth of the merge functions
+    int m_opDepth;          // nesting level of public operations being timed
+#endif
 
     void dump(Node *pos) const; // helper function for dump
 
     /******************************************
      * Private function declarations go here! *
      ******************************************/
-    void destroyHeap(Node* node);
-
+    Node* newNode(const Student& student, int64_t key);
+    Node* newDummy(Node* left, Node* right); // dummy node of a lazy merge, it holds no student
     void copyNodes(Node* sourceNode, Node*& destinationNode);
 
     Node* mergeLEFTIST(Node* lhs, Node* rhs);
     Node* mergeSKEW(Node* lhs, Node* rhs);
+    Node* mergeWBLEFTIST(Node* lhs, Node* rhs);
+    // binomial heap in left-child/right-sibling form: m_heap is the first root, roots are linked through
+    // m_right in increasing order of degree, and the children of a node run from m_left in decreasing order
+    Node* mergeBINOMIAL(Node* lhs, Node* rhs);
+    void linkBINOMIAL(Node* parent, Node* child); // child becomes the first child of parent
+    Node** bestRoot(); // link that points to the root with the best key
+    Node* detachBINOMIAL(); // unlinks the best root, its children go back to the root list
+    Node* mergeNodes(Node* lhs, Node* rhs); // dispatches to the merge of the current node structure
     bool priorityCheck(Node* lhs, Node* rhs);
+    void settle(); // purges the dummies of lazy merges, the heap order holds from the root afterwards
+    void purgeDummies();
+    Node* meldAll(vector<Node*>& heaps); // melds the heaps pairwise, round by round
+
+    // the part of the configuration that decides the keys
+    struct KeyConfig {
+        KeyConfig() : m_priorFunc(nullptr), m_priorFunc64(nullptr), m_priorFuncReal(nullptr), m_useSpec(false),
+                      m_prioritySpec(), m_heapType(MINHEAP), m_agingRate(0) {}
+        prifn_t m_priorFunc;
+        prifn64_t m_priorFunc64;
+        prifnreal_t m_priorFuncReal;
+        bool m_useSpec;
+        PrioritySpec m_prioritySpec;
+        HEAPTYPE m_heapType;
+        int64_t m_agingRate;
+    };
 
+    void initialize(HEAPTYPE heapType, STRUCTURE structure);
+    QueueExtras& extras(); // m_extras, allocated on first use
+    bool samePriority(const RQueue& rhs) const;
+    KeyConfig keyConfig() const;
+    void setKeyConfig(const KeyConfig& config);
+    // every stored student with its enqueue epoch (now without aging), on a clock that reads now at m_epoch
+    void collectEpochs(vector<HeapEntry>& entries, int64_t now);
+    // turns the epochs of collectEpochs into the keys under config; the queue is left as it was, even on a throw
+    void computeKeys(vector<HeapEntry>& entries, const KeyConfig& config);
+    void rekeyHeap(const KeyConfig& config); // switches to config and recomputes every key, or throws and keeps both
+    int64_t agedKey(const Student& student, int64_t epoch); // rankKey plus the aging offset
     void rebuildHeap(Node* oldNode);
     void insertPointer(Node* oldNode, Node* newNode);
 
     void preorderPrint(Node* node) const;
+    void printStudent(const Student& student) const;
+    void printPriority(const Student& student) const;
+
+    int64_t rankKey(const Student& student);
+    static int64_t realKey(double value);
+    Student* storeStudent(const Student& student);
+    Student releaseStudent(Student* student);
+    Student* extractTop(); // removes the top student without releasing it
+    Node* detachRoot();    // removes the top node of the skew/leftist/binomial heaps without releasing it
+    void dropWithdrawnTops(); // drops withdrawn students until a queued one is on top
+    void copyEntries(const RQueue& rhs);
+    Student* insertEntry(const Student& student);
+    void siftUp(int pos);
+    void siftDown(int pos);
+    void heapify();
+    void mergeDARY(RQueue& rhs);
+    void addEntries(const vector<HeapEntry>& entries); // appends entries to the d-ary heap and restores it
+    void insertBatch(vector<HeapEntry>& entries); // melds keyed entries of stored students, leaves entries empty
+    void moveNodesToArray(Node* node);
+    void moveArrayToNodes();
+    void rebuilt(); // called after a full rebuild of the heap, compacts it if m_autoCompact is set
+    void preorderPrintArray(int pos) const;
+    void dumpArray(int pos) const;
+
+    int radixBucket(int64_t key) const;
+    void insertRadix(const HeapEntry& entry);
+    HeapEntry extractRadix();
+    void mergeRADIX(RQueue& rhs);
+    void fillBuckets();
+    void drainBuckets();
+    void dumpBuckets() const;
+
+    void collectShape(Node* node, RQueueStats& result, long long& depthSum) const;
+
+    void copyIndex(const RQueue& rhs);
+    void copyExtras(const RQueue& rhs); // the frozen buffer and the counts of rhs, if it keeps them
+    void indexStudents(const RQueue& rhs, vector<Student*>& added);
+    void collectStudents(vector<Student*>& students) const;
+    void collectStudents(Node* node, vector<Student*>& students) const;
+    void purgeWithdrawn(); // drops the withdrawn students from the heap
+    void dropWithdrawn(vector<HeapEntry>& entries);
+
+    void convertTo(const RQueue& host); // rebuilds the queue in the configuration of host
+    void initializeLike(const RQueue& rhs); // empty queue with the priority and structure of rhs
+    void releaseAll();                      // gives every node and student back to the pools one by one
+    void moveToArena(QueueArena* arena);    // moves the students into the pools of arena, nullptr for its own
+    void copyConfig(const RQueue& rhs);
+    void collectEntries(vector<HeapEntry>& entries) const;
+    void collectEntries(Node* node, vector<HeapEntry>& entries) const;
+    void insertKeyed(const Student& student, int64_t key); // inserts with an already computed key
+    int64_t topKey();  // key of the next student, the queue must not be empty
+    Student* topStudent(); // the next student, the queue must not be empty
+    bool findFrozen(const string& name, Student* student) const; // scans the frozen students for a name
+    bool counted() const; // true once the counts are kept, see countAt
+    const QueueCounts& counts() const; // the counts, kept from this call on
+    void countStudent(const Student& student, int delta) const; // adds delta to the counts of the student, if kept
+    void recount() const; // recomputes kept counts from the queued students, after the priority function changed
+    void checkCounted(int priority) const; // throws unless priorities are counted and priority is in range
+    void checkTransaction() const; // throws domain_error if a transaction is open
+    void releasePopped();          // gives the students popped by the transaction back to the pools
+    void settleRadix(); // makes the smallest key of the radix heap available in bucket 0
+
+    // snapshot encoding, shared by checkpoints and the merge/assign records of the journal
+    void writeConfig(ostream& out, const QueueJournal& journal) const; // throws for unregistered functions
+    void readConfig(istream& in, const QueueJournal& journal);
+    void writeBody(ostream& out) const; // the stored students and the exact shape of the heap
+    void readBody(istream& in);         // into an empty queue configured by readConfig
+    void writeNodes(ostream& out, Node* node) const;
+    Node* readNodes(istream& in);
+    void writeEntry(ostream& out, const HeapEntry& entry) const;
+    HeapEntry readEntry(istream& in);
+};
+
+// Quota-aware extraction. The students are partitioned by one attribute into one sub-queue per
+// attribute value, and a small heap orders the classes by their best student, so a class that reached
+// its quota is dropped from that heap in O(log k) without touching its students.
+class QuotaQueue {
+public:
+    friend class Tester; // for testing purposes
+    QuotaQueue(RQueue& queue, ATTRIBUTE attribute); // takes over every student of queue, leaving it empty
+    ~QuotaQueue();
+    QuotaQueue(const QuotaQueue&) = delete;
+    QuotaQueue& operator=(const QuotaQueue&) = delete;
+    // At most maxSeats (-1 for no limit) and at least minSeats students of a class are admitted.
+    // Minimum shares are only enforced against a seat limit set by setSeats.
+    void setQuota(int value, int maxSeats, int minSeats = 0);
+    void setSeats(int seats); // total number of students to admit, -1 for no limit
+    void insertStudent(const Student& student);
+    // Return the highest priority student that can still be admitted, throws out_of_range if none can
+    Student getNextStudent();
+    int numStudents() const; // students still queued, admissible or not
+    int seatsTaken(int value) const;
+    void releaseInto(RQueue& queue); // merges the students that were not admitted into queue
+private:
+    struct ClassQuota {
+        int m_maxSeats;  // -1 for no limit
+        int m_minSeats;
+        int m_taken;     // students of the class admitted so far
+    };
+    ATTRIBUTE m_attribute;          // attribute that defines the classes
+    vector<RQueue*> m_classes;      // sub-queue per attribute value
+    vector<ClassQuota> m_quotas;    // quota per attribute value
+    vector<int64_t> m_topKeys;      // key of the best student of each class in the tops heap
+    vector<int> m_tops;             // heap of the admissible classes, best student on top
+    int m_seats;                    // -1 for no limit
+    int m_taken;                    // students admitted so far
+    bool m_reserving;               // true once only classes below their minimum share can be admitted
+
+    int classOf(const Student& student) const; // throws out_of_range for a value outside the attribute
+    void checkClass(int value) const;
+    bool admissible(int value) const;
+    bool mustReserve() const;
+    void rebuildTops();
+    bool topsBefore(int lhs, int rhs) const; // heap order of the tops, true if rhs has the better student
+};
+
+// External-memory queue (a simple sequence heap) for queues that do not fit in memory. New students go to
+// an in-memory insertion heap; once it holds its share of the budget it is drained in order into a sorted
+// run on disk. getNextStudent serves the better of the insertion heap and a k-way merge of the run heads,
+// which are read back a block at a time. Runs whose buffers would exceed the budget are merged into one.
+class ExternalQueue {
+public:
+    friend class Tester; // for testing purposes
+    static const int DEFAULT_BLOCK = 1024; // records read from a run at a time
+    // Takes over every student of queue, leaving it empty, and serves them in its order. At most memoryBudget
+    // students (at least 4) are held in memory, run files are created in directory and removed when served.
+    ExternalQueue(RQueue& queue, int memoryBudget, const string& directory, int blockSize = DEFAULT_BLOCK);
+    ~ExternalQueue();
+    ExternalQueue(const ExternalQueue&) = delete;
+    ExternalQueue& operator=(const ExternalQueue&) = delete;
+    void insertStudent(const Student& student);
+    Student getNextStudent(); // throws out_of_range if the queue is empty
+    long long numStudents() const;
+    int numRuns() const;               // sorted runs not yet served completely
+    long long spilledStudents() const; // students in runs, on disk or in their read buffers
+    void advanceEpoch(int64_t ticks = 1); // see RQueue::advanceEpoch, spilled keys stay valid
+private:
+    // run file of records in serving order: the key, then the packed student
+    struct RunRecord {
+        RunRecord() : m_key(0), m_student() {}
+        int64_t m_key;
+        Student m_student;
+    };
+    struct Run {
+        Run() : m_id(0), m_path(), m_file(), m_unread(0), m_buffer(), m_next(0) {}
+        int m_id;                    // creation order, breaks ties between equal keys
+        string m_path;
+        ifstream m_file;
+        long long m_unread;          // records still in the file
+        vector<RunRecord> m_buffer;  // records read from the file, served from m_next on
+        int m_next;
+    };
+    RQueue m_heap;            // insertion heap, ordered like the queue that was taken over
+    vector<Run*> m_runs;      // runs with records left
+    vector<Run*> m_heads;     // merge heap of the runs, best head on top
+    string m_directory;
+    string m_filePrefix;      // makes the run file names unique to this queue
+    int m_heapCapacity;       // students the insertion heap holds before it is spilled
+    int m_maxRuns;            // runs whose read buffers fit in the rest of the budget
+    int m_blockSize;
+    long long m_spilled;      // students in runs
+    int m_nextRun;            // id of the next run
+    int64_t m_lastKey;        // key of the last student served, radix order is checked against it
+
+    void writeRun(RQueue& source); // drains source into a new run
+    void mergeRuns();              // merges every run into one
+    void openRun(const string& path, int id, long long count);
+    void closeRun(Run* run);
+    bool fillBuffer(Run* run);     // reads the next block, false if the run is exhausted
+    string runPath(int id) const;
+    void checkStream(const ios& stream, const string& path) const; // throws runtime_error on an I/O error
+    bool headsBefore(const Run* lhs, const Run* rhs) const; // heap order of the heads, true if rhs is better
+    static void writeRecord(ostream& out, int64_t key, const Student& student);
+    static bool readRecord(istream& in, RunRecord& record);
+};
+// Write-ahead journal of the operations on one queue, for crash recovery on top of the last snapshot.
+// The queue copies its operations into a ring buffer as raw records without taking a lock; a background
+// thread encodes whatever was appended during one commit interval, writes it as a checksummed batch and
+// syncs it (group commit).
+// Priority functions cannot be written to disk, so the functions a queue uses must be registered under
+// a name; specs are journaled as their text. The queue and its journal are used from one thread.
+class QueueJournal {
+public:
+    friend class RQueue;
+    friend class Tester; // for testing purposes
+    static const int DEFAULT_COMMIT_MS = 5; // group commit interval
+    QueueJournal(const string& path, const string& snapshotPath, int commitMs = DEFAULT_COMMIT_MS);
+    ~QueueJournal(); // detaches the queue, everything journaled so far is synced
+    QueueJournal(const QueueJournal&) = delete;
+    QueueJournal& operator=(const QueueJournal&) = delete;
+    void registerPriorityFn(const string& name, prifn_t priFn);
+    void registerPriorityFn(const string& name, prifn64_t priFn);
+    void registerPriorityFn(const string& name, prifnreal_t priFn);
+    // Replaces queue by the last snapshot and replays the journal on top of it, then attaches the queue.
+    // Returns the number of operations replayed; a batch torn by a crash at the end of the journal is ignored,
+    // and a transaction the crash left open is rolled back.
+    long long recover(RQueue& queue);
+    void attach(RQueue& queue); // checkpoints queue and journals every operation on it from now on
+    void detach();              // syncs the journal, the queue is no longer journaled
+    void checkpoint();          // snapshot of the attached queue, then the journal starts over
+    void flush();               // waits until every operation journaled so far is synced
+    long long getSequence() const; // operations journaled since the journal was created
+private:
+    enum OPCODE {OP_INSERT, OP_EXTRACT, OP_MERGE, OP_ASSIGN, OP_CLEAR, OP_SET_FN, OP_SET_SPEC, OP_SET_STRUCTURE,
+                 OP_SET_ARITY, OP_SET_INDEXED, OP_ERASE, OP_SET_AGING, OP_ADVANCE_EPOCH, OP_SET_LAZY,
+                 OP_FREEZE, OP_BEGIN, OP_POP, OP_COMMIT, OP_ROLLBACK, OP_PEEK};
+    enum FNKIND {FN_INT, FN_INT64, FN_REAL, FN_SPEC};
+    struct NamedFn {
+        string m_name;
+        prifn_t m_priFn;
+        prifn64_t m_priFn64;
+        prifnreal_t m_priFnReal;
+    };
+    static const int RING_BYTES = 1 << 22; // a power of two
+    static const int RING_ENCODED = 0xff;   // ring tag of a record the queue encoded itself
+    static const int RAW_RECORD_BYTES = 1 << 12; // longer inserts are encoded by the queue
+    // ring record of an insert, after its opcode and before the name
+    struct RawInsert {
+        int32_t m_fields[NUM_ATTRIBUTES];
+        uint32_t m_nameSize;
+    };
+    string m_path;
+    string m_snapshotPath;
+    int m_commitMs;
+    RQueue* m_queue;            // attached queue, or nullptr
+    vector<NamedFn> m_functions;
+    int m_fd;                   // journal file, -1 unless attached
+    long long m_sequence;       // operations journaled, counted across checkpoints
+    vector<char> m_scratch;     // the record being encoded
+    // ring buffer between the queue (producer) and the writer (consumer), positions count all bytes ever
+    vector<char> m_ring;        // followed by room for a copy of its first RAW_RECORD_BYTES
+    atomic<uint64_t> m_head;    // bytes appended, only advanced by the queue
+    atomic<uint64_t> m_tail;    // bytes the writer has encoded, only advanced by the writer
+    uint64_t m_tailSeen;        // m_tail as last read by the queue
+    mutex m_mutex;              // guards the members below
+    condition_variable m_wake;    // wakes the writer
+    condition_variable m_synced;  // wakes the queue waiting for a sync or for room in the ring
+    uint64_t m_syncedBytes;     // bytes written and synced
+    bool m_failed;              // the writer could not write or sync the journal
+    bool m_stop;                // the writer commits what is left and exits
+    bool m_flushRequested;      // the writer commits without waiting for the interval
+    thread m_writer;
+
+    // records are appended by the queue after each successful operation
+    void logOp(OPCODE op);
+    void logValue(OPCODE op, int64_t value);
+    void logText(OPCODE op, const string& text);
+    void logInsert(const Student& student);
+    void logPriorityFn(FNKIND kind, const string& name, HEAPTYPE heapType);
+    void logQueue(OPCODE op, const string& encoded); // merge and assign records carry an encoded queue
+    char* beginRecord(OPCODE op, size_t maxPayload); // scratch space for the payload
+    void endRecord(char* end);
+    char* reserve(size_t size); // contiguous room at the head of the ring, or nullptr
+    void publish(size_t size);  // the reserved record is complete
+    void append(const char* data, size_t size);
+    void waitForRoom();
+    void requestCommit(uint64_t position); // waits until position is synced
+
+    string nameOf(prifn_t priFn) const; // throws invalid_argument for unregistered functions
+    string nameOf(prifn64_t priFn) const;
+    string nameOf(prifnreal_t priFn) const;
+    const NamedFn& named(const string& name) const; // throws runtime_error for unknown names
+
+    void writeSnapshot(const RQueue& queue, long long sequence);
+    long long readSnapshot(RQueue& queue);
+    long long replay(RQueue& queue, long long snapshotSequence);
+    void apply(RQueue& queue, istream& in);
+    void startJournal(long long sequence); // truncates the journal file to an empty one continuing there
+    void writerLoop();
+    char* encodeRecords(uint64_t& position, uint64_t head, char* out, uint64_t& passThrough);
+    bool writeBatches(char* batch, size_t size);
+    void stopWriter();
+    bool writeAll(const char* data, size_t size);
+    static bool syncPath(const string& path);
+    static uint32_t checksum(const char* data, size_t size);
+};
+// Queue shared by the worker processes of one machine. The heap lives in a POSIX shared-memory segment
+// and its nodes link to each other by index instead of by pointer, so every process can map the segment
+// at its own address; a process-shared robust mutex serializes the operations. Function pointers are only
+// valid in the process that took them, so each process passes its own priority function and keys the
+// students it inserts itself: every process attached to a segment must rank students the same way.
+// If a process dies holding the lock, the next one rebuilds the heap from the students marked queued:
+// a student is served at most once, and one a scheduler dies with after unmarking it is dropped.
+class SharedQueue {
+public:
+    friend class Tester; // for testing purposes
+    static const int MAX_NAME = 63; // longest student name a shared node holds
+    // Creates the segment (a POSIX shared-memory name such as "/rqueue") with room for capacity students.
+    // Only SKEW and LEFTIST are supported; throws runtime_error if the segment already exists.
+    SharedQueue(const string& name, int capacity, prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure);
+    // Attaches to a segment created by another process
+    SharedQueue(const string& name, prifn_t priFn);
+    ~SharedQueue(); // detaches, the segment and its students stay until remove()
+    SharedQueue(const SharedQueue&) = delete;
+    SharedQueue& operator=(const SharedQueue&) = delete;
+    static void remove(const string& name); // the segment is freed once every process has detached
+    void insertStudent(const Student& student); // throws overflow_error if the segment is full
+    Student getNextStudent(); // throws out_of_range if the queue is empty
+    void clear();
+    int numStudents() const;
+    int getCapacity() const;
+    HEAPTYPE getHeapType() const;
+    STRUCTURE getStructure() const;
+private:
+    static const int32_t NONE = -1; // null link
+    // students are stored inline, the segment holds no pointers
+    struct SharedNode {
+        int64_t m_key;          // cached priority, see RQueue::rankKey
+        int32_t m_left;         // index of the left child, NONE if there is none
+        int32_t m_right;        // index of the right child, next free node while the node is free
+        int32_t m_npl;          // null path length for leftist heap
+        atomic<int32_t> m_queued; // 1 while the node holds a queued student, read when the heap is repaired
+        int32_t m_attributes[NUM_ATTRIBUTES];
+        char m_name[MAX_NAME + 1];
+    };
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared nodes need a lock-free atomic int");
+    // header of the segment, followed by its nodes
+    struct alignas(SharedNode) Segment {
+        static const uint32_t MAGIC = 0x52515348; // "RQSH", stored once the creator has set the segment up
+        atomic<uint32_t> m_magic;
+        pthread_mutex_t m_mutex;  // process-shared and robust, guards everything below
+        int32_t m_capacity;       // nodes in the segment
+        int32_t m_used;           // nodes handed out so far, the rest have never been used
+        int32_t m_size;           // queued students
+        int32_t m_root;           // root of the heap, NONE if it is empty
+        int32_t m_free;           // chain of released nodes, linked through m_right
+        int32_t m_heapType;
+        int32_t m_structure;
+    };
+    string m_name;
+    Segment* m_segment;  // mapped at a different address in every process
+    size_t m_bytes;      // size of the mapping
+    RQueue m_keys;       // empty queue with this process's priority function, computes the keys
+
+    SharedNode* nodes() const;
+    void map(int fd, size_t bytes);
+    void lock() const;   // repairs the heap if the previous owner died holding the lock
+    void unlock() const;
+    void repair() const; // rebuilds the heap from the nodes that hold a queued student
+    int32_t merge(int32_t lhs, int32_t rhs) const;
+    int32_t mergeLEFTIST(int32_t lhs, int32_t rhs) const;
+    int32_t mergeSKEW(int32_t lhs, int32_t rhs) const;
+    int32_t allocateNode() const; // NONE if the segment is full
+    void releaseNode(int32_t node) const;
+};
+// Lock-free intake in front of a queue, for several producer threads and one consumer thread. Producers push
+// their students onto an intake stack with a single compare-and-swap and never touch the heap. Before it reads
+// the queue the consumer detaches the whole stack, bulk-builds the batch into a heap in O(m) and melds it in
+// with a single merge, so the merge cost is paid once per batch instead of once per student.
+class IntakeQueue {
+public:
+    friend class Tester; // for testing purposes
+    // Takes over every student of queue, leaving it empty. Radix and indexed queues are not supported:
+    // their inserts can be rejected, and a producer is never told about a rejected student.
+    explicit IntakeQueue(RQueue& queue);
+    ~IntakeQueue();
+    IntakeQueue(const IntakeQueue&) = delete;
+    IntakeQueue& operator=(const IntakeQueue&) = delete;
+    void insertStudent(const Student& student); // safe from any thread
+    // The functions below are for the consumer thread only
+    Student getNextStudent(); // throws out_of_range if the queue is empty
+    int numStudents();        // includes the students still in the intake
+    void drain();             // melds the intake into the queue, getNextStudent does this on its own
+    void advanceEpoch(int64_t ticks = 1); // see RQueue::advanceEpoch, students in the intake start aging once drained
+private:
+    struct IntakeNode {
+        explicit IntakeNode(const Student& student) : m_student(student), m_next(nullptr) {}
+        IntakeNode(const IntakeNode&) = delete; // nodes are only handled by pointer
+        IntakeNode& operator=(const IntakeNode&) = delete;
+        Student m_student;
+        IntakeNode* m_next;   // pushed before this one
+    };
+    RQueue m_queue;                   // the students that were drained
+    atomic<IntakeNode*> m_intake;     // top of the intake stack, nullptr if it is empty
+    vector<IntakeNode*> m_drained;    // the detached stack, oldest first
+    vector<HeapEntry> m_entries;      // the batch being built, empty between drains
+
+    void push(IntakeNode* first, IntakeNode* last); // pushes the chain first -> ... -> last
+};
+// Owner of many queues that share the configuration given to the constructor, e.g. one queue per course section.
+// The queues draw their nodes and students from one shared arena instead of each carving blocks of its own,
+// so a queue of a few students costs its RQueue object and its live nodes only. Sections are looked up by id
+// in an open-addressing table (linear probing, backward-shift deletion), and clear() drops every queue at the
+// end of a term by resetting the arena, without walking any heap. Queues can be merged across the registry;
+// students that leave the arena for a queue outside of it are copied. The registry is used from one thread.
+class QueueRegistry {
+public:
+    friend class Tester; // for testing purposes
+    QueueRegistry(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure);
+    ~QueueRegistry();
+    QueueRegistry(const QueueRegistry&) = delete;
+    QueueRegistry& operator=(const QueueRegistry&) = delete;
+    RQueue& section(int id);        // the queue of a section, created empty on first use
+    RQueue* find(int id) const;     // nullptr if the section has no queue
+    bool remove(int id);            // destroys the queue of a section, false if it had none
+    int numSections() const;
+    void clear();                   // destroys every queue and releases all their memory at once
+private:
+    struct Slot {
+        int m_id;
+        RQueue* m_queue;            // nullptr if the slot is empty
+    };
+    prifn_t m_priorFunc;            // configuration of every new queue
+    HEAPTYPE m_heapType;
+    STRUCTURE m_structure;
+    QueueArena m_arena;             // nodes and students of all the queues
+    vector<Slot> m_slots;           // the size is a power of two, at most half of the slots are used
+    int m_count;                    // used slots
+
+    static size_t homeSlot(int id, size_t mask);
+    int findSlot(int id) const;     // slot of the section, or -1
+    void grow();
+};
+// Time-gated release in front of a queue, for students that only become eligible later, e.g. registration waves
+// by level. A student inserted with an eligibility time is stored right away but waits in a hierarchical timer
+// wheel, invisible to getNextStudent, until advanceTime reaches that time. The wheel has 4 levels of 64 slots,
+// level l covering 64^l ticks per slot; a student sits on the level of the highest base-64 digit in which its time
+// differs from the clock, and moves down a level each time the clock enters its slot, so it is touched at most
+// 4 times whatever the delay. Students more than 2^24 ticks ahead wait in an overflow list. The students that
+// come due during one advanceTime are bulk-built into a heap in O(m) and melded in with a single merge.
+class ReleaseQueue {
+public:
+    friend class Tester; // for testing purposes
+    // Takes over every student of queue, leaving it empty; the clock starts at now. Radix and indexed queues are
+    // not supported, as for IntakeQueue: their inserts can be rejected once the student has long been accepted.
+    explicit ReleaseQueue(RQueue& queue, int64_t now = 0);
+    ReleaseQueue(const ReleaseQueue&) = delete;
+    ReleaseQueue& operator=(const ReleaseQueue&) = delete;
+    void insertStudent(const Student& student);                    // eligible now
+    void insertStudent(const Student& student, int64_t eligibleAt); // waits unless eligibleAt is not in the future
+    // Moves the clock to now and releases every student that became eligible, returns how many.
+    // Throws invalid_argument if now is before the current time.
+    int advanceTime(int64_t now);
+    int64_t getTime() const;
+    int64_t nextRelease() const; // earliest eligibility time of a waiting student, throws out_of_range if none waits
+    Student getNextStudent();    // throws out_of_range if no eligible student is queued
+    int numStudents() const;     // eligible students
+    int numWaiting() const;      // students whose time has not come yet
+    void advanceEpoch(int64_t ticks = 1); // see RQueue::advanceEpoch, waiting students start aging once released
+private:
+    struct Pending {
+        int64_t m_time;       // eligibility time
+        Student* m_student;   // stored in the pool of m_queue
+    };
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const int LEVELS = 4;
+    RQueue m_queue;                 // the eligible students
+    int64_t m_now;                  // current time
+    vector<vector<Pending> > m_wheel; // LEVELS * SLOTS slots, slot s of level l at l * SLOTS + s
+    uint64_t m_occupied[LEVELS];    // bit s is set if slot s of the level holds students
+    vector<Pending> m_overflow;     // students beyond the last level
+    int64_t m_overflowMin;          // earliest time in m_overflow
+    int m_waiting;                  // students in the wheel and the overflow list
+    vector<Pending> m_due;          // released, not melded into m_queue yet
+    vector<Pending> m_cascade;      // a slot being moved down a level
+    vector<HeapEntry> m_entries;    // the batch being built, empty between releases
+
+    static uint64_t tick(int64_t time); // order-preserving map to unsigned, so digits can be compared
+    void place(const Pending& pending); // into m_due, the wheel or the overflow list, relative to m_now
+    bool nextSlot(int& level, int& slot, uint64_t& start) const; // first occupied slot after the clock, or false
+    void release();                 // melds m_due into m_queue
+};
+// Outcome of one policy of a PolicySimulator run
+struct PolicyResult {
+    PolicyResult() : m_name(), m_order(), m_counts() {}
+    string m_name;
+    vector<int> m_order;  // corpus positions of the admitted students, in admission order
+    QueueCounts m_counts; // the admitted students per attribute value (and per priority, for int priority functions)
+};
+// What-if runs of many priority policies over one student corpus. The corpus is copied once and only read from
+// then on; a run spreads the policies over a pool of threads, and each policy builds nothing but an array of
+// (key, corpus position) pairs, keys computed exactly as an RQueue with that policy computes them. The admitted
+// students are selected in O(n) and only they are sorted, so a policy costs O(n + k log k) for k seats, without
+// allocating a node or copying a student. Students with equal keys are admitted in corpus order, so the results
+// do not depend on the number of threads.
+class PolicySimulator {
+public:
+    friend class Tester; // for testing purposes
+    explicit PolicySimulator(const vector<Student>& corpus);
+    ~PolicySimulator();
+    PolicySimulator(const PolicySimulator&) = delete;
+    PolicySimulator& operator=(const PolicySimulator&) = delete;
+    // Each returns the index of the policy in the results of run
+    int addPolicy(const string& name, prifn_t priFn, HEAPTYPE heapType);
+    int addPolicy(const string& name, prifn64_t priFn, HEAPTYPE heapType);
+    int addPolicy(const string& name, prifnreal_t priFn, HEAPTYPE heapType);
+    int addPolicy(const string& name, const PrioritySpec& spec);
+    int numPolicies() const;
+    int numStudents() const; // size of the corpus
+    // Admits seats students (-1 for all of them) under every policy, on at most threads threads (0 for one per
+    // hardware thread). A priority function that throws fails the run, the exception is passed on.
+    vector<PolicyResult> run(int seats = -1, int threads = 0);
+private:
+    struct Ranked {
+        int64_t m_key;
+        int m_position;       // in m_corpus, breaks ties
+    };
+    const vector<Student> m_corpus;
+    vector<string> m_names;
+    vector<RQueue*> m_policies; // empty queues that only compute the keys of their policy
+
+    int addPolicy(const string& name, RQueue* policy); // takes over policy
+    void runPolicy(int policy, int seats, PolicyResult& result);
 };
-#endif
\ No newline at end of file
+#endif